@@ -0,0 +1,614 @@
+/** \file benchmark.c
+ *
+ * \author Alex Andriati
+ * \date October/2026
+ * \brief Timing of the library routines against plain stdio usage
+ *
+ * Record random data in a scratch file and compare the time spent by
+ * the library routines with the equivalent straightforward loops over
+ * stdio functions, checking that both give exactly the same values.
+ * The number of values can be given as first command line argument
+ */
+
+#include "cpydataio.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define DEFAULT_NVALUES 2000000
+#define BENCH_FNAME     "bench_output.txt"
+#define BENCH_REF_FNAME "bench_reference.txt"
+#define BENCH_NFILES    32
+
+static double
+elapsed_seconds(struct timespec* start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + 1E-9 * (now.tv_nsec - start->tv_nsec);
+}
+
+static void
+report(
+    char   title[],
+    char   reference[],
+    double reference_time,
+    double lib_time,
+    int    identical)
+{
+    printf(
+        "%-32s %6s %8.3lfs  lib %8.3lfs  speedup %6.2lfx  %s\n",
+        title,
+        reference,
+        reference_time,
+        lib_time,
+        reference_time / lib_time,
+        identical ? "identical" : "MISMATCH");
+}
+
+static int
+same_file_contents(char fname_a[], char fname_b[])
+{
+    int    same;
+    size_t na, nb;
+    char   buf_a[4096], buf_b[4096];
+    FILE * fa, *fb;
+
+    fa = open_file(fname_a, "r");
+    fb = open_file(fname_b, "r");
+    same = 1;
+    do
+    {
+        na = fread(buf_a, 1, sizeof(buf_a), fa);
+        nb = fread(buf_b, 1, sizeof(buf_b), fb);
+        same = na == nb && memcmp(buf_a, buf_b, na) == 0;
+    } while (same && na > 0);
+    fclose(fa);
+    fclose(fb);
+    return same;
+}
+
+static void
+bench_real_read(int nvalues)
+{
+    int             i, identical;
+    double          t_ref, t_lib;
+    double *        ref, *arr;
+    FILE*           f;
+    struct timespec start;
+
+    ref = (double*) malloc(nvalues * sizeof(double));
+    arr = (double*) malloc(nvalues * sizeof(double));
+    for (i = 0; i < nvalues; i++) ref[i] = 2.0 * rand() / RAND_MAX - 1.0;
+    rarr_column_txt(BENCH_FNAME, REAL_SCIFMT_NOSPACE, nvalues, ref);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    f = open_file(BENCH_FNAME, "r");
+    for (i = 0; i < nvalues; i++)
+    {
+        if (fscanf(f, "%lf", &ref[i]) != 1) break;
+    }
+    fclose(f);
+    t_ref = elapsed_seconds(&start);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    rarr_txt_read(BENCH_FNAME, "%lf", 1, nvalues, arr);
+    t_lib = elapsed_seconds(&start);
+
+    identical = memcmp(ref, arr, nvalues * sizeof(double)) == 0;
+    report("rarr_txt_read \"%lf\"", "stdio", t_ref, t_lib, identical);
+    free(ref);
+    free(arr);
+}
+
+static void
+bench_complex_read(int nvalues)
+{
+    int             i, identical;
+    double          t_ref, t_lib, real, imag;
+    double complex *ref, *arr;
+    FILE*           f;
+    struct timespec start;
+
+    ref = (double complex*) malloc(nvalues * sizeof(double complex));
+    arr = (double complex*) malloc(nvalues * sizeof(double complex));
+    for (i = 0; i < nvalues; i++)
+    {
+        ref[i] = CMPLX(1.0 * rand() / RAND_MAX, -1.0 * rand() / RAND_MAX);
+    }
+    carr_column_txt(BENCH_FNAME, CPLX_SCIFMT_SPACE_BEFORE, nvalues, ref);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    f = open_file(BENCH_FNAME, "r");
+    for (i = 0; i < nvalues; i++)
+    {
+        if (fscanf(f, " (%lf%lfj)", &real, &imag) != 2) break;
+        ref[i] = CMPLX(real, imag);
+    }
+    fclose(f);
+    t_ref = elapsed_seconds(&start);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    carr_txt_read(BENCH_FNAME, " (%lf%lfj)", 1, nvalues, arr);
+    t_lib = elapsed_seconds(&start);
+
+    identical = memcmp(ref, arr, nvalues * sizeof(double complex)) == 0;
+    report("carr_txt_read \" (%lf%lfj)\"", "stdio", t_ref, t_lib, identical);
+    free(ref);
+    free(arr);
+}
+
+static void
+bench_parallel_read(int nvalues)
+{
+    int             i, j, nrows, ncols, identical;
+    double          t_ref, t_lib;
+    double **       ref, **mat;
+    struct timespec start;
+
+    ncols = 50;
+    nrows = nvalues / ncols + 1;
+    ref = (double**) malloc(nrows * sizeof(double*));
+    mat = (double**) malloc(nrows * sizeof(double*));
+    for (i = 0; i < nrows; i++)
+    {
+        ref[i] = (double*) malloc(ncols * sizeof(double));
+        mat[i] = (double*) malloc(ncols * sizeof(double));
+        for (j = 0; j < ncols; j++) ref[i][j] = 1.0 * rand() / RAND_MAX;
+    }
+    rmat_txt(BENCH_FNAME, REAL_SCIFMT_SPACE_BEFORE, nrows, ncols, ref);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    rmat_txt_read(BENCH_FNAME, "%lf", 1, nrows, ncols, ref);
+    t_ref = elapsed_seconds(&start);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    rmat_txt_read_parallel(BENCH_FNAME, "%lf", 1, nrows, ncols, mat, 0);
+    t_lib = elapsed_seconds(&start);
+
+    identical = 1;
+    for (i = 0; i < nrows; i++)
+    {
+        identical &= memcmp(ref[i], mat[i], ncols * sizeof(double)) == 0;
+    }
+    report("rmat_txt_read_parallel", "serial", t_ref, t_lib, identical);
+    for (i = 0; i < nrows; i++)
+    {
+        free(ref[i]);
+        free(mat[i]);
+    }
+    free(ref);
+    free(mat);
+}
+
+static void
+bench_line_count(int nvalues)
+{
+    int             c;
+    unsigned int    ref_lines, lib_lines;
+    double          t_ref, t_lib;
+    double*         arr;
+    FILE*           f;
+    struct timespec start;
+
+    arr = (double*) malloc(nvalues * sizeof(double));
+    for (c = 0; c < nvalues; c++) arr[c] = 1.0 * rand() / RAND_MAX;
+    rarr_column_txt(BENCH_FNAME, REAL_SCIFMT_NOSPACE, nvalues, arr);
+    free(arr);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    ref_lines = 0;
+    f = open_file(BENCH_FNAME, "r");
+    while ((c = getc(f)) != EOF)
+    {
+        if (c == '\n') ref_lines++;
+    }
+    fclose(f);
+    t_ref = elapsed_seconds(&start);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    lib_lines = number_of_lines(BENCH_FNAME);
+    t_lib = elapsed_seconds(&start);
+    report("number_of_lines", "getc", t_ref, t_lib, ref_lines == lib_lines);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    f = open_file(BENCH_FNAME, "r");
+    for (ref_lines = 0; (c = getc(f)) != EOF;)
+    {
+        while (c != EOF && c != '\n') c = getc(f);
+        ref_lines++;
+    }
+    fclose(f);
+    t_ref = elapsed_seconds(&start);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    f = open_file(BENCH_FNAME, "r");
+    for (lib_lines = 0; lib_lines < ref_lines; lib_lines++) jump_next_line(f);
+    c = getc(f);
+    fclose(f);
+    t_lib = elapsed_seconds(&start);
+    report("jump_next_line", "getc", t_ref, t_lib, c == EOF);
+}
+
+static void
+bench_write(int nvalues)
+{
+    int             i, identical;
+    double          t_ref, t_lib;
+    double*         arr;
+    double complex* carr;
+    FILE*           f;
+    struct timespec start;
+
+    arr = (double*) malloc(nvalues * sizeof(double));
+    carr = (double complex*) malloc(nvalues * sizeof(double complex));
+    for (i = 0; i < nvalues; i++)
+    {
+        arr[i] = (2.0 * rand() / RAND_MAX - 1.0) * (1 << (rand() % 32));
+        carr[i] = CMPLX(arr[i], -1.0 * rand() / RAND_MAX);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    f = open_file(BENCH_REF_FNAME, "w");
+    for (i = 0; i < nvalues; i++) fprintf(f, REAL_SCIFMT_LINEBREAK, arr[i]);
+    fclose(f);
+    t_ref = elapsed_seconds(&start);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    rarr_column_txt(BENCH_FNAME, REAL_SCIFMT_NOSPACE, nvalues, arr);
+    t_lib = elapsed_seconds(&start);
+    identical = same_file_contents(BENCH_REF_FNAME, BENCH_FNAME);
+    report("rarr_column_txt \"%.15E\"", "stdio", t_ref, t_lib, identical);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    f = open_file(BENCH_REF_FNAME, "w");
+    for (i = 0; i < nvalues; i++)
+    {
+        fprintf(f, CPLX_SCIFMT_LINEBREAK, creal(carr[i]), cimag(carr[i]));
+    }
+    fclose(f);
+    t_ref = elapsed_seconds(&start);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    carr_column_txt(BENCH_FNAME, CPLX_SCIFMT_NOSPACE, nvalues, carr);
+    t_lib = elapsed_seconds(&start);
+    identical = same_file_contents(BENCH_REF_FNAME, BENCH_FNAME);
+    report("carr_column_txt CPLX_SCIFMT", "stdio", t_ref, t_lib, identical);
+
+    // shortest round-trip against the usual 17 significant digits
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    f = open_file(BENCH_REF_FNAME, "w");
+    for (i = 0; i < nvalues; i++) fprintf(f, "%.16E\n", arr[i]);
+    fclose(f);
+    t_ref = elapsed_seconds(&start);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    rarr_column_txt(BENCH_FNAME, REAL_SHORTFMT_NOSPACE, nvalues, arr);
+    t_lib = elapsed_seconds(&start);
+    rarr_txt_read(BENCH_FNAME, "%lf", 1, nvalues, (double*) carr);
+    identical = memcmp(arr, carr, nvalues * sizeof(double)) == 0;
+    report("rarr_column_txt \"%R\"", "%.16E", t_ref, t_lib, identical);
+
+    remove(BENCH_REF_FNAME);
+    free(arr);
+    free(carr);
+}
+
+static void
+bench_stream_record(int nvalues)
+{
+    int             i, j, nrecords, identical;
+    double          t_ref, t_lib;
+    double*         arr;
+    FILE*           f;
+    struct timespec start;
+
+    nrecords = nvalues / 10 + 1;
+    arr = (double*) malloc(4 * nrecords * sizeof(double));
+    for (i = 0; i < 4 * nrecords; i++) arr[i] = 1.0 * rand() / RAND_MAX;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    f = open_file(BENCH_REF_FNAME, "w");
+    for (i = 0; i < nrecords; i++)
+    {
+        for (j = 0; j < 4; j++)
+        {
+            fprintf(f, REAL_SCIFMT_SPACE_BEFORE, arr[4 * i + j]);
+        }
+        fputc('\n', f);
+    }
+    fclose(f);
+    t_ref = elapsed_seconds(&start);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    f = open_file(BENCH_FNAME, "w");
+    for (i = 0; i < nrecords; i++)
+    {
+        rarr_stream_record(
+            f,
+            REAL_SCIFMT_SPACE_BEFORE,
+            CURSOR_POSITION,
+            LINEBREAK,
+            4,
+            arr + 4 * i);
+    }
+    fclose(f);
+    t_lib = elapsed_seconds(&start);
+    identical = same_file_contents(BENCH_REF_FNAME, BENCH_FNAME);
+    report("rarr_stream_record 4 values", "stdio", t_ref, t_lib, identical);
+
+    remove(BENCH_REF_FNAME);
+    free(arr);
+}
+
+static void
+bench_transpose_write(int nvalues)
+{
+    int             i, j, nrows, ncols, identical;
+    double          t_ref, t_lib;
+    double **       mat, **mat_t;
+    struct timespec start;
+
+    ncols = 200;
+    nrows = nvalues / ncols + 1;
+    mat = rmat_alloc(nrows, ncols);
+    mat_t = rmat_alloc(ncols, nrows);
+    for (i = 0; i < nrows; i++)
+    {
+        for (j = 0; j < ncols; j++)
+        {
+            mat[i][j] = 1.0 * rand() / RAND_MAX;
+            mat_t[j][i] = mat[i][j];
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    rmat_txt(BENCH_REF_FNAME, REAL_SCIFMT_SPACE_BEFORE, ncols, nrows, mat_t);
+    t_ref = elapsed_seconds(&start);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    rmat_txt_transpose(
+        BENCH_FNAME, REAL_SCIFMT_SPACE_BEFORE, nrows, ncols, mat);
+    t_lib = elapsed_seconds(&start);
+    identical = same_file_contents(BENCH_REF_FNAME, BENCH_FNAME);
+    report("rmat_txt_transpose", "rows", t_ref, t_lib, identical);
+
+    remove(BENCH_REF_FNAME);
+    rmat_free(mat);
+    rmat_free(mat_t);
+}
+
+static void
+bench_parallel_write(int nvalues)
+{
+    int             i, j, nrows, ncols, nthreads, max_threads, identical;
+    double          t_ref, t_lib;
+    double**        mat;
+    char            title[64];
+    struct timespec start;
+
+    ncols = 50;
+    nrows = nvalues / ncols + 1;
+    mat = (double**) malloc(nrows * sizeof(double*));
+    for (i = 0; i < nrows; i++)
+    {
+        mat[i] = (double*) malloc(ncols * sizeof(double));
+        for (j = 0; j < ncols; j++) mat[i][j] = 1.0 * rand() / RAND_MAX;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    rmat_txt(BENCH_REF_FNAME, REAL_SCIFMT_SPACE_BEFORE, nrows, ncols, mat);
+    t_ref = elapsed_seconds(&start);
+
+    max_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    for (nthreads = 2; nthreads <= 2 * max_threads; nthreads *= 2)
+    {
+        if (nthreads > max_threads) nthreads = max_threads;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        rmat_txt_parallel(
+            BENCH_FNAME, REAL_SCIFMT_SPACE_BEFORE, nrows, ncols, mat, nthreads);
+        t_lib = elapsed_seconds(&start);
+        identical = same_file_contents(BENCH_REF_FNAME, BENCH_FNAME);
+        sprintf(title, "rmat_txt_parallel %d threads", nthreads);
+        report(title, "serial", t_ref, t_lib, identical);
+        if (nthreads == max_threads) break;
+    }
+
+    remove(BENCH_REF_FNAME);
+    for (i = 0; i < nrows; i++) free(mat[i]);
+    free(mat);
+}
+
+static void
+bench_npy(int nvalues)
+{
+    int             i, j, nrows, ncols, identical;
+    double          t_ref, t_lib;
+    double **       mat, **txt, **npy;
+    struct timespec start;
+
+    ncols = 50;
+    nrows = nvalues / ncols + 1;
+    mat = rmat_alloc(nrows, ncols);
+    txt = rmat_alloc(nrows, ncols);
+    npy = rmat_alloc(nrows, ncols);
+    for (i = 0; i < nrows; i++)
+    {
+        for (j = 0; j < ncols; j++) mat[i][j] = 1.0 * rand() / RAND_MAX;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    rmat_txt(BENCH_REF_FNAME, REAL_SHORTFMT_SPACE_BEFORE, nrows, ncols, mat);
+    t_ref = elapsed_seconds(&start);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    rmat_npy(BENCH_FNAME, nrows, ncols, mat);
+    t_lib = elapsed_seconds(&start);
+    report("rmat_npy", "%R txt", t_ref, t_lib, 1);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    rmat_txt_read(BENCH_REF_FNAME, "%lf", 1, nrows, ncols, txt);
+    t_ref = elapsed_seconds(&start);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    rmat_npy_read(BENCH_FNAME, nrows, ncols, npy);
+    t_lib = elapsed_seconds(&start);
+    identical = 1;
+    for (i = 0; i < nrows; i++)
+    {
+        identical &= memcmp(mat[i], txt[i], ncols * sizeof(double)) == 0;
+        identical &= memcmp(mat[i], npy[i], ncols * sizeof(double)) == 0;
+    }
+    report("rmat_npy_read", "%R txt", t_ref, t_lib, identical);
+
+    remove(BENCH_REF_FNAME);
+    rmat_free(mat);
+    rmat_free(txt);
+    rmat_free(npy);
+}
+
+/** Read many files of different sizes one by one and in a batch */
+static void
+bench_batch_read(int nvalues)
+{
+    int             i, k, ncols, nfailed, identical;
+    int             nrows[BENCH_NFILES];
+    double          t_ref, t_lib;
+    double*         ref[BENCH_NFILES];
+    double*         lib[BENCH_NFILES];
+    char            fnames[BENCH_NFILES][32];
+    struct ReadJob  jobs[BENCH_NFILES];
+    struct timespec start;
+
+    // file sizes grow linearly, thus the largest is about twice the mean
+    ncols = 50;
+    for (i = 0; i < BENCH_NFILES; i++)
+    {
+        nrows[i] = (long) nvalues * (i + 1) / (BENCH_NFILES * BENCH_NFILES / 2)
+                   / ncols + 1;
+        sprintf(fnames[i], "bench_batch_%d.txt", i);
+        ref[i] = (double*) malloc(nrows[i] * ncols * sizeof(double));
+        lib[i] = (double*) malloc(nrows[i] * ncols * sizeof(double));
+        for (k = 0; k < nrows[i] * ncols; k++)
+        {
+            ref[i][k] = 1.0 * rand() / RAND_MAX;
+        }
+        rrowmajor_txt(
+            fnames[i],
+            REAL_SCIFMT_SPACE_BEFORE,
+            nrows[i],
+            ncols,
+            ncols,
+            ref[i]);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < BENCH_NFILES; i++)
+    {
+        rrowmajor_txt_read(
+            fnames[i], "%lf", 0, nrows[i], ncols, ncols, ref[i]);
+    }
+    t_ref = elapsed_seconds(&start);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < BENCH_NFILES; i++)
+    {
+        rrowmajor_read_job(
+            &jobs[i], fnames[i], "%lf", 0, nrows[i], ncols, ncols, lib[i]);
+    }
+    nfailed = batch_read(jobs, BENCH_NFILES, 0);
+    t_lib = elapsed_seconds(&start);
+    identical = nfailed == 0;
+    for (i = 0; i < BENCH_NFILES; i++)
+    {
+        identical &=
+            memcmp(ref[i], lib[i], nrows[i] * ncols * sizeof(double)) == 0;
+        remove(fnames[i]);
+        free(ref[i]);
+        free(lib[i]);
+    }
+    report("batch_read", "loop", t_ref, t_lib, identical);
+}
+
+static void
+bench_slice(int nvalues)
+{
+    int                i, j, nrows, ncols, identical;
+    double             t_ref, t_lib;
+    double *           field, *stage;
+    struct MatrixSlice s;
+    struct timespec    start;
+
+    ncols = 100;
+    nrows = 2 * nvalues / ncols + 2;
+    field = (double*) malloc((size_t) nrows * ncols * sizeof(double));
+    for (i = 0; i < nrows * ncols; i++) field[i] = 1.0 * rand() / RAND_MAX;
+    s.row0 = nrows - 1;
+    s.nrows = nrows / 2;
+    s.row_step = -2;
+    s.col0 = 0;
+    s.ncols = ncols / 2;
+    s.col_step = 2;
+    s.ld = ncols;
+    s.order = ROW_MAJOR;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    stage = (double*) malloc((size_t) s.nrows * s.ncols * sizeof(double));
+    for (i = 0; i < s.nrows; i++)
+    {
+        for (j = 0; j < s.ncols; j++)
+        {
+            stage[i * s.ncols + j] =
+                field[(size_t) (s.row0 - 2 * i) * ncols + 2 * j];
+        }
+    }
+    rrowmajor_txt(
+        BENCH_REF_FNAME,
+        REAL_SCIFMT_SPACE_BEFORE,
+        s.nrows,
+        s.ncols,
+        s.ncols,
+        stage);
+    free(stage);
+    t_ref = elapsed_seconds(&start);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    rslice_txt(BENCH_FNAME, REAL_SCIFMT_SPACE_BEFORE, &s, field);
+    t_lib = elapsed_seconds(&start);
+    identical = same_file_contents(BENCH_REF_FNAME, BENCH_FNAME);
+    report("rslice_txt", "stage", t_ref, t_lib, identical);
+
+    remove(BENCH_REF_FNAME);
+    free(field);
+}
+
+int
+main(int argc, char* argv[])
+{
+    int nvalues;
+
+    nvalues = DEFAULT_NVALUES;
+    if (argc > 1) nvalues = atoi(argv[1]);
+    if (nvalues <= 0)
+    {
+        printf("\n\nERROR: invalid number of values %s\n\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+    srand(1234);
+    printf("\nBenchmark with %d values\n\n", nvalues);
+    bench_real_read(nvalues);
+    bench_complex_read(nvalues);
+    bench_parallel_read(nvalues);
+    bench_line_count(nvalues);
+    bench_write(nvalues);
+    bench_stream_record(nvalues);
+    bench_transpose_write(nvalues);
+    bench_parallel_write(nvalues);
+    bench_npy(nvalues);
+    bench_batch_read(nvalues);
+    bench_slice(nvalues);
+    remove(BENCH_FNAME);
+    printf("\n");
+    return 0;
+}
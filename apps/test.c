@@ -11,33 +11,44 @@
 
 #include "cpydataio.h"
 #include <stdlib.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
-#define ARR_SIZE 8
-char comment_char = '*';
+#define ARR_SIZE   8
+#define NJOBS      4
+#define FIFO_LINES 100000
 
 int
 main()
 {
     char rarr_fname_in[] = "test_files/real_array_inp.dat",
          rarr_fname_out[] = "test_files/real_array_out.dat",
+         rarr_fname_gz[] = "test_files/real_array_out.dat.gz",
          carr_fname_in[] = "test_files/complex_array_inp.dat",
          carr_fname_out[] = "test_files/complex_array_out.dat",
          rmat_fname_in[] = "test_files/real_matrix_inp.dat",
          rmat_fname_out[] = "test_files/real_matrix_out.dat",
          cmat_fname_in[] = "test_files/complex_matrix_inp.dat",
-         cmat_fname_out[] = "test_files/complex_matrix_out.dat";
+         cmat_fname_out[] = "test_files/complex_matrix_out.dat",
+         fifo_fname[] = "test_files/values_fifo";
 
-    double           rarr[ARR_SIZE];
+    double           rarr[ARR_SIZE], rarr_gz[ARR_SIZE], rarr_fifo[ARR_SIZE];
     double complex   carr[ARR_SIZE];
     double**         rmat;
+    double**         rmat_batch[NJOBS];
     double complex** cmat;
+    FILE*            f;
+    pid_t            writer;
+    struct IoContext ctx;
+    struct ReadJob   jobs[NJOBS];
 
-    rmat = (double**) malloc(3 * sizeof(double*));
-    for (int i = 0; i < 3; i++) rmat[i] = (double*) malloc(4 * sizeof(double));
+    io_context_init(&ctx);
+    ctx.comment_char = '*';
+    io_context_bind(&ctx);
 
-    cmat = (double complex**) malloc(4 * sizeof(double complex*));
-    for (int i = 0; i < 4; i++)
-        cmat[i] = (double complex*) malloc(3 * sizeof(double complex));
+    rmat = rmat_alloc(3, 4);
+    cmat = cmat_alloc(4, 3);
 
     rarr_txt_read(rarr_fname_in, "%lf", 1, ARR_SIZE, rarr);
     rarr_column_txt(rarr_fname_out, REAL_SCIFMT_NOSPACE, ARR_SIZE, rarr);
@@ -49,6 +60,51 @@ main()
         ARR_SIZE,
         rarr);
 
+#ifdef DATAIO_WITH_ZLIB
+    // consecutive stream readings of a compressed file continue each other
+    rarr_column_txt(rarr_fname_gz, REAL_SHORTFMT_NOSPACE, ARR_SIZE, rarr);
+    f = open_file(rarr_fname_gz, "r");
+    rarr_stream_read(f, "%lf", ARR_SIZE / 2, rarr_gz);
+    rarr_stream_read(f, "%lf", ARR_SIZE / 2, rarr_gz + ARR_SIZE / 2);
+    fclose(f);
+    for (int i = 0; i < ARR_SIZE; i++)
+    {
+        if (rarr_gz[i] != rarr[i])
+        {
+            printf("\nWrong element %d read from %s\n\n", i, rarr_fname_gz);
+            return EXIT_FAILURE;
+        }
+    }
+#endif
+
+    // pipes are read from their first byte, with nothing consumed before
+    unlink(fifo_fname);
+    if (mkfifo(fifo_fname, 0600) != 0 || (writer = fork()) < 0)
+    {
+        printf("\nUnable to create writer of %s\n\n", fifo_fname);
+        return EXIT_FAILURE;
+    }
+    if (writer == 0)
+    {
+        f = fopen(fifo_fname, "w");
+        for (int i = 1; f != NULL && i <= FIFO_LINES; i++)
+        {
+            fprintf(f, "%d\n", i);
+        }
+        _exit(0);
+    }
+    rarr_txt_read(fifo_fname, "%lf", 0, ARR_SIZE, rarr_fifo);
+    waitpid(writer, NULL, 0);
+    unlink(fifo_fname);
+    for (int i = 0; i < ARR_SIZE; i++)
+    {
+        if (rarr_fifo[i] != i + 1)
+        {
+            printf("\nWrong element %d read from %s\n\n", i, fifo_fname);
+            return EXIT_FAILURE;
+        }
+    }
+
     carr_txt_read(carr_fname_in, " (%lf%lfj)", 1, ARR_SIZE, carr);
     carr_column_txt(carr_fname_out, CPLX_SCIFMT_NOSPACE, ARR_SIZE, carr);
     carr_append_stream(
@@ -60,6 +116,37 @@ main()
         carr);
 
     rmat_txt_read(rmat_fname_in, "%lf", 1, 3, 4, (double**) rmat);
+
+    // failing jobs of a batch must not affect the others
+    for (int k = 0; k < NJOBS; k++)
+    {
+        rmat_batch[k] = rmat_alloc(5, 4);
+        rmat_read_job(&jobs[k], rmat_fname_in, "%lf", 1, 3, 4, rmat_batch[k]);
+    }
+    jobs[1].fname = "test_files/missing_inp.dat";
+    jobs[2].nrows = 5;
+    if (batch_read(jobs, NJOBS, 2) != 2 || jobs[1].status == 0
+        || jobs[2].status == 0)
+    {
+        printf("\nFailed jobs not reported in batch of %s\n\n", rmat_fname_in);
+        return EXIT_FAILURE;
+    }
+    for (int k = 0; k < NJOBS; k += 3)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            for (int j = 0; j < 4; j++)
+            {
+                if (jobs[k].status != 0 || rmat_batch[k][i][j] != rmat[i][j])
+                {
+                    printf("\nWrong batch job %d of %s\n\n", k, rmat_fname_in);
+                    return EXIT_FAILURE;
+                }
+            }
+        }
+    }
+    for (int k = 0; k < NJOBS; k++) rmat_free(rmat_batch[k]);
+
     rmat_txt(rmat_fname_out, REAL_SCIFMT_SPACE_BEFORE, 3, 4, rmat);
     rmat_append(
         rmat_fname_out, REAL_SCIFMT_SPACE_BEFORE, CURSOR_POSITION, 3, 4, rmat);
@@ -85,10 +172,8 @@ main()
         3,
         cmat);
 
-    for (int i = 0; i < 3; i++) free(rmat[i]);
-    for (int i = 0; i < 4; i++) free(cmat[i]);
-    free(rmat);
-    free(cmat);
+    rmat_free(rmat);
+    cmat_free(cmat);
 
     printf("\nTest done\n\n");
     return 0;
@@ -0,0 +1,190 @@
+/** \file async_recorder.h
+ *
+ * \author Alex Andriati
+ * \date October/2026
+ * \brief Matrix recording in a background thread
+ *
+ * Recording a checkpoint with `cmat_txt` blocks the caller for all the
+ * formatting and writing time. Here the matrix is copied to a snapshot
+ * and the call returns right away, while a background thread records
+ * the snapshot with the usual routines. The caller only pays for the
+ * copy, or for nothing when the ownership of the matrix is transferred
+ *
+ * The number of snapshots queued or being written is bounded by the
+ * depth given in `async_recorder_open`. When the queue is full, a new
+ * recording waits for the oldest to finish, thus the memory in use is
+ * bounded even if the output is slower than the computation. Snapshots
+ * of a recorder must be submitted by a single thread
+ *
+ * \code
+ * struct AsyncRecorder ar;
+ * async_recorder_open(&ar, 2);
+ * for (int step = 0; step < nsteps; step++)
+ * {
+ *     solver_step(mat);
+ *     sprintf(fname, "checkpoint_%d.txt", step);
+ *     async_cmat_txt(&ar, fname, CPLX_SCIFMT_SPACE_BEFORE, n, n, mat);
+ * }
+ * async_recorder_close(&ar);
+ * \endcode
+ */
+
+#ifndef ASYNC_RECORDER_H
+#define ASYNC_RECORDER_H
+
+#include "io_context.h"
+#include <complex.h>
+#include <pthread.h>
+
+/** \brief Default number of snapshots queued or being written */
+#define DEFAULT_ASYNC_DEPTH 2
+
+/** \brief Matrix snapshot waiting to be recorded */
+struct AsyncJob
+{
+    char*   fname;
+    char*   fmt;
+    int     ncomp;
+    int     nrows;
+    int     ncols;
+    int     ld;
+    double* data;
+};
+
+/** \brief Background thread recording a bounded queue of snapshots
+ *
+ * The background thread uses a copy of the settings of the context bound
+ * to the thread which opened the recorder, see `io_context.h`
+ *
+ * \see async_recorder_open
+ */
+struct AsyncRecorder
+{
+    pthread_t        thread;
+    pthread_mutex_t  lock;
+    pthread_cond_t   changed;
+    struct AsyncJob* jobs;
+    int              depth;
+    int              head;
+    int              count;
+    int              stop;
+    struct IoContext ctx;
+};
+
+/** \brief Start background thread to record snapshots
+ *
+ * \param[out] ar    recorder to set
+ * \param[in]  depth maximum number of snapshots queued or being written,
+ *                   or `DEFAULT_ASYNC_DEPTH` if not positive
+ */
+void
+async_recorder_open(struct AsyncRecorder* ar, int depth);
+
+/** \brief Wait until all snapshots submitted are recorded */
+void
+async_recorder_wait(struct AsyncRecorder* ar);
+
+/** \brief Wait for pending snapshots and stop the background thread */
+void
+async_recorder_close(struct AsyncRecorder* ar);
+
+/** \brief Record snapshot of complex matrix as `cmat_txt` does
+ *
+ * Return as soon as the matrix is copied, waiting before the copy if the
+ * queue is full. A formatter given by `FORMAT_PLAN` must be kept alive
+ * until the snapshot is recorded
+ *
+ * \param[in] ar    open recorder
+ * \param[in] fname name of full path to file
+ * \param[in] fmt   formatter with two double pattern in string
+ * \param[in] nrows number of rows in the matrix
+ * \param[in] ncols number of columns in the matrix
+ * \param[in] mat   matrix with values to record, free to change on return
+ *
+ * \see cmat_txt
+ */
+void
+async_cmat_txt(
+    struct AsyncRecorder* ar,
+    char                  fname[],
+    char                  fmt[],
+    int                   nrows,
+    int                   ncols,
+    double complex**      mat);
+
+/** \brief Record snapshot of real matrix as `rmat_txt` does
+ *
+ * \see async_cmat_txt
+ */
+void
+async_rmat_txt(
+    struct AsyncRecorder* ar,
+    char                  fname[],
+    char                  fmt[],
+    int                   nrows,
+    int                   ncols,
+    double**              mat);
+
+/** \brief Record snapshot of complex matrix in contiguous storage
+ *
+ * \see async_cmat_txt
+ * \see crowmajor_txt
+ */
+void
+async_crowmajor_txt(
+    struct AsyncRecorder* ar,
+    char                  fname[],
+    char                  fmt[],
+    int                   nrows,
+    int                   ncols,
+    int                   ld,
+    double complex*       mat);
+
+/** \brief Record snapshot of real matrix in contiguous storage
+ *
+ * \see async_cmat_txt
+ * \see rrowmajor_txt
+ */
+void
+async_rrowmajor_txt(
+    struct AsyncRecorder* ar,
+    char                  fname[],
+    char                  fmt[],
+    int                   nrows,
+    int                   ncols,
+    int                   ld,
+    double*               mat);
+
+/** \brief Record complex matrix in contiguous storage taking ownership
+ *
+ * No copy is made. The matrix must have been allocated with `malloc` and
+ * it is released with `free` by the background thread after recording,
+ * thus the caller must not use it anymore
+ *
+ * \see async_crowmajor_txt
+ */
+void
+async_crowmajor_txt_owned(
+    struct AsyncRecorder* ar,
+    char                  fname[],
+    char                  fmt[],
+    int                   nrows,
+    int                   ncols,
+    int                   ld,
+    double complex*       mat);
+
+/** \brief Record real matrix in contiguous storage taking ownership
+ *
+ * \see async_crowmajor_txt_owned
+ */
+void
+async_rrowmajor_txt_owned(
+    struct AsyncRecorder* ar,
+    char                  fname[],
+    char                  fmt[],
+    int                   nrows,
+    int                   ncols,
+    int                   ld,
+    double*               mat);
+
+#endif
@@ -0,0 +1,136 @@
+/** \file batch_reader.h
+ *
+ * \author Alex Andriati
+ * \date October/2026
+ * \brief Read many files concurrently with a pool of threads
+ *
+ * Reading hundreds of snapshot files one after another in a loop leaves
+ * the processors idle while waiting for the storage. Here a list of read
+ * jobs, each one equivalent to a call of the matrix readers, is shared
+ * by a bounded pool of threads. Jobs are sorted by file size and dealt
+ * to per-thread queues, largest first, and threads whose queue is empty
+ * steal jobs from the others, thus large and small files are balanced.
+ *
+ * Each job runs in its own `io_context_run`, with the settings of the
+ * context bound to the calling thread, thus a job failing does not stop
+ * the others and reports its own error
+ *
+ * \code
+ * struct ReadJob jobs[NFILES];
+ * for (int i = 0; i < NFILES; i++)
+ * {
+ *     rrowmajor_read_job(&jobs[i], fnames[i], " %lf", 0, n, n, n, mats[i]);
+ * }
+ * if (batch_read(jobs, NFILES, 0) > 0)
+ * {
+ *     for (int i = 0; i < NFILES; i++)
+ *     {
+ *         if (jobs[i].status != 0) printf("%s\n", jobs[i].error);
+ *     }
+ * }
+ * \endcode
+ */
+
+#ifndef BATCH_READER_H
+#define BATCH_READER_H
+
+#include "io_context.h"
+#include <complex.h>
+
+/** \brief Threads per processor used by default, as reads wait on I/O */
+#define BATCH_THREADS_PER_CORE 2
+
+/** \brief Matrix to read from a file and the result of the reading
+ *
+ * Destination is given either by row pointers `rows` or by contiguous
+ * storage `data` with leading dimension `ld`. After `batch_read` the
+ * `status` is 0 if the matrix was read, otherwise -1 with the reason
+ * in `error`
+ */
+struct ReadJob
+{
+    char*   fname;
+    char*   fmt;
+    int     init_line;
+    int     ncomp;
+    int     nrows;
+    int     ncols;
+    void**  rows;
+    double* data;
+    int     ld;
+    int     status;
+    char    error[IO_ERROR_SIZE];
+};
+
+/** \brief Set job reading complex matrix as `cmat_txt_read` does
+ *
+ * Strings and the matrix are not copied and must be kept alive until the
+ * batch is read
+ */
+void
+cmat_read_job(
+    struct ReadJob*  job,
+    char             fname[],
+    char             fmt[],
+    int              init_line,
+    int              nrows,
+    int              ncols,
+    double complex** mat);
+
+/** \brief Set job reading real matrix as `rmat_txt_read` does
+ *
+ * \see cmat_read_job
+ */
+void
+rmat_read_job(
+    struct ReadJob* job,
+    char            fname[],
+    char            fmt[],
+    int             init_line,
+    int             nrows,
+    int             ncols,
+    double**        mat);
+
+/** \brief Set job reading complex matrix as `crowmajor_txt_read` does
+ *
+ * \see cmat_read_job
+ */
+void
+crowmajor_read_job(
+    struct ReadJob* job,
+    char            fname[],
+    char            fmt[],
+    int             init_line,
+    int             nrows,
+    int             ncols,
+    int             ld,
+    double complex* mat);
+
+/** \brief Set job reading real matrix as `rrowmajor_txt_read` does
+ *
+ * \see cmat_read_job
+ */
+void
+rrowmajor_read_job(
+    struct ReadJob* job,
+    char            fname[],
+    char            fmt[],
+    int             init_line,
+    int             nrows,
+    int             ncols,
+    int             ld,
+    double*         mat);
+
+/** \brief Run all read jobs with a pool of threads
+ *
+ * \param[in,out] jobs     jobs to run, with status and error set
+ * \param[in]     njobs    number of jobs
+ * \param[in]     nthreads maximum number of threads, or if not positive
+ *                         `BATCH_THREADS_PER_CORE` per processor
+ *
+ * \return number of jobs which failed
+ */
+int
+batch_read(struct ReadJob* jobs, int njobs, int nthreads);
+
+#endif
@@ -0,0 +1,252 @@
+/** \file checkpoint.h
+ *
+ * \author Alex Andriati
+ * \date October/2026
+ * \brief Single binary file with many named arrays and random access
+ *
+ * A checkpoint written as one text file per array costs many opens, and
+ * any single array can only be read by parsing its whole file. Here all
+ * arrays are streamed to one file, and an index at the end records the
+ * name, kind, shape and position of each one. Readers load the index
+ * once and fetch any array, or any range of its rows, with `pread`
+ * touching only the bytes required, regardless of the file size.
+ *
+ * Arrays are stored as blocks of rows of about `CHECKPOINT_CHUNK_BYTES`,
+ * optionally compressed one by one with zlib or zstandard if the library
+ * was built with them, following `compression_level`. Values and all
+ * integers are stored in little-endian byte order.
+ *
+ * \code
+ * struct CheckpointWriter w;
+ * checkpoint_open(&w, "state.ckpt", NO_COMPRESSION);
+ * checkpoint_rmat(&w, "density", nrows, ncols, rho);
+ * checkpoint_carr(&w, "orbital", npts, psi);
+ * checkpoint_close(&w);
+ *
+ * struct CheckpointReader r;
+ * checkpoint_read_open(&r, "state.ckpt");
+ * checkpoint_rrows_read(&r, "density", 100, 10, ncols, rows);
+ * checkpoint_read_close(&r);
+ * \endcode
+ */
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "compressed_stream.h"
+#include <complex.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/** \brief Maximum length of array names, including null terminator */
+#define CHECKPOINT_NAME_MAX 64
+
+/** \brief Approximate size of the blocks of rows stored and compressed */
+#define CHECKPOINT_CHUNK_BYTES (1 << 20)
+
+/** \brief Description of one array and the position of its blocks
+ *
+ * One-dimensional arrays have `ncols` equal to 1, thus a range of their
+ * values is read as a range of rows. Block `k` holds rows starting at
+ * `k * rows_per_chunk`, and `stored[k]` bytes starting at `offsets[k]`
+ */
+struct CheckpointEntry
+{
+    char      name[CHECKPOINT_NAME_MAX];
+    int       ncomp;
+    int       ndim;
+    int       compression;
+    size_t    nrows;
+    size_t    ncols;
+    size_t    rows_per_chunk;
+    size_t    nchunks;
+    uint64_t* offsets;
+    uint64_t* stored;
+};
+
+/** \brief Checkpoint file open to append arrays */
+struct CheckpointWriter
+{
+    FILE*                   f;
+    char*                   fname;
+    enum Compression        how;
+    uint64_t                offset;
+    int                     nentries;
+    int                     capacity;
+    struct CheckpointEntry* entries;
+    char*                   chunk;
+    size_t                  chunk_size;
+    char*                   packed;
+    size_t                  packed_size;
+};
+
+/** \brief Checkpoint file open to read arrays through its index */
+struct CheckpointReader
+{
+    int                     fd;
+    char*                   fname;
+    int                     nentries;
+    struct CheckpointEntry* entries;
+};
+
+/** \brief Create checkpoint file, truncating any existing one
+ *
+ * \param[out] w     writer released with `checkpoint_close`
+ * \param[in]  fname full path to the file, without compression extension
+ * \param[in]  how   compression of each block of rows
+ */
+void
+checkpoint_open(struct CheckpointWriter* w, char fname[], enum Compression how);
+
+/** \brief Append complex array to checkpoint
+ *
+ * \param[in] w        writer set with `checkpoint_open`
+ * \param[in] name     unique name of the array in the checkpoint
+ * \param[in] arr_size number of values
+ * \param[in] arr      values to store
+ */
+void
+checkpoint_carr(
+    struct CheckpointWriter* w, char name[], int arr_size, double complex* arr);
+
+/** \brief Append real array to checkpoint
+ *
+ * \see checkpoint_carr
+ */
+void
+checkpoint_rarr(
+    struct CheckpointWriter* w, char name[], int arr_size, double* arr);
+
+/** \brief Append complex matrix to checkpoint
+ *
+ * \param[in] w     writer set with `checkpoint_open`
+ * \param[in] name  unique name of the matrix in the checkpoint
+ * \param[in] nrows number of rows in the matrix
+ * \param[in] ncols number of columns in the matrix
+ * \param[in] mat   matrix with values to store
+ */
+void
+checkpoint_cmat(
+    struct CheckpointWriter* w,
+    char                     name[],
+    int                      nrows,
+    int                      ncols,
+    double complex**         mat);
+
+/** \brief Append real matrix to checkpoint
+ *
+ * \see checkpoint_cmat
+ */
+void
+checkpoint_rmat(
+    struct CheckpointWriter* w,
+    char                     name[],
+    int                      nrows,
+    int                      ncols,
+    double**                 mat);
+
+/** \brief Append complex matrix in contiguous storage to checkpoint
+ *
+ * \see checkpoint_cmat
+ */
+void
+checkpoint_crowmajor(
+    struct CheckpointWriter* w,
+    char                     name[],
+    int                      nrows,
+    int                      ncols,
+    int                      ld,
+    double complex*          mat);
+
+/** \brief Append real matrix in contiguous storage to checkpoint
+ *
+ * \see checkpoint_cmat
+ */
+void
+checkpoint_rrowmajor(
+    struct CheckpointWriter* w,
+    char                     name[],
+    int                      nrows,
+    int                      ncols,
+    int                      ld,
+    double*                  mat);
+
+/** \brief Write the index and close checkpoint file
+ *
+ * Files whose writer is not closed have no index and cannot be read
+ */
+void
+checkpoint_close(struct CheckpointWriter* w);
+
+/** \brief Open checkpoint file loading only its index
+ *
+ * \param[out] r     reader released with `checkpoint_read_close`
+ * \param[in]  fname full path to the file
+ */
+void
+checkpoint_read_open(struct CheckpointReader* r, char fname[]);
+
+/** \brief Description of array with given name, or NULL if not found */
+const struct CheckpointEntry*
+checkpoint_find(struct CheckpointReader* r, char name[]);
+
+/** \brief Read range of rows of complex array or matrix
+ *
+ * Values of one-dimensional arrays are read as rows with one column
+ *
+ * \param[in]  r     reader set with `checkpoint_read_open`
+ * \param[in]  name  name of the array
+ * \param[in]  row0  first row to read
+ * \param[in]  nrows number of rows to read
+ * \param[in]  ld    distance between rows in `dest`, at least `ncols`
+ * \param[out] dest  rows read in contiguous storage
+ */
+void
+checkpoint_crows_read(
+    struct CheckpointReader* r,
+    char                     name[],
+    size_t                   row0,
+    int                      nrows,
+    int                      ld,
+    double complex*          dest);
+
+/** \brief Read range of rows of real array or matrix
+ *
+ * \see checkpoint_crows_read
+ */
+void
+checkpoint_rrows_read(
+    struct CheckpointReader* r,
+    char                     name[],
+    size_t                   row0,
+    int                      nrows,
+    int                      ld,
+    double*                  dest);
+
+/** \brief Load whole complex array or matrix
+ *
+ * \param[in]  r     reader set with `checkpoint_read_open`
+ * \param[in]  name  name of the array
+ * \param[out] nrows number of rows found
+ * \param[out] ncols number of columns found, 1 for arrays
+ *
+ * \return matrix in row-major format to be released with `free`
+ */
+double complex*
+checkpoint_cmat_load(
+    struct CheckpointReader* r, char name[], int* nrows, int* ncols);
+
+/** \brief Load whole real array or matrix
+ *
+ * \see checkpoint_cmat_load
+ */
+double*
+checkpoint_rmat_load(
+    struct CheckpointReader* r, char name[], int* nrows, int* ncols);
+
+/** \brief Close checkpoint file and release the index */
+void
+checkpoint_read_close(struct CheckpointReader* r);
+
+#endif
@@ -0,0 +1,78 @@
+/** \file compressed_stream.h
+ *
+ * \author Alex Andriati
+ * \date October/2026
+ * \brief Transparent compression of text files through stdio streams
+ *
+ * Data files compressed with gzip (`.gz`) or zstandard (`.zst`) are
+ * opened as ordinary `FILE*` streams, which compress on writing and
+ * decompress on reading, thus all readers and recorders work unchanged.
+ * Files are recognized by their magic bytes when read and by their name
+ * extension when written or appended.
+ *
+ * Each codec is only available if the library was built with it, using
+ * the `DATAIO_WITH_ZLIB` and `DATAIO_WITH_ZSTD` CMake options
+ */
+
+#ifndef COMPRESSED_STREAM_H
+#define COMPRESSED_STREAM_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+/** \brief Default compression level, letting each codec use its own */
+#define DEFAULT_COMPRESSION_LEVEL -1
+
+/** \brief Compression formats recognized */
+enum Compression
+{
+    NO_COMPRESSION,
+    GZIP_COMPRESSION,
+    ZSTD_COMPRESSION
+};
+
+/** \brief Compression level used when writing compressed files
+ *
+ * Follow the scale of the codec in use, 1 to 9 for gzip and 1 to 19 for
+ * zstandard. Any negative value selects the codec default. As for
+ * `comment_char` assign this global variable in the main app program
+ */
+extern int compression_level;
+
+/** \brief Compression format given by file name extension */
+enum Compression
+compression_from_name(char fname[]);
+
+/** \brief Compression format given by the first bytes of a file
+ *
+ * \param[in] magic first bytes of the file
+ * \param[in] n     number of bytes available in `magic`
+ */
+enum Compression
+compression_from_magic(const unsigned char* magic, size_t n);
+
+/** \brief Compression format of an existing file from its magic bytes
+ *
+ * Only regular files are inspected, pipes and devices are never opened
+ * and are always taken as uncompressed
+ */
+enum Compression
+compression_of_file(char fname[]);
+
+/** \brief Open compressed file as stdio stream
+ *
+ * Only plain reading, writing or appending modes are supported. Appending
+ * adds a new compressed member (gzip) or frame (zstandard) at the end,
+ * which is decompressed as continuation of the previous content. Streams
+ * are not seekable, except to move forward or to get the position
+ *
+ * \param[in] fname full path to the file
+ * \param[in] mode  stdio mode "r", "w" or "a"
+ * \param[in] how   compression format
+ *
+ * \return stream or NULL if the file could not be opened
+ */
+FILE*
+open_compressed(char fname[], char mode[], enum Compression how);
+
+#endif
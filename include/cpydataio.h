@@ -4,5 +4,17 @@
 #include "screen_print.h"
 #include "data_recorder.h"
 #include "data_reader.h"
+#include "text_scanner.h"
+#include "text_printer.h"
+#include "format_plan.h"
+#include "line_index.h"
+#include "matrix_alloc.h"
+#include "compressed_stream.h"
+#include "async_recorder.h"
+#include "npy_io.h"
+#include "checkpoint.h"
+#include "fixed_width.h"
+#include "io_context.h"
+#include "batch_reader.h"
 
 #endif
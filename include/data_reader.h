@@ -7,11 +7,34 @@
  * In general, the routines share a common API requiring file name,
  * formatter, line to start reading and array/matrix information
  *
+ * Formatters follow `fscanf` conventions, but the common double patterns
+ * as `"%lf"` and `" (%lf%lfj)"` are parsed with the faster and locale
+ * independent engine of `text_scanner.h`
  */
 
+#ifndef DATA_READER_H
+#define DATA_READER_H
+
+#include "text_scanner.h"
 #include <complex.h>
 #include <stdio.h>
 
+/** \brief Handle to read a text matrix in blocks of rows
+ *
+ * Only one block of rows needs to be in memory at a time, allowing to
+ * process files much larger than the available memory
+ *
+ * \see block_reader_open
+ */
+struct BlockReader
+{
+    char*              fname;
+    FILE*              f;
+    int                ncols;
+    int                rows_read;
+    struct TextScanner sc;
+};
+
 /** \brief Read consecutive formatted complex numbers from text file
  *
  * \param[in] fname     full path to the file
@@ -91,3 +114,276 @@ rmat_txt_read(
     int      nrows,
     int      ncols,
     double** mat);
+
+/** \brief Read complex matrix parsing chunks of the file concurrently
+ *
+ * Parallel version of `cmat_txt_read`. The file is split at linebreaks
+ * in chunks which are parsed by a pool of threads, writing the values
+ * directly to the respective matrix rows. The result is bit-identical
+ * to `cmat_txt_read`
+ *
+ * \warning Every matrix row must be in a single line of the file, as
+ *          recorded by `cmat_txt`. Blank lines are ignored
+ *
+ * \note Files that cannot be memory mapped (pipes, compressed files) or
+ *       formatters not supported by `text_scanner.h` are read serially
+ *
+ * \param[in] fname     full path to text file
+ * \param[in] fmt       string formatter for every scanf
+ * \param[in] init_line line number to start reading
+ * \param[in] nrows     number of rows in the matrix
+ * \param[in] ncols     number of columns in the matrix
+ * \param[out] mat      matrix to set with values read
+ * \param[in] nthreads  number of threads. If not positive, use all cores
+ *
+ * \see cmat_txt_read
+ */
+void
+cmat_txt_read_parallel(
+    char   fname[],
+    char   fmt[],
+    int    init_line,
+    int    nrows,
+    int    ncols,
+    double complex** mat,
+    int    nthreads);
+
+/** \brief Read real matrix parsing chunks of the file concurrently
+ *
+ * Parallel version of `rmat_txt_read` with the same requirements
+ * of `cmat_txt_read_parallel`
+ *
+ * \see cmat_txt_read_parallel
+ * \see rmat_txt_read
+ */
+void
+rmat_txt_read_parallel(
+    char     fname[],
+    char     fmt[],
+    int      init_line,
+    int      nrows,
+    int      ncols,
+    double** mat,
+    int      nthreads);
+
+/** \brief Load complex matrix of unknown shape in a single pass
+ *
+ * Equivalent to numpy loadtxt. Each non-blank line of the file is a
+ * matrix row and the number of columns is set by the first one. The
+ * values are written in a contiguous buffer which grows while parsing,
+ * thus there is no need to count the lines in advance
+ *
+ * \warning The formatter must be supported by `text_scanner.h`, as
+ *          `" (%lf%lfj)"`
+ *
+ * \param[in]  fname     full path to text file
+ * \param[in]  fmt       string formatter for every complex number
+ * \param[in]  init_line line number to start reading
+ * \param[out] nrows     number of rows found
+ * \param[out] ncols     number of columns found
+ *
+ * \return matrix in row-major format to be released with `free`, or NULL
+ *         if no value was found
+ */
+double complex*
+cmat_load(char fname[], char fmt[], int init_line, int* nrows, int* ncols);
+
+/** \brief Load real matrix of unknown shape in a single pass
+ *
+ * Equivalent to numpy loadtxt, see `cmat_load` for details
+ *
+ * \see cmat_load
+ */
+double*
+rmat_load(char fname[], char fmt[], int init_line, int* nrows, int* ncols);
+
+/** \brief Read only some columns of a complex matrix
+ *
+ * Equivalent to numpy loadtxt with `usecols`. Each non-blank line of the
+ * file is a matrix row, in which the columns not requested are only
+ * tokenized, without conversion, and those after the last requested
+ * column are not touched at all
+ *
+ * \warning The formatter must be supported by `text_scanner.h`, as
+ *          `" (%lf%lfj)"`
+ *
+ * \param[in] fname     full path to text file
+ * \param[in] fmt       string formatter for every complex number
+ * \param[in] init_line line number to start reading
+ * \param[in] nrows     number of rows to read
+ * \param[in] nusecols  number of columns requested
+ * \param[in] usecols   column indexes in the file, starting from 0
+ * \param[out] mat      compact matrix with `nrows` rows and `nusecols`
+ *                      columns where `mat[i][k]` is taken from column
+ *                      `usecols[k]` of the file
+ */
+void
+cmat_txt_read_cols(
+    char   fname[],
+    char   fmt[],
+    int    init_line,
+    int    nrows,
+    int    nusecols,
+    int    usecols[],
+    double complex** mat);
+
+/** \brief Read only some columns of a real matrix
+ *
+ * Equivalent to numpy loadtxt with `usecols`, see `cmat_txt_read_cols`
+ *
+ * \see cmat_txt_read_cols
+ */
+void
+rmat_txt_read_cols(
+    char     fname[],
+    char     fmt[],
+    int      init_line,
+    int      nrows,
+    int      nusecols,
+    int      usecols[],
+    double** mat);
+
+/** \brief Open text file to read a matrix in blocks of rows
+ *
+ * The matrix is read as a sequence of values, with the same semantics
+ * of `rarr_stream_read` and `carr_stream_read`, but every block is
+ * filled with a whole number of rows
+ *
+ * \param[out] r         reader handle to set
+ * \param[in]  fname     full path to text file
+ * \param[in]  fmt       string formatter for every scanf
+ * \param[in]  init_line line number to start reading
+ * \param[in]  ncols     number of columns in the matrix
+ */
+void
+block_reader_open(
+    struct BlockReader* r, char fname[], char fmt[], int init_line, int ncols);
+
+/** \brief Read next block of rows of a complex matrix
+ *
+ * If an error is raised the reader is closed, thus a later call of
+ * `block_reader_close` does nothing
+ *
+ * \param[in]  r        reader handle set by `block_reader_open`
+ * \param[in]  max_rows maximum number of rows to read
+ * \param[out] block    row-major buffer of at least `max_rows * ncols`
+ *
+ * \return number of rows read, which is zero at the end of the file
+ */
+int
+cmat_next_block(struct BlockReader* r, int max_rows, double complex* block);
+
+/** \brief Read next block of rows of a real matrix
+ *
+ * \see cmat_next_block
+ */
+int
+rmat_next_block(struct BlockReader* r, int max_rows, double* block);
+
+/** \brief Close file of block reader handle, if not closed yet */
+void
+block_reader_close(struct BlockReader* r);
+
+/** \brief Read complex matrix in contiguous row-major storage
+ *
+ * Same as `cmat_txt_read` but the element in row `i` and column `j` is
+ * set in `mat[i * ld + j]`
+ *
+ * \param[in] fname     full path to text file
+ * \param[in] fmt       string formatter for every scanf
+ * \param[in] init_line line number to start reading
+ * \param[in] nrows     number of rows in the matrix
+ * \param[in] ncols     number of columns in the matrix
+ * \param[in] ld        leading dimension, at least `ncols`
+ * \param[out] mat      contiguous matrix to set with values read
+ *
+ * \see cmat_txt_read
+ */
+void
+crowmajor_txt_read(
+    char            fname[],
+    char            fmt[],
+    int             init_line,
+    int             nrows,
+    int             ncols,
+    int             ld,
+    double complex* mat);
+
+/** \brief Read real matrix in contiguous row-major storage
+ *
+ * \see crowmajor_txt_read
+ * \see rmat_txt_read
+ */
+void
+rrowmajor_txt_read(
+    char    fname[],
+    char    fmt[],
+    int     init_line,
+    int     nrows,
+    int     ncols,
+    int     ld,
+    double* mat);
+
+/** \brief Parallel read of complex matrix in contiguous storage
+ *
+ * \see cmat_txt_read_parallel
+ * \see crowmajor_txt_read
+ */
+void
+crowmajor_txt_read_parallel(
+    char            fname[],
+    char            fmt[],
+    int             init_line,
+    int             nrows,
+    int             ncols,
+    int             ld,
+    double complex* mat,
+    int             nthreads);
+
+/** \brief Parallel read of real matrix in contiguous storage
+ *
+ * \see rmat_txt_read_parallel
+ * \see rrowmajor_txt_read
+ */
+void
+rrowmajor_txt_read_parallel(
+    char    fname[],
+    char    fmt[],
+    int     init_line,
+    int     nrows,
+    int     ncols,
+    int     ld,
+    double* mat,
+    int     nthreads);
+
+/** \brief Read some columns of complex matrix to contiguous storage
+ *
+ * \see cmat_txt_read_cols
+ */
+void
+crowmajor_txt_read_cols(
+    char            fname[],
+    char            fmt[],
+    int             init_line,
+    int             nrows,
+    int             nusecols,
+    int             usecols[],
+    int             ld,
+    double complex* mat);
+
+/** \brief Read some columns of real matrix to contiguous storage
+ *
+ * \see rmat_txt_read_cols
+ */
+void
+rrowmajor_txt_read_cols(
+    char    fname[],
+    char    fmt[],
+    int     init_line,
+    int     nrows,
+    int     nusecols,
+    int     usecols[],
+    int     ld,
+    double* mat);
+
+#endif
@@ -17,14 +17,92 @@
  * For instance the `carr_column_txt` is equivalent to first open the
  * file and then call `carr_stream_record` using the formatter with a
  * linebreak character '\n' appended.
+ *
+ * Matrices are given either as arrays of row pointers (`mat` prefixes) or
+ * in contiguous row-major storage with a leading dimension (`rowmajor`
+ * prefixes), where the element in row `i` and column `j` is `mat[i*ld+j]`
+ *
+ * Slices of contiguous storage, as sub-blocks, every few rows or columns
+ * in reverse order, or column-major matrices, are described by `struct
+ * MatrixSlice` and recorded by the `slice` routines straight from the
+ * source memory, with no staging copy
+ *
+ * Values are formatted with the `text_printer.h` engine, which gives the
+ * same text of `fprintf` for exponential formatters and also supports
+ * the shortest round-trip `*_SHORTFMT_*` formatters. Formatters compiled
+ * once with `format_plan_compile` can be given using `FORMAT_PLAN`
  */
 
 #ifndef DATA_RECORDER_H
 #define DATA_RECORDER_H
 
 #include "file_handle.h"
+#include "text_printer.h"
 #include <complex.h>
+#include <stddef.h>
 #include <stdio.h>
+#include <time.h>
+
+/** \brief Order of contiguous matrix storage: ROW_MAJOR/COL_MAJOR */
+enum StorageOrder
+{
+    ROW_MAJOR,
+    COL_MAJOR
+};
+
+/** \brief Rows and columns of a matrix in contiguous storage to record
+ *
+ * Element `(i, j)` of the slice, for `0 <= i < nrows` and `0 <= j < ncols`,
+ * is element `(row0 + i * row_step, col0 + j * col_step)` of the source,
+ * stored in `mat[row * ld + col]` for `ROW_MAJOR` order and in
+ * `mat[col * ld + row]` for `COL_MAJOR`. Steps may be negative to record
+ * rows or columns in reverse order, starting from `row0` or `col0`
+ *
+ * \code
+ * // every 10th time step of the last 100 columns, newest first
+ * struct MatrixSlice s = {.row0 = nt - 1, .nrows = nt / 10, .row_step = -10,
+ *                         .col0 = nx - 100, .ncols = 100, .col_step = 1,
+ *                         .ld = nx, .order = ROW_MAJOR};
+ * rslice_txt("history.txt", REAL_SCIFMT_SPACE_BEFORE, &s, field);
+ * \endcode
+ */
+struct MatrixSlice
+{
+    int               row0;
+    int               nrows;
+    int               row_step;
+    int               col0;
+    int               ncols;
+    int               col_step;
+    int               ld;
+    enum StorageOrder order;
+};
+
+/** \brief Whether session flushes force data to disk: NO_SYNC/SYNC */
+enum SessionSync
+{
+    NO_SYNC,
+    SYNC
+};
+
+/** \brief Recorder keeping a file open for repeated appends
+ *
+ * Replace the `*_append*` routines when recording at every time step of
+ * a simulation, avoiding to open and close the file in each call. The
+ * records, one for each call, are kept in a buffer written to the file
+ * according to the policy set in `record_session_policy`
+ *
+ * \see record_session_open
+ */
+struct RecordSession
+{
+    struct TextPrinter pr;
+    int                flush_records;
+    int                flush_ms;
+    enum SessionSync   sync;
+    int                pending;
+    struct timespec    last_flush;
+};
 
 /** \brief Record array of complex values in open file
  *
@@ -287,6 +365,51 @@ rmat_append_transpose(
     int              ncols,
     double**         mat);
 
+/** \brief Record complex matrix formatting rows concurrently
+ *
+ * Parallel version of `cmat_txt`. Chunks of rows are formatted by a pool
+ * of threads in memory buffers, which are written to the file in order
+ * as soon as ready. The file is identical to the one of `cmat_txt`, and
+ * the memory in use is bounded by a few chunks per thread
+ *
+ * \note Formatters not supported by `text_printer.h` and small matrices
+ *       are recorded serially
+ *
+ * \param[in] fname    name of full path to file
+ * \param[in] fmt      formatter with two double pattern in string
+ * \param[in] nrows    number of rows in the matrix
+ * \param[in] ncols    number of columns in the matrix
+ * \param[in] mat      matrix with values to record
+ * \param[in] nthreads number of threads. If not positive, use all cores
+ *
+ * \see cmat_txt
+ */
+void
+cmat_txt_parallel(
+    char             fname[],
+    char             fmt[],
+    int              nrows,
+    int              ncols,
+    double complex** mat,
+    int              nthreads);
+
+/** \brief Record real matrix formatting rows concurrently
+ *
+ * Parallel version of `rmat_txt` with the same behavior of
+ * `cmat_txt_parallel`
+ *
+ * \see cmat_txt_parallel
+ * \see rmat_txt
+ */
+void
+rmat_txt_parallel(
+    char     fname[],
+    char     fmt[],
+    int      nrows,
+    int      ncols,
+    double** mat,
+    int      nthreads);
+
 /** \brief Record stream of values from complex matrix in rowmajor format
  *
  * Equivalent to set the matrix in rowmajor format and call
@@ -409,4 +532,505 @@ rmat_rowmajor_append_stream(
     int               ncols,
     double**          mat);
 
+/** \brief Record complex matrix in contiguous storage to text file
+ *
+ * \param[in] fname name of full path to file
+ * \param[in] fmt   formatter with two double pattern in string
+ * \param[in] nrows number of rows in the matrix
+ * \param[in] ncols number of columns in the matrix
+ * \param[in] ld    leading dimension, at least `ncols`
+ * \param[in] mat   contiguous row-major matrix with values to record
+ *
+ * \see cmat_txt
+ */
+void
+crowmajor_txt(
+    char            fname[],
+    char            fmt[],
+    int             nrows,
+    int             ncols,
+    int             ld,
+    double complex* mat);
+
+/** \brief Record complex matrix in contiguous storage appending to file
+ *
+ * \see cmat_append
+ */
+void
+crowmajor_append(
+    char             fname[],
+    char             fmt[],
+    enum StartStream how_start,
+    int              nrows,
+    int              ncols,
+    int              ld,
+    double complex*  mat);
+
+/** \brief Record transpose of complex matrix in contiguous storage
+ *
+ * \see cmat_txt_transpose
+ */
+void
+crowmajor_txt_transpose(
+    char            fname[],
+    char            fmt[],
+    int             nrows,
+    int             ncols,
+    int             ld,
+    double complex* mat);
+
+/** \brief Append transpose of complex matrix in contiguous storage
+ *
+ * \see cmat_append_transpose
+ */
+void
+crowmajor_append_transpose(
+    char             fname[],
+    char             fmt[],
+    enum StartStream how_start,
+    int              nrows,
+    int              ncols,
+    int              ld,
+    double complex*  mat);
+
+/** \brief Record stream of values from complex matrix in contiguous storage
+ *
+ * \see cmat_rowmajor_stream
+ */
+void
+crowmajor_stream(
+    FILE*             f,
+    char              fmt[],
+    enum StartStream  how_start,
+    enum FinishStream how_finish,
+    int               nrows,
+    int               ncols,
+    int               ld,
+    double complex*   mat);
+
+/** \brief Record complex matrix in contiguous storage as column matrix
+ *
+ * \see cmat_rowmajor_column_txt
+ */
+void
+crowmajor_column_txt(
+    char            fname[],
+    char            fmt[],
+    int             nrows,
+    int             ncols,
+    int             ld,
+    double complex* mat);
+
+/** \brief Append complex matrix in contiguous storage as stream of values
+ *
+ * \see cmat_rowmajor_append_stream
+ */
+void
+crowmajor_append_stream(
+    char              fname[],
+    char              fmt[],
+    enum StartStream  how_start,
+    enum FinishStream how_finish,
+    int               nrows,
+    int               ncols,
+    int               ld,
+    double complex*   mat);
+
+/** \brief Record real matrix in contiguous storage to text file
+ *
+ * \see crowmajor_txt
+ * \see rmat_txt
+ */
+void
+rrowmajor_txt(
+    char fname[], char fmt[], int nrows, int ncols, int ld, double* mat);
+
+/** \brief Record real matrix in contiguous storage appending to file
+ *
+ * \see rmat_append
+ */
+void
+rrowmajor_append(
+    char             fname[],
+    char             fmt[],
+    enum StartStream how_start,
+    int              nrows,
+    int              ncols,
+    int              ld,
+    double*          mat);
+
+/** \brief Record transpose of real matrix in contiguous storage
+ *
+ * \see rmat_txt_transpose
+ */
+void
+rrowmajor_txt_transpose(
+    char fname[], char fmt[], int nrows, int ncols, int ld, double* mat);
+
+/** \brief Append transpose of real matrix in contiguous storage
+ *
+ * \see rmat_append_transpose
+ */
+void
+rrowmajor_append_transpose(
+    char             fname[],
+    char             fmt[],
+    enum StartStream how_start,
+    int              nrows,
+    int              ncols,
+    int              ld,
+    double*          mat);
+
+/** \brief Record stream of values from real matrix in contiguous storage
+ *
+ * \see rmat_rowmajor_stream
+ */
+void
+rrowmajor_stream(
+    FILE*             f,
+    char              fmt[],
+    enum StartStream  how_start,
+    enum FinishStream how_finish,
+    int               nrows,
+    int               ncols,
+    int               ld,
+    double*           mat);
+
+/** \brief Record real matrix in contiguous storage as column matrix
+ *
+ * \see rmat_rowmajor_column_txt
+ */
+void
+rrowmajor_column_txt(
+    char fname[], char fmt[], int nrows, int ncols, int ld, double* mat);
+
+/** \brief Append real matrix in contiguous storage as stream of values
+ *
+ * \see rmat_rowmajor_append_stream
+ */
+void
+rrowmajor_append_stream(
+    char              fname[],
+    char              fmt[],
+    enum StartStream  how_start,
+    enum FinishStream how_finish,
+    int               nrows,
+    int               ncols,
+    int               ld,
+    double*           mat);
+
+/** \brief Record complex matrix in contiguous storage concurrently
+ *
+ * \see cmat_txt_parallel
+ * \see crowmajor_txt
+ */
+void
+crowmajor_txt_parallel(
+    char            fname[],
+    char            fmt[],
+    int             nrows,
+    int             ncols,
+    int             ld,
+    double complex* mat,
+    int             nthreads);
+
+/** \brief Record real matrix in contiguous storage concurrently
+ *
+ * \see cmat_txt_parallel
+ * \see rrowmajor_txt
+ */
+void
+rrowmajor_txt_parallel(
+    char    fname[],
+    char    fmt[],
+    int     nrows,
+    int     ncols,
+    int     ld,
+    double* mat,
+    int     nthreads);
+
+/** \brief Record slice of complex matrix in contiguous storage
+ *
+ * Values are read in place from `mat`, thus any slice is recorded with
+ * no copy, each of its rows in a line of the file
+ *
+ * \param[in] fname full path of file to write
+ * \param[in] fmt   formatter for one complex number
+ * \param[in] s     rows and columns of the source to record
+ * \param[in] mat   source matrix with `(0, 0)` element at `mat[0]`
+ *
+ * \see struct MatrixSlice
+ */
+void
+cslice_txt(
+    char fname[], char fmt[], struct MatrixSlice* s, double complex* mat);
+
+/** \brief Record slice of complex matrix appending to file
+ *
+ * \see cslice_txt
+ */
+void
+cslice_append(
+    char                fname[],
+    char                fmt[],
+    enum StartStream    how_start,
+    struct MatrixSlice* s,
+    double complex*     mat);
+
+/** \brief Record slice of complex matrix as stream of values in open file
+ *
+ * \see cslice_txt
+ * \see crowmajor_stream
+ */
+void
+cslice_stream(
+    FILE*               f,
+    char                fmt[],
+    enum StartStream    how_start,
+    enum FinishStream   how_finish,
+    struct MatrixSlice* s,
+    double complex*     mat);
+
+/** \brief Record slice of complex matrix concurrently
+ *
+ * \see cslice_txt
+ * \see cmat_txt_parallel
+ */
+void
+cslice_txt_parallel(
+    char                fname[],
+    char                fmt[],
+    struct MatrixSlice* s,
+    double complex*     mat,
+    int                 nthreads);
+
+/** \brief Record slice of real matrix in contiguous storage
+ *
+ * \see cslice_txt
+ */
+void
+rslice_txt(char fname[], char fmt[], struct MatrixSlice* s, double* mat);
+
+/** \brief Record slice of real matrix appending to file
+ *
+ * \see cslice_append
+ */
+void
+rslice_append(
+    char                fname[],
+    char                fmt[],
+    enum StartStream    how_start,
+    struct MatrixSlice* s,
+    double*             mat);
+
+/** \brief Record slice of real matrix as stream of values in open file
+ *
+ * \see cslice_stream
+ */
+void
+rslice_stream(
+    FILE*               f,
+    char                fmt[],
+    enum StartStream    how_start,
+    enum FinishStream   how_finish,
+    struct MatrixSlice* s,
+    double*             mat);
+
+/** \brief Record slice of real matrix concurrently
+ *
+ * \see cslice_txt_parallel
+ */
+void
+rslice_txt_parallel(
+    char                fname[],
+    char                fmt[],
+    struct MatrixSlice* s,
+    double*             mat,
+    int                 nthreads);
+
+/** \brief Open file in append mode for a recorder session
+ *
+ * Initially, records are written only when the buffer is full, on
+ * `record_session_flush` or on `record_session_close`
+ *
+ * \param[out] s     session to set
+ * \param[in]  fname full path to the file
+ */
+void
+record_session_open(struct RecordSession* s, char fname[]);
+
+/** \brief Set when the session writes its records to the file
+ *
+ * \param[in] s             open session
+ * \param[in] every_records flush after this number of records, or only
+ *                          on close if not positive
+ * \param[in] every_ms      flush in the first record after this time in
+ *                          milliseconds, or only on close if not positive
+ * \param[in] sync          whether each flush also calls `fsync`
+ */
+void
+record_session_policy(
+    struct RecordSession* s,
+    int                   every_records,
+    int                   every_ms,
+    enum SessionSync      sync);
+
+/** \brief Write all records of the session to the file */
+void
+record_session_flush(struct RecordSession* s);
+
+/** \brief Flush records and close the file of the session */
+void
+record_session_close(struct RecordSession* s);
+
+/** \brief Session version of `carr_append_stream` */
+void
+session_carr_append_stream(
+    struct RecordSession* s,
+    char                  fmt[],
+    enum StartStream      how_start,
+    enum FinishStream     how_finish,
+    int                   arr_size,
+    double complex*       arr);
+
+/** \brief Session version of `rarr_append_stream` */
+void
+session_rarr_append_stream(
+    struct RecordSession* s,
+    char                  fmt[],
+    enum StartStream      how_start,
+    enum FinishStream     how_finish,
+    int                   arr_size,
+    double*               arr);
+
+/** \brief Session version of `cmat_append` */
+void
+session_cmat_append(
+    struct RecordSession* s,
+    char                  fmt[],
+    enum StartStream      how_start,
+    int                   nrows,
+    int                   ncols,
+    double complex**      mat);
+
+/** \brief Session version of `rmat_append` */
+void
+session_rmat_append(
+    struct RecordSession* s,
+    char                  fmt[],
+    enum StartStream      how_start,
+    int                   nrows,
+    int                   ncols,
+    double**              mat);
+
+/** \brief Session version of `cmat_append_transpose` */
+void
+session_cmat_append_transpose(
+    struct RecordSession* s,
+    char                  fmt[],
+    enum StartStream      how_start,
+    int                   nrows,
+    int                   ncols,
+    double complex**      mat);
+
+/** \brief Session version of `rmat_append_transpose` */
+void
+session_rmat_append_transpose(
+    struct RecordSession* s,
+    char                  fmt[],
+    enum StartStream      how_start,
+    int                   nrows,
+    int                   ncols,
+    double**              mat);
+
+/** \brief Session version of `cmat_rowmajor_append_stream` */
+void
+session_cmat_rowmajor_append_stream(
+    struct RecordSession* s,
+    char                  fmt[],
+    enum StartStream      how_start,
+    enum FinishStream     how_finish,
+    int                   nrows,
+    int                   ncols,
+    double complex**      mat);
+
+/** \brief Session version of `rmat_rowmajor_append_stream` */
+void
+session_rmat_rowmajor_append_stream(
+    struct RecordSession* s,
+    char                  fmt[],
+    enum StartStream      how_start,
+    enum FinishStream     how_finish,
+    int                   nrows,
+    int                   ncols,
+    double**              mat);
+
+/** \brief Session version of `crowmajor_append` */
+void
+session_crowmajor_append(
+    struct RecordSession* s,
+    char                  fmt[],
+    enum StartStream      how_start,
+    int                   nrows,
+    int                   ncols,
+    int                   ld,
+    double complex*       mat);
+
+/** \brief Session version of `rrowmajor_append` */
+void
+session_rrowmajor_append(
+    struct RecordSession* s,
+    char                  fmt[],
+    enum StartStream      how_start,
+    int                   nrows,
+    int                   ncols,
+    int                   ld,
+    double*               mat);
+
+/** \brief Session version of `crowmajor_append_transpose` */
+void
+session_crowmajor_append_transpose(
+    struct RecordSession* s,
+    char                  fmt[],
+    enum StartStream      how_start,
+    int                   nrows,
+    int                   ncols,
+    int                   ld,
+    double complex*       mat);
+
+/** \brief Session version of `rrowmajor_append_transpose` */
+void
+session_rrowmajor_append_transpose(
+    struct RecordSession* s,
+    char                  fmt[],
+    enum StartStream      how_start,
+    int                   nrows,
+    int                   ncols,
+    int                   ld,
+    double*               mat);
+
+/** \brief Session version of `crowmajor_append_stream` */
+void
+session_crowmajor_append_stream(
+    struct RecordSession* s,
+    char                  fmt[],
+    enum StartStream      how_start,
+    enum FinishStream     how_finish,
+    int                   nrows,
+    int                   ncols,
+    int                   ld,
+    double complex*       mat);
+
+/** \brief Session version of `rrowmajor_append_stream` */
+void
+session_rrowmajor_append_stream(
+    struct RecordSession* s,
+    char                  fmt[],
+    enum StartStream      how_start,
+    enum FinishStream     how_finish,
+    int                   nrows,
+    int                   ncols,
+    int                   ld,
+    double*               mat);
+
 #endif
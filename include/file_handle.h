@@ -12,6 +12,7 @@
 #ifndef FILE_HANDLE_H
 #define FILE_HANDLE_H
 
+#include <stddef.h>
 #include <stdio.h>
 
 /** \brief How to start operation in open file: CURSOR_POSITION/NEXT_LINE */
@@ -38,6 +39,22 @@ enum FinishStream
 #define REAL_SCIFMT_SPACE_AFTER  "%.15E "
 #define REAL_SCIFMT_NOSPACE      "%.15E"
 #define REAL_SCIFMT_LINEBREAK    "%.15E\n"
+/** \brief Shortest round-trip formatters, only understood by recorders
+ *
+ * The `%R` conversion is not standard and must not be given to printf
+ * functions. Numbers are written in exponential notation with as few
+ * digits as needed to read back exactly the same value
+ */
+#define CPLX_SHORTFMT_SPACE_BOTH   " (%R%+Rj) "
+#define CPLX_SHORTFMT_SPACE_BEFORE " (%R%+Rj)"
+#define CPLX_SHORTFMT_SPACE_AFTER  "(%R%+Rj) "
+#define CPLX_SHORTFMT_NOSPACE      "(%R%+Rj)"
+#define CPLX_SHORTFMT_LINEBREAK    "(%R%+Rj)\n"
+#define REAL_SHORTFMT_SPACE_BOTH   " %R "
+#define REAL_SHORTFMT_SPACE_BEFORE " %R"
+#define REAL_SHORTFMT_SPACE_AFTER  "%R "
+#define REAL_SHORTFMT_NOSPACE      "%R"
+#define REAL_SHORTFMT_LINEBREAK    "%R\n"
 /** \brief Default character used to indicate beginning of comment lines */
 #define DEFAULT_COMMENT_CHAR     '#'
 
@@ -47,19 +64,53 @@ enum FinishStream
  * as throughout configuration files. This global variable defines which
  * character will trigger a comment line. By default it is '#', but the
  * client application can set to a different value. To change '#' to any
- * other character assign this global variable in the main app program
+ * other character assign this global variable in the main app program,
+ * or use a context of `io_context.h` for settings of a single thread
  */
 extern char comment_char;
 
+/** \brief Read-only memory map of a whole file
+ *
+ * Alternative input source to `FILE*` avoiding copies to stdio buffers.
+ * Text is taken in the range `data` to `data + size`, which is **not**
+ * null terminated
+ */
+struct MappedFile
+{
+    char*  data;
+    size_t size;
+};
+
 /** \brief Exit with failure if file pointer is NULL reporting a message */
 void
 assert_file_pointer(FILE* f, char client_msg[]);
 
-/** \brief Just improved fopen with NULL pointer check */
+/** \brief Just improved fopen with NULL pointer check
+ *
+ * Compressed files are transparently handled, detected by magic bytes
+ * when reading and by `.gz` or `.zst` name extension otherwise
+ *
+ * \see compressed_stream.h
+ */
 FILE*
 open_file(char fname[], char mode[]);
 
-/** \brief Return number of lines in a file */
+/** \brief Return number of linebreaks in text range
+ *
+ * Use AVX2 or SSE2 instructions if the running CPU supports them, which
+ * is checked only once, and `memchr` otherwise
+ */
+size_t
+count_linebreaks(const char* pos, const char* end);
+
+/** \brief Return number of lines in a file
+ *
+ * Lines are counted after the comment lines at the beginning of the file.
+ * Regular files are memory mapped and other files read in large blocks
+ *
+ * \note To read a matrix of unknown shape prefer `rmat_load` and
+ *       `cmat_load` which avoid reading the file twice
+ */
 unsigned int
 number_of_lines(char fname[]);
 
@@ -82,4 +133,39 @@ jump_next_line(FILE* f);
 void
 jump_comment_lines(FILE* f, enum StartStream how_start);
 
+/** \brief Map file contents in memory for sequential reading
+ *
+ * Only non-empty regular and uncompressed files can be mapped. For pipes
+ * and other kind of files stdio functions must be used instead
+ *
+ * \param[in]  fname full path to the file
+ * \param[out] mf    mapped file information
+ *
+ * \return 1 if the file was mapped and 0 otherwise
+ */
+int
+map_file(char fname[], struct MappedFile* mf);
+
+/** \brief Release memory map set by `map_file` */
+void
+unmap_file(struct MappedFile* mf);
+
+/** \brief Return position of the beginning of next line in text range */
+const char*
+skip_next_line(const char* pos, const char* end);
+
+/** \brief Return position of first line not starting with `comment_char`
+ *
+ * Equivalent of `jump_comment_lines` for text in memory
+ *
+ * \param[in] pos       current position in text
+ * \param[in] end       end of text (one past the last valid character)
+ * \param[in] how_start Either CURSOR_POSITION or NEXT_LINE
+ *
+ * \see jump_comment_lines
+ */
+const char*
+skip_comment_lines(
+    const char* pos, const char* end, enum StartStream how_start);
+
 #endif
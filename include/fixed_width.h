@@ -0,0 +1,152 @@
+/** \file fixed_width.h
+ *
+ * \author Alex Andriati
+ * \date October/2026
+ * \brief Text matrices with fixed width values for random access
+ *
+ * Values written by the recorders have variable width, thus the element
+ * in row `i` and column `j` can only be found scanning the file from its
+ * start. Here every value is right aligned in a field of constant width
+ * and every line has the same number of bytes, the row stride, recorded
+ * with the shape in a header comment line of `FIXED_HEADER_SIZE` bytes.
+ * Any row or value is then read with a single `pread`, rows are updated
+ * in place with `pwrite`, and disjoint rows are written concurrently by
+ * many threads.
+ *
+ * Real values are written as `%.<precision>E` and complex ones as
+ * `(%.<precision>E%+.<precision>Ej)`, as the `*_SCIFMT_*` formatters,
+ * thus the files are loaded by numpy `loadtxt` and by the readers of
+ * `data_reader.h`, which skip the header comment. Precision given by
+ * `SHORTEST_PRECISION` writes the shortest round-trip text
+ */
+
+#ifndef FIXED_WIDTH_H
+#define FIXED_WIDTH_H
+
+#include <complex.h>
+#include <stddef.h>
+
+/** \brief Size in bytes of the header line, including the linebreak */
+#define FIXED_HEADER_SIZE 128
+
+/** \brief Text file with fixed width values open for random access
+ *
+ * `width` is the number of characters of each value field, including at
+ * least one leading space, and `stride` the number of bytes of each line
+ */
+struct FixedWidthText
+{
+    int    fd;
+    char*  fname;
+    int    ncomp;
+    int    nrows;
+    int    ncols;
+    int    precision;
+    int    width;
+    size_t stride;
+};
+
+/** \brief Record complex matrix with fixed width values
+ *
+ * Rows are formatted and written directly in their positions of the file
+ * by `nthreads` threads, or as many as processors available if not
+ * positive
+ *
+ * \param[in] fname     full path to the file, without compression
+ * \param[in] precision digits after the point or `SHORTEST_PRECISION`
+ * \param[in] nrows     number of rows in the matrix
+ * \param[in] ncols     number of columns in the matrix
+ * \param[in] mat       matrix with values to record
+ * \param[in] nthreads  number of threads writing rows
+ */
+void
+cmat_fixed_txt(
+    char             fname[],
+    int              precision,
+    int              nrows,
+    int              ncols,
+    double complex** mat,
+    int              nthreads);
+
+/** \brief Record real matrix with fixed width values
+ *
+ * \see cmat_fixed_txt
+ */
+void
+rmat_fixed_txt(
+    char     fname[],
+    int      precision,
+    int      nrows,
+    int      ncols,
+    double** mat,
+    int      nthreads);
+
+/** \brief Record complex matrix in contiguous storage with fixed width
+ *
+ * \see cmat_fixed_txt
+ */
+void
+crowmajor_fixed_txt(
+    char            fname[],
+    int             precision,
+    int             nrows,
+    int             ncols,
+    int             ld,
+    double complex* mat,
+    int             nthreads);
+
+/** \brief Record real matrix in contiguous storage with fixed width
+ *
+ * \see cmat_fixed_txt
+ */
+void
+rrowmajor_fixed_txt(
+    char    fname[],
+    int     precision,
+    int     nrows,
+    int     ncols,
+    int     ld,
+    double* mat,
+    int     nthreads);
+
+/** \brief Open file recorded with fixed width values
+ *
+ * All routines on the open file use only `pread` and `pwrite`, thus may
+ * be called concurrently, as long as no two threads write the same row
+ *
+ * \param[out] fw       file description, released with `fixed_txt_close`
+ * \param[in]  fname    full path to the file
+ * \param[in]  writable nonzero to allow rows to be rewritten
+ */
+void
+fixed_txt_open(struct FixedWidthText* fw, char fname[], int writable);
+
+/** \brief Read row `i` of complex matrix in fixed width file */
+void
+cfixed_row_read(struct FixedWidthText* fw, int i, double complex* row);
+
+/** \brief Read row `i` of real matrix in fixed width file */
+void
+rfixed_row_read(struct FixedWidthText* fw, int i, double* row);
+
+/** \brief Read value in row `i` and column `j` of complex matrix */
+double complex
+cfixed_value_read(struct FixedWidthText* fw, int i, int j);
+
+/** \brief Read value in row `i` and column `j` of real matrix */
+double
+rfixed_value_read(struct FixedWidthText* fw, int i, int j);
+
+/** \brief Rewrite row `i` of complex matrix in place */
+void
+cfixed_row_write(struct FixedWidthText* fw, int i, double complex* row);
+
+/** \brief Rewrite row `i` of real matrix in place */
+void
+rfixed_row_write(struct FixedWidthText* fw, int i, double* row);
+
+/** \brief Close fixed width file */
+void
+fixed_txt_close(struct FixedWidthText* fw);
+
+#endif
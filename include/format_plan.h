@@ -0,0 +1,73 @@
+/** \file format_plan.h
+ *
+ * \author Alex Andriati
+ * \date October/2026
+ * \brief Formatters compiled once and reused by readers and recorders
+ *
+ * Every reader and recorder compiles its formatter when called, which is
+ * cheap for a whole matrix but not for many calls over small arrays, as
+ * when recording a stream of rows. A formatter can be compiled once in
+ * a `FormatPlan`, with both the scan and the print pieces, and given in
+ * place of the formatter string to any routine using `FORMAT_PLAN`
+ *
+ * \code
+ * struct FormatPlan plan;
+ * format_plan_compile(&plan, CPLX_SCIFMT_SPACE_BEFORE);
+ * for (int i = 0; i < nsteps; i++)
+ * {
+ *     carr_stream_record(f, FORMAT_PLAN(&plan), ...);
+ * }
+ * format_plan_free(&plan);
+ * \endcode
+ *
+ * The plan must be kept alive while used by any routine
+ */
+
+#ifndef FORMAT_PLAN_H
+#define FORMAT_PLAN_H
+
+#include "text_printer.h"
+#include "text_scanner.h"
+
+/** \brief Leading bytes telling a compiled plan from a formatter string */
+#define FORMAT_PLAN_MAGIC "\x01PLAN"
+
+/** \brief Pass compiled plan as formatter string argument of any routine */
+#define FORMAT_PLAN(plan) ((plan)->magic)
+
+/** \brief Formatter compiled for both scanning and printing
+ *
+ * `source` keeps a copy of the formatter string for the routines which
+ * fall back to `fscanf` or `fprintf` if the compilation is not supported
+ */
+struct FormatPlan
+{
+    char               magic[8];
+    char*              source;
+    int                scan_supported;
+    int                print_supported;
+    struct ScanFormat  scan;
+    struct PrintFormat print;
+};
+
+/** \brief Compile formatter string for scanning and printing
+ *
+ * \param[out] plan plan to set, released with `format_plan_free`
+ * \param[in]  fmt  scanf or printf-like formatter
+ */
+void
+format_plan_compile(struct FormatPlan* plan, char fmt[]);
+
+/** \brief Release resources of plan set by `format_plan_compile` */
+void
+format_plan_free(struct FormatPlan* plan);
+
+/** \brief Check if formatter argument is a compiled plan */
+int
+format_is_plan(const char fmt[]);
+
+/** \brief Formatter string of argument that may be a compiled plan */
+char*
+format_source(char fmt[]);
+
+#endif
@@ -0,0 +1,151 @@
+/** \file io_context.h
+ *
+ * \author Alex Andriati
+ * \date October/2026
+ * \brief Per-thread settings and recoverable errors for all routines
+ *
+ * The global variables `comment_char`, `printer_buffer_size` and
+ * `compression_level` are shared by the whole process, thus threads
+ * reading files with different conventions at the same time would race
+ * on them, and any error found by a routine ends the process. A context
+ * holds its own copy of these settings and the last error message. Once
+ * bound to a thread with `io_context_bind`, every routine called by that
+ * thread uses the settings of the context instead of the globals, with
+ * no locks involved, and each thread may bind a different context.
+ *
+ * Running routines through `io_context_run` also makes their errors
+ * recoverable: instead of exiting, the error message is stored in the
+ * context and the run returns a failure status. Before that, the files,
+ * memory maps, buffers and threads held by the interrupted routines are
+ * released, as each routine registers its release with `io_cleanup_push`
+ * while holding them. Errors of the helper threads of parallel routines
+ * are raised again by the calling thread, once all helpers are done
+ *
+ * \code
+ * struct IoContext ctx;
+ * io_context_init(&ctx);
+ * ctx.comment_char = '%';
+ * if (io_context_run(&ctx, ingest_file, fname) != 0)
+ * {
+ *     log_failure(fname, ctx.error);
+ * }
+ * \endcode
+ *
+ * \warning Errors raised by the background thread of an asynchronous
+ *          recorder, see `async_recorder.h`, have no caller to recover
+ *          and still end the process
+ */
+
+#ifndef IO_CONTEXT_H
+#define IO_CONTEXT_H
+
+#include <stddef.h>
+
+/** \brief Maximum length of error messages kept by contexts */
+#define IO_ERROR_SIZE 256
+
+/** \brief Settings used by the routines called from the bound thread */
+struct IoContext
+{
+    char   comment_char;
+    size_t printer_buffer_size;
+    int    compression_level;
+    char   error[IO_ERROR_SIZE];
+};
+
+/** \brief Release action of a routine, run if an error interrupts it
+ *
+ * Usually declared in the stack of the routine, and must be kept alive
+ * until removed with `io_cleanup_pop`
+ */
+struct IoCleanup
+{
+    void (*release)(void*);
+    void*             arg;
+    struct IoCleanup* prev;
+};
+
+/** \brief Initialize context with the current values of the globals */
+void
+io_context_init(struct IoContext* ctx);
+
+/** \brief Initialize context with the settings in use by calling thread
+ *
+ * Copy the bound context, if any, otherwise the globals. Used to give
+ * helper threads the same settings of the thread which started them
+ */
+void
+io_context_inherit(struct IoContext* ctx);
+
+/** \brief Bind context to the calling thread, or unbind it with NULL
+ *
+ * The context must outlive the binding. Threads without a bound context
+ * use the global variables
+ */
+void
+io_context_bind(struct IoContext* ctx);
+
+/** \brief Context bound to the calling thread or NULL if none */
+struct IoContext*
+io_context_current();
+
+/** \brief Run task with context bound, recovering from any error
+ *
+ * The previous binding of the calling thread is restored on return, thus
+ * runs may be nested
+ *
+ * \param[in] ctx  context bound during the task, with error message set
+ *                 if the task fails
+ * \param[in] task function calling any routines of the library
+ * \param[in] arg  argument given to `task`
+ *
+ * \return 0 if the task completed and -1 if an error was raised
+ */
+int
+io_context_run(struct IoContext* ctx, void (*task)(void*), void* arg);
+
+/** \brief Register `release(arg)` to run if an error interrupts the routine
+ *
+ * When an error is raised inside `io_context_run`, the releases pushed by
+ * the calling thread during the run and not popped yet are called, the
+ * most recent first, before the run returns. Every push must be undone
+ * by `io_cleanup_pop`, in reverse order, before the routine returns
+ *
+ * \param[out] c       registration, kept alive until popped
+ * \param[in]  release function releasing the resources
+ * \param[in]  arg     argument given to `release`
+ */
+void
+io_cleanup_push(struct IoCleanup* c, void (*release)(void*), void* arg);
+
+/** \brief Remove the last release pushed, calling it if `execute` is set
+ *
+ * Calling the release here lets routines share a single cleanup exit for
+ * success and failure
+ */
+void
+io_cleanup_pop(struct IoCleanup* c, int execute);
+
+/** \brief Comment character of the bound context or `comment_char` */
+char
+active_comment_char();
+
+/** \brief Printer buffer size of the bound context or the global one */
+size_t
+active_printer_buffer_size();
+
+/** \brief Compression level of the bound context or the global one */
+int
+active_compression_level();
+
+/** \brief Raise error with printf-like message
+ *
+ * Inside `io_context_run` the message is stored in the context, the
+ * releases pushed during the run are called and the run is interrupted,
+ * otherwise the message is printed and the process exits with failure
+ */
+void
+io_error(const char* fmt, ...)
+    __attribute__((noreturn, format(printf, 1, 2)));
+
+#endif
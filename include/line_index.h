@@ -0,0 +1,87 @@
+/** \file line_index.h
+ *
+ * \author Alex Andriati
+ * \date October/2026
+ * \brief Persistent index of line positions for fast seeking in text files
+ *
+ * Reading from a late `init_line` requires to go through every character
+ * before it. A sidecar file, named as the data file with `.lidx` suffix,
+ * can store the byte offsets of the lines (counted after comment lines,
+ * as in the readers) every `stride` lines. Once it is built the readers
+ * jump directly near the starting line.
+ *
+ * The index is keyed on size and modification time of the data file, as
+ * well as on `comment_char`, and it is silently ignored when any of them
+ * changed. Offsets are stored in native byte order
+ */
+
+#ifndef LINE_INDEX_H
+#define LINE_INDEX_H
+
+#include <stdint.h>
+
+/** \brief Default number of lines between consecutive index entries */
+#define DEFAULT_LINE_INDEX_STRIDE 16
+
+/** \brief Suffix added to data file name to set the index file name */
+#define LINE_INDEX_SUFFIX ".lidx"
+
+/** \brief Line offsets of a text file
+ *
+ * `offsets[k]` is the byte offset of line `k * stride + 1`, where line 1
+ * is the first line after comments. Thus, `offsets[0]` is where
+ * `jump_comment_lines` finishes
+ */
+struct LineIndex
+{
+    uint64_t  file_size;
+    int64_t   mtime_sec;
+    int64_t   mtime_nsec;
+    uint64_t  stride;
+    uint64_t  nlines;
+    uint64_t  nentries;
+    uint64_t* offsets;
+};
+
+/** \brief Scan text file and record its index in sidecar file
+ *
+ * \param[in] fname  full path to data file
+ * \param[in] stride number of lines between index entries. If not
+ *                   positive use `DEFAULT_LINE_INDEX_STRIDE`
+ */
+void
+line_index_build(char fname[], int stride);
+
+/** \brief Load index of a data file from its sidecar file
+ *
+ * \param[in]  fname full path to data file (not the index)
+ * \param[out] idx   index loaded, to be released with `line_index_free`
+ *
+ * \return 1 if an up to date index was loaded, 0 otherwise
+ */
+int
+line_index_load(char fname[], struct LineIndex* idx);
+
+/** \brief Check if a data file has an up to date sidecar index */
+int
+line_index_check(char fname[]);
+
+/** \brief Release memory of index set by `line_index_load` */
+void
+line_index_free(struct LineIndex* idx);
+
+/** \brief Find position near a line using the sidecar index if available
+ *
+ * Read only the index entry required, without loading the whole index
+ *
+ * \param[in]  fname     full path to data file
+ * \param[in]  line      line number counted as `init_line` in readers
+ * \param[out] offset    byte offset of an indexed line before `line`
+ * \param[out] remaining number of lines to skip after `offset`
+ *
+ * \return 1 if an up to date index was used, 0 otherwise
+ */
+int
+line_index_seek(char fname[], int line, uint64_t* offset, int* remaining);
+
+#endif
@@ -0,0 +1,50 @@
+/** \file matrix_alloc.h
+ *
+ * \author Alex Andriati
+ * \date October/2026
+ * \brief Contiguous matrix allocation with row pointer view
+ *
+ * A matrix allocated here is a single memory block, aligned to
+ * `MATRIX_ALIGNMENT` bytes, holding the values in row-major format, with
+ * an array of row pointers over it. Thus the same matrix can be used in
+ * the `double**` routines and, through `mat[0]`, in the contiguous
+ * **rowmajor** routines with leading dimension equal to `ncols`
+ */
+
+#ifndef MATRIX_ALLOC_H
+#define MATRIX_ALLOC_H
+
+#include <complex.h>
+
+/** \brief Alignment in bytes of the contiguous block of values */
+#define MATRIX_ALIGNMENT 64
+
+/** \brief Allocate real matrix in contiguous memory with row view
+ *
+ * The row pointers and the values share a single allocation, released
+ * with `rmat_free`
+ *
+ * \param[in] nrows number of rows
+ * \param[in] ncols number of columns
+ *
+ * \return row pointers, with `mat[0]` the aligned contiguous block
+ */
+double**
+rmat_alloc(int nrows, int ncols);
+
+/** \brief Allocate complex matrix in contiguous memory with row view
+ *
+ * \see rmat_alloc
+ */
+double complex**
+cmat_alloc(int nrows, int ncols);
+
+/** \brief Release real matrix set by `rmat_alloc` */
+void
+rmat_free(double** mat);
+
+/** \brief Release complex matrix set by `cmat_alloc` */
+void
+cmat_free(double complex** mat);
+
+#endif
@@ -0,0 +1,248 @@
+/** \file npy_io.h
+ *
+ * \author Alex Andriati
+ * \date October/2026
+ * \brief Binary arrays in the numpy `.npy` format
+ *
+ * Text files cost about 24 bytes per double, plus the formatting and
+ * parsing time, and lose the last bits unless 17 digits are used. The
+ * `.npy` files are written and read as blocks of raw doubles, with exact
+ * bits, and are loaded by numpy with `numpy.load`
+ *
+ * Writers always use the version 1.0 header in C order with `<f8` for
+ * real and `<c16` for complex values. Readers accept the versions 1.0,
+ * 2.0 and 3.0 of the header, both byte orders, which are swapped if they
+ * differ from the machine one, and both C and Fortran orders, delivering
+ * the values always in row-major format
+ *
+ * Growing series, as one row per time step, are written with a
+ * `NpyAppender`, which reserves space for the header, appends rows as
+ * raw binary and rewrites the shape in place when flushed. Each append
+ * costs only its own row, and after a flush the file is a valid `.npy`
+ * with all rows appended so far, even if the program later crashes
+ */
+
+#ifndef NPY_IO_H
+#define NPY_IO_H
+
+#include <complex.h>
+#include <stddef.h>
+#include <stdio.h>
+
+/** \brief Maximum number of dimensions of arrays in `.npy` files */
+#define NPY_MAX_DIMS 8
+
+/** \brief Description of the array stored in a `.npy` file */
+struct NpyHeader
+{
+    int    ncomp;
+    int    swap_bytes;
+    int    fortran_order;
+    int    ndim;
+    size_t shape[NPY_MAX_DIMS];
+    size_t nvalues;
+    long   data_offset;
+};
+
+/** \brief Read header of `.npy` file
+ *
+ * Only arrays of 8-byte floats (`f8`) and 16-byte complex (`c16`) are
+ * supported, with `ncomp` set to 1 and 2 respectively
+ *
+ * \param[in]  fname full path to the file
+ * \param[out] h     array description
+ */
+void
+npy_header(char fname[], struct NpyHeader* h);
+
+/** \brief Record array of complex values in `.npy` file
+ *
+ * \param[in] fname    full path to the file
+ * \param[in] arr_size number of values
+ * \param[in] arr      values to record
+ */
+void
+carr_npy(char fname[], int arr_size, double complex* arr);
+
+/** \brief Record array of real values in `.npy` file
+ *
+ * \see carr_npy
+ */
+void
+rarr_npy(char fname[], int arr_size, double* arr);
+
+/** \brief Record complex matrix in `.npy` file with shape (nrows, ncols)
+ *
+ * \param[in] fname full path to the file
+ * \param[in] nrows number of rows in the matrix
+ * \param[in] ncols number of columns in the matrix
+ * \param[in] mat   matrix with values to record
+ */
+void
+cmat_npy(char fname[], int nrows, int ncols, double complex** mat);
+
+/** \brief Record real matrix in `.npy` file with shape (nrows, ncols)
+ *
+ * \see cmat_npy
+ */
+void
+rmat_npy(char fname[], int nrows, int ncols, double** mat);
+
+/** \brief Record complex matrix in contiguous storage in `.npy` file
+ *
+ * \see cmat_npy
+ */
+void
+crowmajor_npy(char fname[], int nrows, int ncols, int ld, double complex* mat);
+
+/** \brief Record real matrix in contiguous storage in `.npy` file
+ *
+ * \see cmat_npy
+ */
+void
+rrowmajor_npy(char fname[], int nrows, int ncols, int ld, double* mat);
+
+/** \brief Read complex array from `.npy` file with any shape
+ *
+ * The file must have exactly `arr_size` complex values
+ *
+ * \param[in]  fname    full path to the file
+ * \param[in]  arr_size number of values
+ * \param[out] arr      values read, in row-major format
+ */
+void
+carr_npy_read(char fname[], int arr_size, double complex* arr);
+
+/** \brief Read real array from `.npy` file with any shape
+ *
+ * \see carr_npy_read
+ */
+void
+rarr_npy_read(char fname[], int arr_size, double* arr);
+
+/** \brief Read complex matrix from `.npy` file with shape (nrows, ncols)
+ *
+ * \param[in]  fname full path to the file
+ * \param[in]  nrows number of rows in the matrix
+ * \param[in]  ncols number of columns in the matrix
+ * \param[out] mat   matrix to set with values read
+ */
+void
+cmat_npy_read(char fname[], int nrows, int ncols, double complex** mat);
+
+/** \brief Read real matrix from `.npy` file with shape (nrows, ncols)
+ *
+ * \see cmat_npy_read
+ */
+void
+rmat_npy_read(char fname[], int nrows, int ncols, double** mat);
+
+/** \brief Read complex matrix from `.npy` file to contiguous storage
+ *
+ * \see cmat_npy_read
+ */
+void
+crowmajor_npy_read(
+    char fname[], int nrows, int ncols, int ld, double complex* mat);
+
+/** \brief Read real matrix from `.npy` file to contiguous storage
+ *
+ * \see cmat_npy_read
+ */
+void
+rrowmajor_npy_read(char fname[], int nrows, int ncols, int ld, double* mat);
+
+/** \brief Load complex matrix of `.npy` file discovering its shape
+ *
+ * One-dimensional arrays are loaded as a single column
+ *
+ * \param[in]  fname full path to the file
+ * \param[out] nrows number of rows found
+ * \param[out] ncols number of columns found
+ *
+ * \return matrix in row-major format to be released with `free`
+ */
+double complex*
+cmat_npy_load(char fname[], int* nrows, int* ncols);
+
+/** \brief Load real matrix of `.npy` file discovering its shape
+ *
+ * \see cmat_npy_load
+ */
+double*
+rmat_npy_load(char fname[], int* nrows, int* ncols);
+
+/** \brief Open `.npy` file whose rows are appended one by one
+ *
+ * The shape in the header is (nrows, ncols), where `nrows` counts the
+ * rows appended up to the last flush. Compressed files are not supported
+ */
+struct NpyAppender
+{
+    FILE*   f;
+    char*   fname;
+    int     ncomp;
+    int     ncols;
+    int     header_len;
+    size_t  nrows;
+    size_t  flushed_rows;
+    double* swapped;
+};
+
+/** \brief Create `.npy` file to append rows of `ncols` complex values
+ *
+ * Any existing file is truncated
+ *
+ * \param[out] a     appender released with `npy_append_close`
+ * \param[in]  fname full path to the file
+ * \param[in]  ncols number of values in each row
+ */
+void
+cnpy_append_open(struct NpyAppender* a, char fname[], int ncols);
+
+/** \brief Create `.npy` file to append rows of `ncols` real values
+ *
+ * \see cnpy_append_open
+ */
+void
+rnpy_append_open(struct NpyAppender* a, char fname[], int ncols);
+
+/** \brief Append one row of complex values */
+void
+carr_npy_append(struct NpyAppender* a, double complex* row);
+
+/** \brief Append one row of real values */
+void
+rarr_npy_append(struct NpyAppender* a, double* row);
+
+/** \brief Append rows of complex matrix in contiguous storage
+ *
+ * \param[in] a     appender opened with `cnpy_append_open`
+ * \param[in] nrows number of rows to append
+ * \param[in] ld    distance between rows in `mat`, at least `ncols`
+ * \param[in] mat   rows to append
+ */
+void
+crowmajor_npy_append(
+    struct NpyAppender* a, int nrows, int ld, double complex* mat);
+
+/** \brief Append rows of real matrix in contiguous storage
+ *
+ * \see crowmajor_npy_append
+ */
+void
+rrowmajor_npy_append(struct NpyAppender* a, int nrows, int ld, double* mat);
+
+/** \brief Make all rows appended so far durable and visible in header
+ *
+ * Data are synced to disk before the shape is rewritten, thus the header
+ * never counts rows which were not stored
+ */
+void
+npy_append_flush(struct NpyAppender* a);
+
+/** \brief Flush rows and close the file */
+void
+npy_append_close(struct NpyAppender* a);
+
+#endif
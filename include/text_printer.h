@@ -0,0 +1,207 @@
+/** \file text_printer.h
+ *
+ * \author Alex Andriati
+ * \date October/2026
+ * \brief Fast formatting of numbers to text files
+ *
+ * The recorders used to call `fprintf` once per element, which parses
+ * the format string and runs the generic multi-precision conversion of
+ * the C library for every single value. Here the printf formatter is
+ * compiled only once and numbers are converted with 128-bit integer
+ * arithmetic in a large buffer, written to the file in blocks.
+ *
+ * Conversions `%e` and `%E` with optional `+` or space flags, precision
+ * and `l` length modifier, as in the `REAL_SCIFMT_*` and `CPLX_SCIFMT_*`
+ * macros, give exactly the same text of `printf`. In addition `%r` and
+ * `%R` give the shortest text in exponential notation that is read back
+ * as the same double, as in the `REAL_SHORTFMT_*` and `CPLX_SHORTFMT_*`
+ * macros. Any other formatter is handled transparently using `fprintf`.
+ * Wherever a formatter is expected, a plan from `format_plan.h` is also
+ * accepted
+ */
+
+#ifndef TEXT_PRINTER_H
+#define TEXT_PRINTER_H
+
+#include "io_context.h"
+#include <stdio.h>
+
+/** \brief Default of `printer_buffer_size` */
+#define DEFAULT_PRINTER_BUFFER_SIZE (1 << 22)
+
+/** \brief Size of the buffer kept inside every printer */
+#define PRINTER_SMALL_SIZE 4096
+
+/** \brief Maximum number of pieces in a compiled print formatter */
+#define PRINT_FORMAT_MAX_PIECES 16
+
+/** \brief Maximum length of ordinary text in a compiled print formatter */
+#define PRINT_FORMAT_MAX_TEXT 64
+
+/** \brief Maximum precision of conversions in a compiled print formatter */
+#define PRINT_FORMAT_MAX_PRECISION 64
+
+/** \brief Precision value requesting the shortest round-trip text */
+#define SHORTEST_PRECISION -1
+
+/** \brief Minimum space required by `format_double` output */
+#define FORMAT_DOUBLE_MIN_SPACE (PRINT_FORMAT_MAX_PRECISION + 32)
+
+/** \brief Kind of each piece of a compiled print formatter */
+enum PrintPieceKind
+{
+    PRINT_LITERAL,
+    PRINT_DOUBLE
+};
+
+/** \brief Print formatter compiled in a sequence of pieces
+ *
+ * `PRINT_LITERAL` pieces copy `length` characters of `text` starting at
+ * `start`. `PRINT_DOUBLE` pieces convert one value with `precision`
+ * digits after the point, using `sign` ('\0', '+' or ' ') for positive
+ * numbers and `exp_char` ('e' or 'E') to introduce the exponent
+ */
+struct PrintFormat
+{
+    int  npieces;
+    int  nvalues;
+    char kinds[PRINT_FORMAT_MAX_PIECES];
+    char signs[PRINT_FORMAT_MAX_PIECES];
+    char exp_chars[PRINT_FORMAT_MAX_PIECES];
+    int  precisions[PRINT_FORMAT_MAX_PIECES];
+    int  starts[PRINT_FORMAT_MAX_PIECES];
+    int  lengths[PRINT_FORMAT_MAX_PIECES];
+    char text[PRINT_FORMAT_MAX_TEXT];
+};
+
+/** \brief Maximum size in bytes of the text buffer of each printer
+ *
+ * Printers start with the `PRINTER_SMALL_SIZE` buffer of the structure
+ * which is moved to the heap and doubled when full, up to this size,
+ * thus short records do not pay for any allocation. As for
+ * `comment_char` assign this global variable in the main app program
+ */
+extern size_t printer_buffer_size;
+
+/** \brief Buffered writer of formatted numbers to an open file
+ *
+ * If the formatter can be compiled and has at most two conversions the
+ * text is produced in a buffer, otherwise every writing is delegated to
+ * `fprintf`. Large blocks, or any block of files opened by the library
+ * (`owned`), are written with `writev` in the file descriptor, bypassing
+ * the `FILE` lock and buffer. Small blocks in streams of the caller are
+ * appended to the `FILE` buffer with `fwrite`. Printers opened with
+ * `printer_open_memory` have null `f` and keep all the text. The printer
+ * must not be copied once open, as `buf` may point to `small`. The
+ * routine owning the printer may use `cleanup` to release it on errors
+ */
+struct TextPrinter
+{
+    FILE*              f;
+    char*              fmt;
+    int                fast;
+    struct PrintFormat plan;
+    int                owned;
+    char*              buf;
+    size_t             len;
+    size_t             size;
+    struct IoCleanup   cleanup;
+    char               small[PRINTER_SMALL_SIZE];
+};
+
+/** \brief Convert double to text in exponential notation
+ *
+ * Same as `printf` with `%.<precision>E` conversion, or the shortest
+ * text that is read back to `x` if `precision` is `SHORTEST_PRECISION`.
+ * Independent of the current locale
+ *
+ * \param[in]  x         number to convert
+ * \param[in]  precision digits after the point, at most
+ *                       `PRINT_FORMAT_MAX_PRECISION`, or
+ *                       `SHORTEST_PRECISION`
+ * \param[in]  sign      character for positive numbers: '\0', '+' or ' '
+ * \param[in]  exp_char  'e' or 'E'
+ * \param[out] out       text with room for `FORMAT_DOUBLE_MIN_SPACE`
+ *                       characters, not null terminated
+ *
+ * \return number of characters written
+ */
+int
+format_double(double x, int precision, char sign, char exp_char, char* out);
+
+/** \brief Compile a printf formatter with only exponential conversions
+ *
+ * \param[in]  fmt  printf-like formatter
+ * \param[out] plan compiled formatter
+ *
+ * \return 1 if the formatter is supported and 0 otherwise
+ */
+int
+compile_print_format(char fmt[], struct PrintFormat* plan);
+
+/** \brief Prepare printer to write at the current position of open file */
+void
+printer_open(struct TextPrinter* pr, FILE* f, char fmt[]);
+
+/** \brief Prepare printer on a file which is closed right after it
+ *
+ * Same as `printer_open`, but since nothing else is written in the file
+ * even small blocks bypass the `FILE` buffer
+ */
+void
+printer_open_owned(struct TextPrinter* pr, FILE* f, char fmt[]);
+
+/** \brief Prepare printer to write text only in its memory buffer
+ *
+ * The buffer grows as needed and is never flushed. The text is given by
+ * the first `len` characters of `buf`, valid until `printer_close`
+ *
+ * \return 1 if the formatter is supported by the fast engine, otherwise
+ *         0 and the printer must not be used
+ */
+int
+printer_open_memory(struct TextPrinter* pr, char fmt[]);
+
+/** \brief Change formatter of open printer keeping the text buffered
+ *
+ * Allow a single printer to serve records with different formatters
+ */
+void
+printer_set_format(struct TextPrinter* pr, char fmt[]);
+
+/** \brief Write the buffered text to the file
+ *
+ * Text written by `fprintf`, for formatters not supported by the fast
+ * engine, remains in the `FILE` buffer. Memory printers are unchanged
+ */
+void
+printer_flush(struct TextPrinter* pr);
+
+/** \brief Write the values of one formatter application
+ *
+ * \param[in] pr     printer initialized with `printer_open`
+ * \param[in] values array with the values required by the formatter
+ */
+void
+printer_write(struct TextPrinter* pr, double* values);
+
+/** \brief Write ordinary text, without any format interpretation */
+void
+printer_text(struct TextPrinter* pr, char text[]);
+
+/** \brief Flush text to the file and release printer resources
+ *
+ * The file is not closed, and can be used as if all writings had been
+ * done with `fprintf`
+ */
+void
+printer_close(struct TextPrinter* pr);
+
+/** \brief Release printer resources without writing the buffered text
+ *
+ * Safe for printers whose `buf` is null, thus may be used on errors
+ */
+void
+printer_discard(struct TextPrinter* pr);
+
+#endif
@@ -0,0 +1,156 @@
+/** \file text_scanner.h
+ *
+ * \author Alex Andriati
+ * \date October/2026
+ * \brief Fast locale-independent scanning of numbers from text files
+ *
+ * The readers used to call `fscanf` once per element, which interprets
+ * the format string, locks the stream and runs a locale-aware `strtod`
+ * for every single value. Here the scanf formatter is compiled only once
+ * and numbers are converted directly from a large raw buffer.
+ *
+ * Only formatters composed of white spaces, ordinary characters and the
+ * double conversions `%lf`, `%le`, `%lg` (and capital variants) can be
+ * compiled, which covers `"%lf"` and the numpy `" (%lf%lfj)"` patterns.
+ * Any other formatter is handled transparently using `fscanf`. Wherever
+ * a formatter is expected, a plan from `format_plan.h` is also accepted
+ */
+
+#ifndef TEXT_SCANNER_H
+#define TEXT_SCANNER_H
+
+#include <stdio.h>
+
+/** \brief Maximum number of pieces in a compiled scan formatter */
+#define SCAN_FORMAT_MAX_PIECES 32
+
+/** \brief Kind of each piece of a compiled scan formatter */
+enum ScanPieceKind
+{
+    SCAN_SPACE,
+    SCAN_LITERAL,
+    SCAN_DOUBLE
+};
+
+/** \brief Scan formatter compiled in a sequence of pieces
+ *
+ * For `SCAN_LITERAL` pieces, the character that must be matched is
+ * given in the `literals` field with the same index of `kinds`
+ */
+struct ScanFormat
+{
+    int  npieces;
+    int  nvalues;
+    char kinds[SCAN_FORMAT_MAX_PIECES];
+    char literals[SCAN_FORMAT_MAX_PIECES];
+};
+
+/** \brief Buffered reader of formatted numbers from an open file
+ *
+ * If the formatter can be compiled, has at most two conversions and the
+ * file is seekable through a file descriptor (or owned, see
+ * `scanner_open_owned`) the fast path is used, otherwise every reading
+ * is delegated to `fscanf`. Text already in
+ * memory, as from a memory mapped file, is scanned in place without any
+ * buffering, in which case `f` is NULL
+ */
+struct TextScanner
+{
+    FILE*             f;
+    char*             fmt;
+    int               fast;
+    struct ScanFormat plan;
+    char*             buf;
+    size_t            chunk;
+    char*             pos;
+    char*             end;
+    int               eof;
+};
+
+/** \brief Convert text to double independently of the current locale
+ *
+ * Accept the same syntax of `strtod` in "C" locale, without skipping
+ * leading white spaces. Correctly rounded, thus any number recorded
+ * with 17 significant digits round-trip exactly
+ *
+ * \param[in]  str start of the text
+ * \param[in]  end end of the text (one past the last valid character)
+ * \param[out] x   converted number
+ *
+ * \return number of characters consumed, zero if no conversion was done
+ */
+int
+parse_double(const char* str, const char* end, double* x);
+
+/** \brief Compile a scanf formatter with only double conversions
+ *
+ * \param[in]  fmt  scanf-like formatter
+ * \param[out] plan compiled formatter
+ *
+ * \return 1 if the formatter is supported and 0 otherwise
+ */
+int
+compile_scan_format(char fmt[], struct ScanFormat* plan);
+
+/** \brief Prepare scanner to read from the current position of open file */
+void
+scanner_open(struct TextScanner* sc, FILE* f, char fmt[]);
+
+/** \brief Prepare scanner on a file which is closed right after it
+ *
+ * Same as `scanner_open`, but the fast path is also used for streams
+ * which cannot seek backward, as pipes and compressed files, since the
+ * text read ahead never needs to be given back. Set `sc->pos` to
+ * `sc->end` before `scanner_close`
+ */
+void
+scanner_open_owned(struct TextScanner* sc, FILE* f, char fmt[]);
+
+/** \brief Prepare scanner to read from text in memory
+ *
+ * \param[in] sc  scanner to set
+ * \param[in] beg start of the text
+ * \param[in] end end of the text (one past the last valid character)
+ * \param[in] fmt scanf-like formatter
+ *
+ * \return 1 if the formatter is supported and 0 otherwise, in which case
+ *         the text must be read using `fscanf` in a file
+ */
+int
+scanner_open_memory(
+    struct TextScanner* sc, const char* beg, const char* end, char fmt[]);
+
+/** \brief Read the values of one formatter application
+ *
+ * \param[in]  sc     scanner initialized with `scanner_open`
+ * \param[out] values array with room for two values
+ *
+ * \return number of values assigned as would be returned by `fscanf`
+ */
+int
+scanner_read(struct TextScanner* sc, double* values);
+
+/** \brief Skip the values of one formatter application
+ *
+ * Equivalent to `scanner_read` but numbers are only tokenized, without
+ * any conversion to double
+ *
+ * \return number of values skipped
+ */
+int
+scanner_skip(struct TextScanner* sc);
+
+/** \brief Skip white spaces and check if there is nothing else to read */
+int
+scanner_at_end(struct TextScanner* sc);
+
+/** \brief Release scanner resources leaving file cursor after last reading
+ *
+ * The file is not closed, and can be used as if all readings had been
+ * done with `fscanf`. For text in memory `sc->pos` still tells where the
+ * scanning stopped
+ */
+void
+scanner_close(struct TextScanner* sc);
+
+#endif
@@ -0,0 +1,104 @@
+"""Compare the cpydataio extension module with numpy loadtxt and savetxt
+
+Build with `-DDATAIO_WITH_PYTHON=ON` and run from the build directory,
+or with it in PYTHONPATH, optionally giving the number of values
+
+    python3 ../python/benchmark.py 1000000
+"""
+
+import os
+import sys
+import time
+
+import numpy as np
+
+import cpydataio
+
+NCOLS = 10
+
+
+def elapsed(func, *args, **kwargs):
+    start = time.perf_counter()
+    result = func(*args, **kwargs)
+    return time.perf_counter() - start, result
+
+
+def report(title, reference, reference_time, lib_time, identical):
+    print(
+        "{:<32s} {:>8s} {:8.3f}s  lib {:8.3f}s  speedup {:6.2f}x  {}".format(
+            title,
+            reference,
+            reference_time,
+            lib_time,
+            reference_time / lib_time,
+            "identical" if identical else "MISMATCH",
+        )
+    )
+
+
+def bench_real(nrows, nthreads):
+    rng = np.random.default_rng(1)
+    mat = rng.standard_normal((nrows, NCOLS))
+    ref_time, _ = elapsed(np.savetxt, "bench_np.txt", mat, fmt="%.15E")
+    lib_time, _ = elapsed(cpydataio.rmat_txt, "bench_lib.txt", mat)
+    ref = np.loadtxt("bench_np.txt")
+    report("rmat_txt", "savetxt", ref_time, lib_time, np.array_equal(
+        ref, np.loadtxt("bench_lib.txt")))
+
+    lib_time, _ = elapsed(
+        cpydataio.rmat_txt, "bench_lib.txt", mat, nthreads=nthreads)
+    report("rmat_txt {} threads".format(nthreads), "savetxt", ref_time,
+           lib_time, np.array_equal(ref, np.loadtxt("bench_lib.txt")))
+
+    ref_time, ref = elapsed(np.loadtxt, "bench_np.txt")
+    lib_time, lib = elapsed(cpydataio.rmat_load, "bench_np.txt")
+    report("rmat_load", "loadtxt", ref_time, lib_time,
+           np.array_equal(ref, lib))
+
+    lib_time, lib = elapsed(cpydataio.rmat_read, "bench_np.txt", nrows,
+                            NCOLS, nthreads=nthreads)
+    report("rmat_read {} threads".format(nthreads), "loadtxt", ref_time,
+           lib_time, np.array_equal(ref, lib))
+
+
+def load_complex(fname):
+    return np.loadtxt(fname, dtype=complex,
+                      converters=lambda s: complex(s.strip(" ()")))
+
+
+def bench_complex(nrows, nthreads):
+    rng = np.random.default_rng(2)
+    mat = rng.standard_normal((nrows, NCOLS))
+    mat = mat + 1j * rng.standard_normal((nrows, NCOLS))
+    ref_time, _ = elapsed(np.savetxt, "bench_np.txt", mat,
+                          fmt=[" (%.15E%+.15Ej)"] * NCOLS, delimiter="")
+    lib_time, _ = elapsed(cpydataio.cmat_txt, "bench_lib.txt", mat)
+    ref = load_complex("bench_np.txt")
+    report("cmat_txt", "savetxt", ref_time, lib_time, np.array_equal(
+        ref, load_complex("bench_lib.txt")))
+
+    ref_time, ref = elapsed(load_complex, "bench_np.txt")
+    lib_time, lib = elapsed(cpydataio.cmat_load, "bench_np.txt")
+    report("cmat_load", "loadtxt", ref_time, lib_time,
+           np.array_equal(ref, lib))
+
+    lib_time, lib = elapsed(cpydataio.cmat_read, "bench_np.txt", nrows,
+                            NCOLS, nthreads=nthreads)
+    report("cmat_read {} threads".format(nthreads), "loadtxt", ref_time,
+           lib_time, np.array_equal(ref, lib))
+
+
+def main():
+    nvalues = int(sys.argv[1]) if len(sys.argv) > 1 else 1000000
+    nthreads = os.cpu_count() or 1
+    nrows = max(nvalues // NCOLS, 1)
+    print("\nBenchmark with {} values\n".format(nrows * NCOLS))
+    bench_real(nrows, nthreads)
+    bench_complex(nrows, nthreads)
+    os.remove("bench_np.txt")
+    os.remove("bench_lib.txt")
+    print("")
+
+
+if __name__ == "__main__":
+    main()
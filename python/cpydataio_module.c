@@ -0,0 +1,537 @@
+/** \file cpydataio_module.c
+ *
+ * \author Alex Andriati
+ * \date October/2026
+ * \brief CPython extension module wrapping the matrix readers and writers
+ *
+ * Readers allocate the matrix once and parse the file directly into it.
+ * The memory is owned by a `cpydataio.Matrix` object exporting it with
+ * the buffer protocol, as a 2D array of format "d" or "Zd", which is
+ * returned wrapped by `numpy.asarray` with no copy if numpy is installed.
+ * Writers take any object with the buffer protocol, as numpy arrays, and
+ * record its memory with no copy, with any strides, as slices do.
+ *
+ * Files are read and written with the GIL released. The routines run in
+ * `io_context_run`, thus errors raise `OSError` instead of ending the
+ * interpreter. The parallel routines, used when `nthreads` is not 1, join
+ * their helper threads and release files and memory before raising
+ *
+ * \code
+ * import cpydataio
+ * a = cpydataio.rmat_load("data.txt")
+ * cpydataio.cmat_txt("out.txt", a * 1j, nthreads=4)
+ * \endcode
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include "data_reader.h"
+#include "data_recorder.h"
+#include "io_context.h"
+#include <complex.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define REAL_READ_FMT "%lf"
+#define CPLX_READ_FMT " (%lf%lfj)"
+
+/** Matrix in row-major storage exported with the buffer protocol */
+typedef struct
+{
+    PyObject_HEAD
+    double*    data;
+    int        ncomp;
+    Py_ssize_t shape[2];
+    Py_ssize_t strides[2];
+} Matrix;
+
+/** Arguments and results of one call of the library */
+struct MatrixTask
+{
+    char*              fname;
+    char*              fmt;
+    int                init_line;
+    int                ncomp;
+    int                nrows;
+    int                ncols;
+    double*            data;
+    int                nthreads;
+    struct MatrixSlice slice;
+};
+
+static PyObject* numpy_asarray = NULL;
+
+static void
+matrix_dealloc(Matrix* self)
+{
+    free(self->data);
+    Py_TYPE(self)->tp_free((PyObject*) self);
+}
+
+static int
+matrix_getbuffer(Matrix* self, Py_buffer* view, int flags)
+{
+    view->obj = Py_NewRef((PyObject*) self);
+    view->buf = self->data;
+    view->itemsize = self->ncomp * sizeof(double);
+    view->len = self->shape[0] * self->shape[1] * view->itemsize;
+    view->readonly = 0;
+    view->ndim = 2;
+    view->format = NULL;
+    if ((flags & PyBUF_FORMAT) == PyBUF_FORMAT)
+    {
+        view->format = self->ncomp == 2 ? "Zd" : "d";
+    }
+    view->shape = (flags & PyBUF_ND) == PyBUF_ND ? self->shape : NULL;
+    view->strides =
+        (flags & PyBUF_STRIDES) == PyBUF_STRIDES ? self->strides : NULL;
+    view->suboffsets = NULL;
+    view->internal = NULL;
+    return 0;
+}
+
+static PyBufferProcs matrix_as_buffer = {
+    .bf_getbuffer = (getbufferproc) matrix_getbuffer,
+};
+
+static PyObject*
+matrix_shape(Matrix* self, void* closure)
+{
+    (void) closure;
+    return Py_BuildValue("(nn)", self->shape[0], self->shape[1]);
+}
+
+static PyGetSetDef matrix_getset[] = {
+    {"shape", (getter) matrix_shape, NULL, "number of rows and columns", NULL},
+    {NULL, NULL, NULL, NULL, NULL},
+};
+
+static PyTypeObject MatrixType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "cpydataio.Matrix",
+    .tp_doc = "Matrix owned by the module, see the buffer protocol",
+    .tp_basicsize = sizeof(Matrix),
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_dealloc = (destructor) matrix_dealloc,
+    .tp_as_buffer = &matrix_as_buffer,
+    .tp_getset = matrix_getset,
+};
+
+/** Wrap memory from `malloc` in a new matrix, releasing it on failure */
+static Matrix*
+wrap_matrix(double* data, int ncomp, int nrows, int ncols)
+{
+    Matrix* m;
+
+    if (data == NULL)
+    {
+        data = (double*) malloc(ncomp * sizeof(double));
+        if (data == NULL) return (Matrix*) PyErr_NoMemory();
+        nrows = 0;
+        ncols = 0;
+    }
+    m = PyObject_New(Matrix, &MatrixType);
+    if (m == NULL)
+    {
+        free(data);
+        return NULL;
+    }
+    m->data = data;
+    m->ncomp = ncomp;
+    m->shape[0] = nrows;
+    m->shape[1] = ncols;
+    m->strides[0] = ncols * ncomp * sizeof(double);
+    m->strides[1] = ncomp * sizeof(double);
+    return m;
+}
+
+/** New matrix with memory for `nrows` by `ncols` values */
+static Matrix*
+new_matrix(int ncomp, int nrows, int ncols)
+{
+    size_t  n;
+    double* data;
+
+    if (nrows < 0 || ncols < 0)
+    {
+        PyErr_SetString(PyExc_ValueError, "negative matrix dimension");
+        return NULL;
+    }
+    n = (size_t) nrows * ncols * ncomp;
+    data = (double*) malloc((n > 0 ? n : 1) * sizeof(double));
+    if (data == NULL) return (Matrix*) PyErr_NoMemory();
+    return wrap_matrix(data, ncomp, nrows, ncols);
+}
+
+/** Hand matrix to numpy with no copy, if available */
+static PyObject*
+as_array(Matrix* m)
+{
+    PyObject* arr;
+
+    if (m == NULL || numpy_asarray == Py_None) return (PyObject*) m;
+    if (numpy_asarray == NULL)
+    {
+        PyObject* numpy = PyImport_ImportModule("numpy");
+        if (numpy == NULL)
+        {
+            PyErr_Clear();
+            numpy_asarray = Py_NewRef(Py_None);
+            return (PyObject*) m;
+        }
+        numpy_asarray = PyObject_GetAttrString(numpy, "asarray");
+        Py_DECREF(numpy);
+        if (numpy_asarray == NULL)
+        {
+            Py_DECREF(m);
+            return NULL;
+        }
+    }
+    arr = PyObject_CallOneArg(numpy_asarray, (PyObject*) m);
+    Py_DECREF(m);
+    return arr;
+}
+
+static void
+read_task(void* arg)
+{
+    struct MatrixTask* t;
+
+    t = (struct MatrixTask*) arg;
+    if (t->ncomp == 2 && t->nthreads != 1)
+    {
+        crowmajor_txt_read_parallel(
+            t->fname,
+            t->fmt,
+            t->init_line,
+            t->nrows,
+            t->ncols,
+            t->ncols,
+            (double complex*) t->data,
+            t->nthreads);
+    } else if (t->ncomp == 2)
+    {
+        crowmajor_txt_read(
+            t->fname,
+            t->fmt,
+            t->init_line,
+            t->nrows,
+            t->ncols,
+            t->ncols,
+            (double complex*) t->data);
+    } else if (t->nthreads != 1)
+    {
+        rrowmajor_txt_read_parallel(
+            t->fname,
+            t->fmt,
+            t->init_line,
+            t->nrows,
+            t->ncols,
+            t->ncols,
+            t->data,
+            t->nthreads);
+    } else
+    {
+        rrowmajor_txt_read(
+            t->fname,
+            t->fmt,
+            t->init_line,
+            t->nrows,
+            t->ncols,
+            t->ncols,
+            t->data);
+    }
+}
+
+static void
+load_task(void* arg)
+{
+    struct MatrixTask* t;
+
+    t = (struct MatrixTask*) arg;
+    if (t->ncomp == 2)
+    {
+        t->data = (double*) cmat_load(
+            t->fname, t->fmt, t->init_line, &t->nrows, &t->ncols);
+    } else
+    {
+        t->data =
+            rmat_load(t->fname, t->fmt, t->init_line, &t->nrows, &t->ncols);
+    }
+}
+
+static void
+record_task(void* arg)
+{
+    struct MatrixTask* t;
+
+    t = (struct MatrixTask*) arg;
+    if (t->ncomp == 2 && t->nthreads != 1)
+    {
+        cslice_txt_parallel(
+            t->fname,
+            t->fmt,
+            &t->slice,
+            (double complex*) t->data,
+            t->nthreads);
+    } else if (t->ncomp == 2)
+    {
+        cslice_txt(t->fname, t->fmt, &t->slice, (double complex*) t->data);
+    } else if (t->nthreads != 1)
+    {
+        rslice_txt_parallel(
+            t->fname, t->fmt, &t->slice, t->data, t->nthreads);
+    } else
+    {
+        rslice_txt(t->fname, t->fmt, &t->slice, t->data);
+    }
+}
+
+/** Run task with the GIL released, setting `OSError` on failure */
+static int
+run_released(void (*task)(void*), struct MatrixTask* t)
+{
+    int              status;
+    struct IoContext ctx;
+
+    Py_BEGIN_ALLOW_THREADS
+    io_context_init(&ctx);
+    status = io_context_run(&ctx, task, t);
+    Py_END_ALLOW_THREADS
+    if (status != 0) PyErr_SetString(PyExc_OSError, ctx.error);
+    return status;
+}
+
+static PyObject*
+read_matrix(PyObject* args, PyObject* kwargs, int ncomp)
+{
+    Matrix*           m;
+    struct MatrixTask t;
+    static char*      kwlist[] = {
+        "fname", "nrows", "ncols", "fmt", "init_line", "nthreads", NULL};
+
+    t.fmt = ncomp == 2 ? CPLX_READ_FMT : REAL_READ_FMT;
+    t.init_line = 0;
+    t.nthreads = 1;
+    if (!PyArg_ParseTupleAndKeywords(
+            args,
+            kwargs,
+            "sii|sii",
+            kwlist,
+            &t.fname,
+            &t.nrows,
+            &t.ncols,
+            &t.fmt,
+            &t.init_line,
+            &t.nthreads))
+    {
+        return NULL;
+    }
+    m = new_matrix(ncomp, t.nrows, t.ncols);
+    if (m == NULL) return NULL;
+    t.ncomp = ncomp;
+    t.data = m->data;
+    if (t.nrows > 0 && t.ncols > 0 && run_released(read_task, &t) != 0)
+    {
+        Py_DECREF(m);
+        return NULL;
+    }
+    return as_array(m);
+}
+
+static PyObject*
+load_matrix(PyObject* args, PyObject* kwargs, int ncomp)
+{
+    struct MatrixTask t;
+    static char*      kwlist[] = {"fname", "fmt", "init_line", NULL};
+
+    t.fmt = ncomp == 2 ? CPLX_READ_FMT : REAL_READ_FMT;
+    t.init_line = 0;
+    if (!PyArg_ParseTupleAndKeywords(
+            args, kwargs, "s|si", kwlist, &t.fname, &t.fmt, &t.init_line))
+    {
+        return NULL;
+    }
+    t.ncomp = ncomp;
+    t.data = NULL;
+    if (run_released(load_task, &t) != 0) return NULL;
+    return as_array(wrap_matrix(t.data, ncomp, t.nrows, t.ncols));
+}
+
+/** Check buffer holds doubles of the given kind in host byte order */
+static int
+is_double_format(const char* format, int ncomp)
+{
+    if (format == NULL) return 0;
+    if (*format == '@' || *format == '=' || *format == '<') format++;
+    return strcmp(format, ncomp == 2 ? "Zd" : "d") == 0;
+}
+
+static PyObject*
+record_matrix(PyObject* args, PyObject* kwargs, int ncomp)
+{
+    int               status;
+    PyObject*         obj;
+    Py_buffer         view;
+    Py_ssize_t        item, step;
+    struct MatrixTask t;
+    static char*      kwlist[] = {"fname", "mat", "fmt", "nthreads", NULL};
+
+    t.fmt = ncomp == 2 ? CPLX_SCIFMT_SPACE_BEFORE : REAL_SCIFMT_SPACE_BEFORE;
+    t.nthreads = 1;
+    if (!PyArg_ParseTupleAndKeywords(
+            args, kwargs, "sO|si", kwlist, &t.fname, &obj, &t.fmt, &t.nthreads))
+    {
+        return NULL;
+    }
+    if (PyObject_GetBuffer(obj, &view, PyBUF_RECORDS_RO) != 0) return NULL;
+    item = ncomp * sizeof(double);
+    if (!is_double_format(view.format, ncomp) || view.itemsize != item)
+    {
+        PyErr_Format(
+            PyExc_TypeError,
+            "expected buffer of %s values",
+            ncomp == 2 ? "complex128" : "float64");
+        PyBuffer_Release(&view);
+        return NULL;
+    }
+    if (view.ndim < 1 || view.ndim > 2)
+    {
+        PyErr_SetString(PyExc_ValueError, "expected 1D or 2D buffer");
+        PyBuffer_Release(&view);
+        return NULL;
+    }
+    for (int k = 0; k < view.ndim; k++)
+    {
+        step = view.strides[k] / item;
+        if (view.strides[k] % item != 0 || step > INT_MAX || step < -INT_MAX
+            || view.shape[k] > INT_MAX)
+        {
+            PyErr_SetString(
+                PyExc_ValueError, "strides not supported by matrix slices");
+            PyBuffer_Release(&view);
+            return NULL;
+        }
+    }
+    /* unit leading dimension, thus steps are the strides of the buffer */
+    t.ncomp = ncomp;
+    t.data = (double*) view.buf;
+    t.slice.row0 = 0;
+    t.slice.nrows = view.shape[0];
+    t.slice.row_step = view.strides[0] / item;
+    t.slice.col0 = 0;
+    t.slice.ncols = view.ndim == 2 ? view.shape[1] : 1;
+    t.slice.col_step = view.ndim == 2 ? view.strides[1] / item : 1;
+    t.slice.ld = 1;
+    t.slice.order = ROW_MAJOR;
+    status = 0;
+    if (t.slice.nrows > 0 && t.slice.ncols > 0)
+    {
+        status = run_released(record_task, &t);
+    }
+    PyBuffer_Release(&view);
+    if (status != 0) return NULL;
+    Py_RETURN_NONE;
+}
+
+static PyObject*
+py_cmat_read(PyObject* self, PyObject* args, PyObject* kwargs)
+{
+    (void) self;
+    return read_matrix(args, kwargs, 2);
+}
+
+static PyObject*
+py_rmat_read(PyObject* self, PyObject* args, PyObject* kwargs)
+{
+    (void) self;
+    return read_matrix(args, kwargs, 1);
+}
+
+static PyObject*
+py_cmat_load(PyObject* self, PyObject* args, PyObject* kwargs)
+{
+    (void) self;
+    return load_matrix(args, kwargs, 2);
+}
+
+static PyObject*
+py_rmat_load(PyObject* self, PyObject* args, PyObject* kwargs)
+{
+    (void) self;
+    return load_matrix(args, kwargs, 1);
+}
+
+static PyObject*
+py_cmat_txt(PyObject* self, PyObject* args, PyObject* kwargs)
+{
+    (void) self;
+    return record_matrix(args, kwargs, 2);
+}
+
+static PyObject*
+py_rmat_txt(PyObject* self, PyObject* args, PyObject* kwargs)
+{
+    (void) self;
+    return record_matrix(args, kwargs, 1);
+}
+
+static PyMethodDef module_methods[] = {
+    {"cmat_read",
+     (PyCFunction) (void (*)(void)) py_cmat_read,
+     METH_VARARGS | METH_KEYWORDS,
+     "cmat_read(fname, nrows, ncols, fmt=' (%lf%lfj)', init_line=0, "
+     "nthreads=1)\n\nRead complex matrix of known shape"},
+    {"rmat_read",
+     (PyCFunction) (void (*)(void)) py_rmat_read,
+     METH_VARARGS | METH_KEYWORDS,
+     "rmat_read(fname, nrows, ncols, fmt='%lf', init_line=0, nthreads=1)"
+     "\n\nRead real matrix of known shape"},
+    {"cmat_load",
+     (PyCFunction) (void (*)(void)) py_cmat_load,
+     METH_VARARGS | METH_KEYWORDS,
+     "cmat_load(fname, fmt=' (%lf%lfj)', init_line=0)\n\n"
+     "Read complex matrix with shape given by the file, as numpy loadtxt"},
+    {"rmat_load",
+     (PyCFunction) (void (*)(void)) py_rmat_load,
+     METH_VARARGS | METH_KEYWORDS,
+     "rmat_load(fname, fmt='%lf', init_line=0)\n\n"
+     "Read real matrix with shape given by the file, as numpy loadtxt"},
+    {"cmat_txt",
+     (PyCFunction) (void (*)(void)) py_cmat_txt,
+     METH_VARARGS | METH_KEYWORDS,
+     "cmat_txt(fname, mat, fmt=' (%.15E%+.15Ej)', nthreads=1)\n\n"
+     "Record 1D or 2D buffer of complex128 values, as numpy savetxt"},
+    {"rmat_txt",
+     (PyCFunction) (void (*)(void)) py_rmat_txt,
+     METH_VARARGS | METH_KEYWORDS,
+     "rmat_txt(fname, mat, fmt=' %.15E', nthreads=1)\n\n"
+     "Record 1D or 2D buffer of float64 values, as numpy savetxt"},
+    {NULL, NULL, 0, NULL},
+};
+
+static struct PyModuleDef cpydataio_module = {
+    PyModuleDef_HEAD_INIT,
+    .m_name = "cpydataio",
+    .m_doc = "Fast reading and recording of matrices in text files",
+    .m_size = -1,
+    .m_methods = module_methods,
+};
+
+PyMODINIT_FUNC
+PyInit_cpydataio(void)
+{
+    PyObject* module;
+
+    if (PyType_Ready(&MatrixType) < 0) return NULL;
+    module = PyModule_Create(&cpydataio_module);
+    if (module == NULL) return NULL;
+    if (PyModule_AddObjectRef(module, "Matrix", (PyObject*) &MatrixType) < 0)
+    {
+        Py_DECREF(module);
+        return NULL;
+    }
+    return module;
+}
@@ -0,0 +1,288 @@
+#include "async_recorder.h"
+#include "data_recorder.h"
+#include "format_plan.h"
+#include "io_context.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void
+record_job(struct AsyncJob* job)
+{
+    if (job->ncomp == 2)
+    {
+        crowmajor_txt(
+            job->fname,
+            job->fmt,
+            job->nrows,
+            job->ncols,
+            job->ld,
+            (double complex*) job->data);
+    } else
+    {
+        rrowmajor_txt(
+            job->fname, job->fmt, job->nrows, job->ncols, job->ld, job->data);
+    }
+    free(job->data);
+    free(job->fname);
+    if (!format_is_plan(job->fmt)) free(job->fmt);
+}
+
+/** Record the oldest snapshot, keeping its slot busy until written */
+static void*
+async_worker(void* arg)
+{
+    struct AsyncRecorder* ar;
+
+    ar = (struct AsyncRecorder*) arg;
+    io_context_bind(&ar->ctx);
+    pthread_mutex_lock(&ar->lock);
+    while (1)
+    {
+        while (ar->count == 0 && !ar->stop)
+        {
+            pthread_cond_wait(&ar->changed, &ar->lock);
+        }
+        if (ar->count == 0) break;
+        pthread_mutex_unlock(&ar->lock);
+        record_job(&ar->jobs[ar->head]);
+        pthread_mutex_lock(&ar->lock);
+        ar->head = (ar->head + 1) % ar->depth;
+        ar->count--;
+        pthread_cond_broadcast(&ar->changed);
+    }
+    pthread_mutex_unlock(&ar->lock);
+    return NULL;
+}
+
+void
+async_recorder_open(struct AsyncRecorder* ar, int depth)
+{
+    if (depth <= 0) depth = DEFAULT_ASYNC_DEPTH;
+    ar->depth = depth;
+    ar->head = 0;
+    ar->count = 0;
+    ar->stop = 0;
+    io_context_inherit(&ar->ctx);
+    ar->jobs = (struct AsyncJob*) malloc(depth * sizeof(struct AsyncJob));
+    if (ar->jobs == NULL)
+    {
+        io_error("no memory for asynchronous recorder");
+    }
+    pthread_mutex_init(&ar->lock, NULL);
+    pthread_cond_init(&ar->changed, NULL);
+    if (pthread_create(&ar->thread, NULL, async_worker, ar) != 0)
+    {
+        pthread_cond_destroy(&ar->changed);
+        pthread_mutex_destroy(&ar->lock);
+        free(ar->jobs);
+        ar->jobs = NULL;
+        io_error("unable to create recording thread");
+    }
+}
+
+void
+async_recorder_wait(struct AsyncRecorder* ar)
+{
+    pthread_mutex_lock(&ar->lock);
+    while (ar->count > 0) pthread_cond_wait(&ar->changed, &ar->lock);
+    pthread_mutex_unlock(&ar->lock);
+}
+
+void
+async_recorder_close(struct AsyncRecorder* ar)
+{
+    pthread_mutex_lock(&ar->lock);
+    ar->stop = 1;
+    pthread_cond_broadcast(&ar->changed);
+    pthread_mutex_unlock(&ar->lock);
+    pthread_join(ar->thread, NULL);
+    pthread_cond_destroy(&ar->changed);
+    pthread_mutex_destroy(&ar->lock);
+    free(ar->jobs);
+    ar->jobs = NULL;
+}
+
+/** Wait for a free slot in the queue and return it, with lock released
+ *
+ * The slot is only claimed by `submit_job`, and only the caller thread
+ * submits, thus the slot remains free meanwhile
+ */
+static struct AsyncJob*
+wait_free_slot(struct AsyncRecorder* ar)
+{
+    int tail;
+
+    pthread_mutex_lock(&ar->lock);
+    while (ar->count == ar->depth) pthread_cond_wait(&ar->changed, &ar->lock);
+    tail = (ar->head + ar->count) % ar->depth;
+    pthread_mutex_unlock(&ar->lock);
+    return &ar->jobs[tail];
+}
+
+static void
+submit_job(
+    struct AsyncRecorder* ar,
+    struct AsyncJob*      job,
+    char                  fname[],
+    char                  fmt[],
+    int                   ncomp,
+    int                   nrows,
+    int                   ncols,
+    int                   ld)
+{
+    job->fname = strdup(fname);
+    job->fmt = format_is_plan(fmt) ? fmt : strdup(fmt);
+    if (job->fname == NULL || job->fmt == NULL)
+    {
+        free(job->fname);
+        if (job->fmt != fmt) free(job->fmt);
+        io_error("no memory to record %s asynchronously", fname);
+    }
+    job->ncomp = ncomp;
+    job->nrows = nrows;
+    job->ncols = ncols;
+    job->ld = ld;
+    pthread_mutex_lock(&ar->lock);
+    ar->count++;
+    pthread_cond_broadcast(&ar->changed);
+    pthread_mutex_unlock(&ar->lock);
+}
+
+/** Allocate snapshot of `nrows` rows with `ncols * ncomp` doubles */
+static double*
+alloc_snapshot(char fname[], int nrows, int ncols, int ncomp)
+{
+    size_t  n;
+    double* data;
+
+    n = (size_t) nrows * ncols * ncomp;
+    data = (double*) malloc(n * sizeof(double) + 1);
+    if (data == NULL)
+    {
+        io_error("no memory for snapshot of %s", fname);
+    }
+    return data;
+}
+
+/** Copy matrix given by row pointers or contiguous storage to snapshot */
+static void
+submit_snapshot(
+    struct AsyncRecorder* ar,
+    char                  fname[],
+    char                  fmt[],
+    int                   ncomp,
+    int                   nrows,
+    int                   ncols,
+    void**                rows,
+    double*               data,
+    int                   ld)
+{
+    size_t           row_bytes;
+    const double*    row;
+    struct AsyncJob* job;
+    struct IoCleanup cleanup;
+
+    job = wait_free_slot(ar);
+    job->data = alloc_snapshot(fname, nrows, ncols, ncomp);
+    io_cleanup_push(&cleanup, free, job->data);
+    row_bytes = (size_t) ncols * ncomp * sizeof(double);
+    for (int i = 0; i < nrows; i++)
+    {
+        if (rows != NULL)
+        {
+            row = (const double*) rows[i];
+        } else
+        {
+            row = data + (size_t) i * ld * ncomp;
+        }
+        memcpy((char*) job->data + i * row_bytes, row, row_bytes);
+    }
+    submit_job(ar, job, fname, fmt, ncomp, nrows, ncols, ncols);
+    io_cleanup_pop(&cleanup, 0);
+}
+
+void
+async_cmat_txt(
+    struct AsyncRecorder* ar,
+    char                  fname[],
+    char                  fmt[],
+    int                   nrows,
+    int                   ncols,
+    double complex**      mat)
+{
+    submit_snapshot(ar, fname, fmt, 2, nrows, ncols, (void**) mat, NULL, 0);
+}
+
+void
+async_rmat_txt(
+    struct AsyncRecorder* ar,
+    char                  fname[],
+    char                  fmt[],
+    int                   nrows,
+    int                   ncols,
+    double**              mat)
+{
+    submit_snapshot(ar, fname, fmt, 1, nrows, ncols, (void**) mat, NULL, 0);
+}
+
+void
+async_crowmajor_txt(
+    struct AsyncRecorder* ar,
+    char                  fname[],
+    char                  fmt[],
+    int                   nrows,
+    int                   ncols,
+    int                   ld,
+    double complex*       mat)
+{
+    submit_snapshot(
+        ar, fname, fmt, 2, nrows, ncols, NULL, (double*) mat, ld);
+}
+
+void
+async_rrowmajor_txt(
+    struct AsyncRecorder* ar,
+    char                  fname[],
+    char                  fmt[],
+    int                   nrows,
+    int                   ncols,
+    int                   ld,
+    double*               mat)
+{
+    submit_snapshot(ar, fname, fmt, 1, nrows, ncols, NULL, mat, ld);
+}
+
+void
+async_crowmajor_txt_owned(
+    struct AsyncRecorder* ar,
+    char                  fname[],
+    char                  fmt[],
+    int                   nrows,
+    int                   ncols,
+    int                   ld,
+    double complex*       mat)
+{
+    struct AsyncJob* job;
+
+    job = wait_free_slot(ar);
+    job->data = (double*) mat;
+    submit_job(ar, job, fname, fmt, 2, nrows, ncols, ld);
+}
+
+void
+async_rrowmajor_txt_owned(
+    struct AsyncRecorder* ar,
+    char                  fname[],
+    char                  fmt[],
+    int                   nrows,
+    int                   ncols,
+    int                   ld,
+    double*               mat)
+{
+    struct AsyncJob* job;
+
+    job = wait_free_slot(ar);
+    job->data = mat;
+    submit_job(ar, job, fname, fmt, 1, nrows, ncols, ld);
+}
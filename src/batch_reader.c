@@ -0,0 +1,335 @@
+#include "batch_reader.h"
+#include "data_reader.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/** Jobs dealt to one thread, taken from the head by the owner and from
+ * the tail by the other threads */
+struct JobQueue
+{
+    pthread_mutex_t lock;
+    int*            ids;
+    int             head;
+    int             tail;
+};
+
+/** State shared by all threads of one batch */
+struct BatchRead
+{
+    struct ReadJob*     jobs;
+    struct JobQueue*    queues;
+    int*                ids;
+    int                 nthreads;
+    struct IoContext    settings;
+    pthread_t*          threads;
+    struct BatchWorker* workers;
+    struct IoCleanup    cleanup;
+};
+
+/** One thread of the pool and the queue it owns */
+struct BatchWorker
+{
+    struct BatchRead* batch;
+    int               id;
+};
+
+/** File of a job and its size, used to deal the largest files first */
+struct JobSize
+{
+    int   id;
+    off_t size;
+};
+
+static void
+set_job(
+    struct ReadJob* job,
+    char            fname[],
+    char            fmt[],
+    int             init_line,
+    int             ncomp,
+    int             nrows,
+    int             ncols,
+    void**          rows,
+    double*         data,
+    int             ld)
+{
+    job->fname = fname;
+    job->fmt = fmt;
+    job->init_line = init_line;
+    job->ncomp = ncomp;
+    job->nrows = nrows;
+    job->ncols = ncols;
+    job->rows = rows;
+    job->data = data;
+    job->ld = ld;
+    job->status = 0;
+    job->error[0] = '\0';
+}
+
+void
+cmat_read_job(
+    struct ReadJob*  job,
+    char             fname[],
+    char             fmt[],
+    int              init_line,
+    int              nrows,
+    int              ncols,
+    double complex** mat)
+{
+    set_job(
+        job, fname, fmt, init_line, 2, nrows, ncols, (void**) mat, NULL, 0);
+}
+
+void
+rmat_read_job(
+    struct ReadJob* job,
+    char            fname[],
+    char            fmt[],
+    int             init_line,
+    int             nrows,
+    int             ncols,
+    double**        mat)
+{
+    set_job(
+        job, fname, fmt, init_line, 1, nrows, ncols, (void**) mat, NULL, 0);
+}
+
+void
+crowmajor_read_job(
+    struct ReadJob* job,
+    char            fname[],
+    char            fmt[],
+    int             init_line,
+    int             nrows,
+    int             ncols,
+    int             ld,
+    double complex* mat)
+{
+    set_job(
+        job, fname, fmt, init_line, 2, nrows, ncols, NULL, (double*) mat, ld);
+}
+
+void
+rrowmajor_read_job(
+    struct ReadJob* job,
+    char            fname[],
+    char            fmt[],
+    int             init_line,
+    int             nrows,
+    int             ncols,
+    int             ld,
+    double*         mat)
+{
+    set_job(job, fname, fmt, init_line, 1, nrows, ncols, NULL, mat, ld);
+}
+
+/** Call the reader of the job, raising errors with `io_error` */
+static void
+read_task(void* arg)
+{
+    struct ReadJob* job;
+
+    job = (struct ReadJob*) arg;
+    if (job->ncomp == 2 && job->rows != NULL)
+    {
+        cmat_txt_read(
+            job->fname,
+            job->fmt,
+            job->init_line,
+            job->nrows,
+            job->ncols,
+            (double complex**) job->rows);
+    } else if (job->ncomp == 2)
+    {
+        crowmajor_txt_read(
+            job->fname,
+            job->fmt,
+            job->init_line,
+            job->nrows,
+            job->ncols,
+            job->ld,
+            (double complex*) job->data);
+    } else if (job->rows != NULL)
+    {
+        rmat_txt_read(
+            job->fname,
+            job->fmt,
+            job->init_line,
+            job->nrows,
+            job->ncols,
+            (double**) job->rows);
+    } else
+    {
+        rrowmajor_txt_read(
+            job->fname,
+            job->fmt,
+            job->init_line,
+            job->nrows,
+            job->ncols,
+            job->ld,
+            job->data);
+    }
+}
+
+/** Take next job of own queue or steal one, returning -1 if none left
+ *
+ * No job is added after the threads start, thus once all queues are
+ * found empty the thread is done
+ */
+static int
+take_job(struct BatchRead* batch, int self)
+{
+    int              id;
+    struct JobQueue* q;
+
+    for (int k = 0; k < batch->nthreads; k++)
+    {
+        q = &batch->queues[(self + k) % batch->nthreads];
+        id = -1;
+        pthread_mutex_lock(&q->lock);
+        if (q->head < q->tail)
+        {
+            id = k == 0 ? q->ids[q->head++] : q->ids[--q->tail];
+        }
+        pthread_mutex_unlock(&q->lock);
+        if (id >= 0) return id;
+    }
+    return -1;
+}
+
+static void*
+batch_worker(void* arg)
+{
+    int                 id;
+    struct ReadJob*     job;
+    struct IoContext    ctx;
+    struct BatchWorker* worker;
+
+    worker = (struct BatchWorker*) arg;
+    while ((id = take_job(worker->batch, worker->id)) >= 0)
+    {
+        job = &worker->batch->jobs[id];
+        ctx = worker->batch->settings;
+        job->status = io_context_run(&ctx, read_task, job);
+        memcpy(job->error, ctx.error, IO_ERROR_SIZE);
+    }
+    return NULL;
+}
+
+static int
+larger_file_first(const void* a, const void* b)
+{
+    off_t size_a, size_b;
+
+    size_a = ((const struct JobSize*) a)->size;
+    size_b = ((const struct JobSize*) b)->size;
+    return (size_a < size_b) - (size_a > size_b);
+}
+
+/** Deal jobs to the queues in turns, from the largest file */
+static void
+deal_jobs(struct BatchRead* batch, int njobs)
+{
+    struct stat      info;
+    struct JobSize*  sizes;
+    struct JobQueue* q;
+
+    sizes = (struct JobSize*) malloc(njobs * sizeof(struct JobSize));
+    if (sizes == NULL) io_error("no memory to sort batch of %d files", njobs);
+    for (int i = 0; i < njobs; i++)
+    {
+        sizes[i].id = i;
+        sizes[i].size = 0;
+        if (stat(batch->jobs[i].fname, &info) == 0)
+        {
+            sizes[i].size = info.st_size;
+        }
+    }
+    qsort(sizes, njobs, sizeof(struct JobSize), larger_file_first);
+    for (int i = 0; i < njobs; i++)
+    {
+        q = &batch->queues[i % batch->nthreads];
+        q->ids[q->tail++] = sizes[i].id;
+    }
+    free(sizes);
+}
+
+static void
+release_batch_read(void* arg)
+{
+    struct BatchRead* batch;
+
+    batch = (struct BatchRead*) arg;
+    for (int t = 0; t < batch->nthreads; t++)
+    {
+        pthread_mutex_destroy(&batch->queues[t].lock);
+    }
+    free(batch->queues);
+    free(batch->ids);
+    free(batch->threads);
+    free(batch->workers);
+}
+
+int
+batch_read(struct ReadJob* jobs, int njobs, int nthreads)
+{
+    int              t, nstarted, nfailed, capacity;
+    struct BatchRead batch;
+
+    if (njobs <= 0) return 0;
+    if (nthreads <= 0)
+    {
+        nthreads = BATCH_THREADS_PER_CORE * sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    if (nthreads > njobs) nthreads = njobs;
+    if (nthreads < 1) nthreads = 1;
+    capacity = njobs / nthreads + 1;
+    batch.jobs = jobs;
+    batch.nthreads = nthreads;
+    io_context_inherit(&batch.settings);
+    batch.queues = (struct JobQueue*) malloc(nthreads * sizeof(*batch.queues));
+    batch.ids = (int*) malloc((size_t) nthreads * capacity * sizeof(int));
+    batch.threads = (pthread_t*) malloc(nthreads * sizeof(pthread_t));
+    batch.workers =
+        (struct BatchWorker*) malloc(nthreads * sizeof(*batch.workers));
+    if (batch.queues == NULL || batch.ids == NULL || batch.threads == NULL
+        || batch.workers == NULL)
+    {
+        batch.nthreads = 0;
+        release_batch_read(&batch);
+        io_error("no memory for batch of %d files", njobs);
+    }
+    for (t = 0; t < nthreads; t++)
+    {
+        pthread_mutex_init(&batch.queues[t].lock, NULL);
+        batch.queues[t].head = 0;
+        batch.queues[t].tail = 0;
+        batch.queues[t].ids = batch.ids + (size_t) t * capacity;
+        batch.workers[t].batch = &batch;
+        batch.workers[t].id = t;
+    }
+    io_cleanup_push(&batch.cleanup, release_batch_read, &batch);
+    deal_jobs(&batch, njobs);
+    // jobs of threads that could not be started are stolen by the others
+    for (nstarted = 1; nstarted < nthreads; nstarted++)
+    {
+        if (pthread_create(
+                &batch.threads[nstarted],
+                NULL,
+                batch_worker,
+                &batch.workers[nstarted])
+            != 0)
+        {
+            break;
+        }
+    }
+    batch_worker(&batch.workers[0]);
+    for (t = 1; t < nstarted; t++) pthread_join(batch.threads[t], NULL);
+    nfailed = 0;
+    for (int i = 0; i < njobs; i++) nfailed += jobs[i].status != 0;
+    io_cleanup_pop(&batch.cleanup, 1);
+    return nfailed;
+}
@@ -0,0 +1,809 @@
+#include "checkpoint.h"
+#include "io_context.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef DATAIO_WITH_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef DATAIO_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+/** Magic string starting every checkpoint file, followed by version */
+#define CHECKPOINT_MAGIC     "CPYCKPT"
+#define CHECKPOINT_VERSION   1
+#define CHECKPOINT_HEAD_SIZE 16
+
+/** Magic string ending the trailer, preceded by index offset and size */
+#define CHECKPOINT_INDEX_MAGIC "CPYINDEX"
+#define CHECKPOINT_TAIL_SIZE   24
+
+/** Size of the fixed fields of each entry in the index, after its name */
+#define CHECKPOINT_ENTRY_SIZE 36
+
+static void
+checkpoint_problem(char fname[], char info[])
+{
+    io_error("%s in checkpoint file %s", info, fname);
+}
+
+static int
+host_is_big_endian()
+{
+    const uint16_t one = 1;
+    return *((const unsigned char*) &one) == 0;
+}
+
+static void
+swap_doubles(double* values, size_t n)
+{
+    uint64_t bits;
+
+    for (size_t k = 0; k < n; k++)
+    {
+        memcpy(&bits, &values[k], sizeof(bits));
+        bits = __builtin_bswap64(bits);
+        memcpy(&values[k], &bits, sizeof(bits));
+    }
+}
+
+static void
+put_u64(unsigned char* p, uint64_t v)
+{
+    for (int k = 0; k < 8; k++) p[k] = (v >> (8 * k)) & 0xFF;
+}
+
+static uint64_t
+get_u64(const unsigned char* p)
+{
+    uint64_t v = 0;
+    for (int k = 7; k >= 0; k--) v = (v << 8) | p[k];
+    return v;
+}
+
+static void
+write_exactly(struct CheckpointWriter* w, const void* src, size_t nbytes)
+{
+    if (fwrite(src, 1, nbytes, w->f) != nbytes)
+    {
+        checkpoint_problem(w->fname, "failed writing data");
+    }
+    w->offset += nbytes;
+}
+
+/** Read `nbytes` at `offset` of the file, retrying partial reads */
+static void
+pread_exactly(int fd, char fname[], void* dest, size_t nbytes, uint64_t offset)
+{
+    ssize_t n;
+    char*   p;
+
+    p = (char*) dest;
+    while (nbytes > 0)
+    {
+        n = pread(fd, p, nbytes, offset);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) checkpoint_problem(fname, "unexpected end of data");
+        p += n;
+        offset += n;
+        nbytes -= n;
+    }
+}
+
+/** Assure buffer has at least `size` bytes, preserving nothing */
+static void
+reserve(char** buf, size_t* buf_size, size_t size, char fname[])
+{
+    if (size <= *buf_size) return;
+    free(*buf);
+    *buf_size = 0;
+    *buf = (char*) malloc(size);
+    if (*buf == NULL) checkpoint_problem(fname, "no memory for block of rows");
+    *buf_size = size;
+}
+
+static void
+release_buffer(void* arg)
+{
+    free(*(char**) arg);
+}
+
+static void
+free_entries(struct CheckpointEntry* entries, int nentries)
+{
+    for (int i = 0; i < nentries; i++)
+    {
+        free(entries[i].offsets);
+        free(entries[i].stored);
+    }
+    free(entries);
+}
+
+static void
+release_writer(void* arg)
+{
+    struct CheckpointWriter* w;
+
+    w = (struct CheckpointWriter*) arg;
+    if (w->f != NULL) fclose(w->f);
+    free_entries(w->entries, w->nentries);
+    free(w->chunk);
+    free(w->packed);
+    free(w->fname);
+    w->f = NULL;
+    w->fname = NULL;
+    w->entries = NULL;
+    w->nentries = 0;
+    w->chunk = NULL;
+    w->packed = NULL;
+}
+
+void
+checkpoint_open(struct CheckpointWriter* w, char fname[], enum Compression how)
+{
+    unsigned char    head[CHECKPOINT_HEAD_SIZE];
+    struct IoCleanup cleanup;
+
+#ifndef DATAIO_WITH_ZLIB
+    if (how == GZIP_COMPRESSION)
+    {
+        checkpoint_problem(fname, "library built without zlib requested");
+    }
+#endif
+#ifndef DATAIO_WITH_ZSTD
+    if (how == ZSTD_COMPRESSION)
+    {
+        checkpoint_problem(fname, "library built without zstd requested");
+    }
+#endif
+    w->fname = strdup(fname);
+    w->f = fopen(fname, "wb");
+    w->how = how;
+    w->offset = 0;
+    w->nentries = 0;
+    w->capacity = 0;
+    w->entries = NULL;
+    w->chunk = NULL;
+    w->chunk_size = 0;
+    w->packed = NULL;
+    w->packed_size = 0;
+    io_cleanup_push(&cleanup, release_writer, w);
+    if (w->fname == NULL || w->f == NULL)
+    {
+        checkpoint_problem(fname, "failed to open");
+    }
+    memset(head, 0, sizeof(head));
+    memcpy(head, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC) - 1);
+    head[sizeof(CHECKPOINT_MAGIC) - 1] = CHECKPOINT_VERSION;
+    write_exactly(w, head, sizeof(head));
+    io_cleanup_pop(&cleanup, 0);
+}
+
+/** Compress block of rows returning the bytes to store
+ *
+ * Blocks which do not shrink are stored as they are, thus any block with
+ * as many bytes as its rows is known to be uncompressed
+ */
+static char*
+pack_chunk(struct CheckpointWriter* w, size_t nbytes, size_t* stored)
+{
+    *stored = nbytes;
+    switch (w->how)
+    {
+#ifdef DATAIO_WITH_ZLIB
+        case GZIP_COMPRESSION:
+        {
+            int    level = active_compression_level();
+            uLongf bound = compressBound(nbytes);
+            reserve(&w->packed, &w->packed_size, bound, w->fname);
+            if (compress2(
+                    (Bytef*) w->packed,
+                    &bound,
+                    (const Bytef*) w->chunk,
+                    nbytes,
+                    level < 0 ? Z_DEFAULT_COMPRESSION : (level > 9 ? 9 : level))
+                    != Z_OK
+                || bound >= nbytes)
+            {
+                return w->chunk;
+            }
+            *stored = bound;
+            return w->packed;
+        }
+#endif
+#ifdef DATAIO_WITH_ZSTD
+        case ZSTD_COMPRESSION:
+        {
+            int    level = active_compression_level();
+            size_t size, bound = ZSTD_compressBound(nbytes);
+            reserve(&w->packed, &w->packed_size, bound, w->fname);
+            size = ZSTD_compress(
+                w->packed,
+                bound,
+                w->chunk,
+                nbytes,
+                level < 0 ? ZSTD_CLEVEL_DEFAULT : level);
+            if (ZSTD_isError(size) || size >= nbytes) return w->chunk;
+            *stored = size;
+            return w->packed;
+        }
+#endif
+        default:
+            return w->chunk;
+    }
+}
+
+/** Append new entry to the index of the writer checking its name */
+static struct CheckpointEntry*
+new_entry(struct CheckpointWriter* w, char name[])
+{
+    struct CheckpointEntry* e;
+
+    if (strlen(name) == 0 || strlen(name) >= CHECKPOINT_NAME_MAX)
+    {
+        checkpoint_problem(w->fname, "array name empty or too long");
+    }
+    for (int i = 0; i < w->nentries; i++)
+    {
+        if (strcmp(w->entries[i].name, name) == 0)
+        {
+            checkpoint_problem(w->fname, "array name repeated");
+        }
+    }
+    if (w->nentries == w->capacity)
+    {
+        w->capacity = w->capacity > 0 ? 2 * w->capacity : 16;
+        e = (struct CheckpointEntry*) realloc(
+            w->entries, w->capacity * sizeof(struct CheckpointEntry));
+        if (e == NULL) checkpoint_problem(w->fname, "no memory for index");
+        w->entries = e;
+    }
+    e = &w->entries[w->nentries++];
+    memset(e, 0, sizeof(struct CheckpointEntry));
+    strcpy(e->name, name);
+    return e;
+}
+
+/** Store array given by row pointers or contiguous storage in blocks */
+static void
+write_array(
+    struct CheckpointWriter* w,
+    char                     name[],
+    int                      ncomp,
+    int                      ndim,
+    int                      nrows,
+    int                      ncols,
+    void**                   rows,
+    double*                  data,
+    int                      ld)
+{
+    size_t                  row_len, row_bytes, chunk_rows, stored;
+    char*                   out;
+    double*                 row;
+    struct CheckpointEntry* e;
+
+    if (nrows < 0 || ncols < 1)
+    {
+        checkpoint_problem(w->fname, "array with invalid shape");
+    }
+    e = new_entry(w, name);
+    e->ncomp = ncomp;
+    e->ndim = ndim;
+    e->compression = w->how;
+    e->nrows = nrows;
+    e->ncols = ncols;
+    row_len = (size_t) ncols * ncomp;
+    row_bytes = row_len * sizeof(double);
+    e->rows_per_chunk = CHECKPOINT_CHUNK_BYTES / row_bytes;
+    if (e->rows_per_chunk == 0) e->rows_per_chunk = 1;
+    e->nchunks = (e->nrows + e->rows_per_chunk - 1) / e->rows_per_chunk;
+    e->offsets = (uint64_t*) malloc(e->nchunks * sizeof(uint64_t) + 1);
+    e->stored = (uint64_t*) malloc(e->nchunks * sizeof(uint64_t) + 1);
+    if (e->offsets == NULL || e->stored == NULL)
+    {
+        checkpoint_problem(w->fname, "no memory for index");
+    }
+    reserve(&w->chunk, &w->chunk_size, e->rows_per_chunk * row_bytes, w->fname);
+    for (size_t k = 0; k < e->nchunks; k++)
+    {
+        chunk_rows = e->nrows - k * e->rows_per_chunk;
+        if (chunk_rows > e->rows_per_chunk) chunk_rows = e->rows_per_chunk;
+        for (size_t i = 0; i < chunk_rows; i++)
+        {
+            if (rows != NULL)
+            {
+                row = (double*) rows[k * e->rows_per_chunk + i];
+            } else
+            {
+                row = data + (k * e->rows_per_chunk + i) * ld * ncomp;
+            }
+            memcpy(w->chunk + i * row_bytes, row, row_bytes);
+        }
+        if (host_is_big_endian())
+        {
+            swap_doubles((double*) w->chunk, chunk_rows * row_len);
+        }
+        out = pack_chunk(w, chunk_rows * row_bytes, &stored);
+        e->offsets[k] = w->offset;
+        e->stored[k] = stored;
+        write_exactly(w, out, stored);
+    }
+}
+
+void
+checkpoint_carr(
+    struct CheckpointWriter* w, char name[], int arr_size, double complex* arr)
+{
+    write_array(w, name, 2, 1, arr_size, 1, NULL, (double*) arr, 1);
+}
+
+void
+checkpoint_rarr(
+    struct CheckpointWriter* w, char name[], int arr_size, double* arr)
+{
+    write_array(w, name, 1, 1, arr_size, 1, NULL, arr, 1);
+}
+
+void
+checkpoint_cmat(
+    struct CheckpointWriter* w,
+    char                     name[],
+    int                      nrows,
+    int                      ncols,
+    double complex**         mat)
+{
+    write_array(w, name, 2, 2, nrows, ncols, (void**) mat, NULL, 0);
+}
+
+void
+checkpoint_rmat(
+    struct CheckpointWriter* w,
+    char                     name[],
+    int                      nrows,
+    int                      ncols,
+    double**                 mat)
+{
+    write_array(w, name, 1, 2, nrows, ncols, (void**) mat, NULL, 0);
+}
+
+void
+checkpoint_crowmajor(
+    struct CheckpointWriter* w,
+    char                     name[],
+    int                      nrows,
+    int                      ncols,
+    int                      ld,
+    double complex*          mat)
+{
+    write_array(w, name, 2, 2, nrows, ncols, NULL, (double*) mat, ld);
+}
+
+void
+checkpoint_rrowmajor(
+    struct CheckpointWriter* w,
+    char                     name[],
+    int                      nrows,
+    int                      ncols,
+    int                      ld,
+    double*                  mat)
+{
+    write_array(w, name, 1, 2, nrows, ncols, NULL, mat, ld);
+}
+
+/** Serialize the index, with all integers in little-endian order */
+static unsigned char*
+encode_index(struct CheckpointWriter* w, size_t* size)
+{
+    size_t                  len;
+    unsigned char*          buf;
+    unsigned char*          p;
+    struct CheckpointEntry* e;
+
+    len = 8;
+    for (int i = 0; i < w->nentries; i++)
+    {
+        len += 1 + strlen(w->entries[i].name) + CHECKPOINT_ENTRY_SIZE;
+        len += 16 * w->entries[i].nchunks;
+    }
+    buf = (unsigned char*) malloc(len);
+    if (buf == NULL) checkpoint_problem(w->fname, "no memory for index");
+    p = buf;
+    put_u64(p, w->nentries);
+    p += 8;
+    for (int i = 0; i < w->nentries; i++)
+    {
+        e = &w->entries[i];
+        *p++ = strlen(e->name);
+        memcpy(p, e->name, strlen(e->name));
+        p += strlen(e->name);
+        p[0] = e->ncomp;
+        p[1] = e->ndim;
+        p[2] = e->compression;
+        p[3] = 0;
+        put_u64(p + 4, e->nrows);
+        put_u64(p + 12, e->ncols);
+        put_u64(p + 20, e->rows_per_chunk);
+        put_u64(p + 28, e->nchunks);
+        p += CHECKPOINT_ENTRY_SIZE;
+        for (size_t k = 0; k < e->nchunks; k++)
+        {
+            put_u64(p, e->offsets[k]);
+            put_u64(p + 8, e->stored[k]);
+            p += 16;
+        }
+    }
+    *size = len;
+    return buf;
+}
+
+void
+checkpoint_close(struct CheckpointWriter* w)
+{
+    int              failed;
+    size_t           index_size;
+    uint64_t         index_offset;
+    unsigned char*   index;
+    unsigned char    tail[CHECKPOINT_TAIL_SIZE];
+    struct IoCleanup cleanup;
+    struct IoCleanup index_cleanup;
+
+    io_cleanup_push(&cleanup, release_writer, w);
+    index_offset = w->offset;
+    index = encode_index(w, &index_size);
+    io_cleanup_push(&index_cleanup, free, index);
+    write_exactly(w, index, index_size);
+    put_u64(tail, index_offset);
+    put_u64(tail + 8, index_size);
+    memcpy(tail + 16, CHECKPOINT_INDEX_MAGIC, 8);
+    write_exactly(w, tail, sizeof(tail));
+    io_cleanup_pop(&index_cleanup, 1);
+    failed = fclose(w->f) != 0;
+    w->f = NULL;
+    if (failed) checkpoint_problem(w->fname, "failed writing data");
+    io_cleanup_pop(&cleanup, 1);
+}
+
+/** Take `n` bytes of the index advancing the position `p` */
+static const unsigned char*
+take(char fname[], const unsigned char** p, const unsigned char* end, size_t n)
+{
+    const unsigned char* start;
+
+    if ((size_t) (end - *p) < n) checkpoint_problem(fname, "corrupted index");
+    start = *p;
+    *p += n;
+    return start;
+}
+
+static void
+decode_index(
+    struct CheckpointReader* r,
+    const unsigned char*     p,
+    const unsigned char*     end)
+{
+    size_t                  name_len;
+    uint64_t                nentries;
+    const unsigned char*    q;
+    struct CheckpointEntry* e;
+
+    nentries = get_u64(take(r->fname, &p, end, 8));
+    if (nentries > (uint64_t) (end - p) / (1 + CHECKPOINT_ENTRY_SIZE))
+    {
+        checkpoint_problem(r->fname, "corrupted index");
+    }
+    r->entries = (struct CheckpointEntry*) calloc(
+        nentries + 1, sizeof(struct CheckpointEntry));
+    if (r->entries == NULL) checkpoint_problem(r->fname, "no memory for index");
+    for (r->nentries = 0; r->nentries < (int) nentries; r->nentries++)
+    {
+        e = &r->entries[r->nentries];
+        name_len = *take(r->fname, &p, end, 1);
+        if (name_len == 0 || name_len >= CHECKPOINT_NAME_MAX)
+        {
+            checkpoint_problem(r->fname, "corrupted index");
+        }
+        memcpy(e->name, take(r->fname, &p, end, name_len), name_len);
+        q = take(r->fname, &p, end, CHECKPOINT_ENTRY_SIZE);
+        e->ncomp = q[0];
+        e->ndim = q[1];
+        e->compression = q[2];
+        e->nrows = get_u64(q + 4);
+        e->ncols = get_u64(q + 12);
+        e->rows_per_chunk = get_u64(q + 20);
+        e->nchunks = get_u64(q + 28);
+        if ((e->ncomp != 1 && e->ncomp != 2) || e->rows_per_chunk == 0
+            || e->nchunks > (size_t) (end - p) / 16
+            || e->nchunks
+                   != (e->nrows + e->rows_per_chunk - 1) / e->rows_per_chunk)
+        {
+            checkpoint_problem(r->fname, "corrupted index");
+        }
+        e->offsets = (uint64_t*) malloc(e->nchunks * sizeof(uint64_t) + 1);
+        e->stored = (uint64_t*) malloc(e->nchunks * sizeof(uint64_t) + 1);
+        if (e->offsets == NULL || e->stored == NULL)
+        {
+            checkpoint_problem(r->fname, "no memory for index");
+        }
+        for (size_t k = 0; k < e->nchunks; k++)
+        {
+            q = take(r->fname, &p, end, 16);
+            e->offsets[k] = get_u64(q);
+            e->stored[k] = get_u64(q + 8);
+        }
+    }
+}
+
+static void
+release_reader(void* arg)
+{
+    struct CheckpointReader* r;
+
+    r = (struct CheckpointReader*) arg;
+    // entries are zeroed after the last decoded, which may be incomplete
+    if (r->entries != NULL) r->nentries++;
+    checkpoint_read_close(r);
+}
+
+void
+checkpoint_read_open(struct CheckpointReader* r, char fname[])
+{
+    uint64_t         index_offset, index_size;
+    unsigned char*   index;
+    unsigned char    head[CHECKPOINT_HEAD_SIZE];
+    unsigned char    tail[CHECKPOINT_TAIL_SIZE];
+    struct stat      st;
+    struct IoCleanup cleanup;
+    struct IoCleanup index_cleanup;
+
+    r->fname = strdup(fname);
+    r->fd = open(fname, O_RDONLY);
+    r->entries = NULL;
+    r->nentries = 0;
+    io_cleanup_push(&cleanup, release_reader, r);
+    if (r->fname == NULL || r->fd < 0 || fstat(r->fd, &st) != 0)
+    {
+        checkpoint_problem(fname, "failed to open");
+    }
+    if ((uint64_t) st.st_size < CHECKPOINT_HEAD_SIZE + CHECKPOINT_TAIL_SIZE)
+    {
+        checkpoint_problem(fname, "missing index");
+    }
+    pread_exactly(r->fd, fname, head, sizeof(head), 0);
+    if (memcmp(head, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC) - 1) != 0
+        || head[sizeof(CHECKPOINT_MAGIC) - 1] != CHECKPOINT_VERSION)
+    {
+        checkpoint_problem(fname, "bad magic string or version");
+    }
+    pread_exactly(
+        r->fd, fname, tail, sizeof(tail), st.st_size - CHECKPOINT_TAIL_SIZE);
+    index_offset = get_u64(tail);
+    index_size = get_u64(tail + 8);
+    if (memcmp(tail + 16, CHECKPOINT_INDEX_MAGIC, 8) != 0
+        || index_offset + index_size + CHECKPOINT_TAIL_SIZE
+               != (uint64_t) st.st_size)
+    {
+        checkpoint_problem(fname, "missing index");
+    }
+    index = (unsigned char*) malloc(index_size + 1);
+    if (index == NULL) checkpoint_problem(fname, "no memory for index");
+    io_cleanup_push(&index_cleanup, free, index);
+    pread_exactly(r->fd, fname, index, index_size, index_offset);
+    decode_index(r, index, index + index_size);
+    io_cleanup_pop(&index_cleanup, 1);
+    io_cleanup_pop(&cleanup, 0);
+}
+
+const struct CheckpointEntry*
+checkpoint_find(struct CheckpointReader* r, char name[])
+{
+    for (int i = 0; i < r->nentries; i++)
+    {
+        if (strcmp(r->entries[i].name, name) == 0) return &r->entries[i];
+    }
+    return NULL;
+}
+
+/** Decompress stored block `src` with `nbytes` of rows in `dest` */
+static void
+unpack_chunk(
+    struct CheckpointReader*      r,
+    const struct CheckpointEntry* e,
+    char*                         src,
+    size_t                        stored,
+    char*                         dest,
+    size_t                        nbytes)
+{
+    switch (e->compression)
+    {
+#ifdef DATAIO_WITH_ZLIB
+        case GZIP_COMPRESSION:
+        {
+            uLongf size = nbytes;
+            if (uncompress((Bytef*) dest, &size, (Bytef*) src, stored) == Z_OK
+                && size == nbytes)
+            {
+                return;
+            }
+            break;
+        }
+#endif
+#ifdef DATAIO_WITH_ZSTD
+        case ZSTD_COMPRESSION:
+            if (ZSTD_decompress(dest, nbytes, src, stored) == nbytes) return;
+            break;
+#endif
+        default:
+            checkpoint_problem(r->fname, "library built without codec");
+    }
+    checkpoint_problem(r->fname, "corrupted block of rows");
+}
+
+/** Read rows touching only the blocks which contain them */
+static void
+read_rows(
+    struct CheckpointReader* r,
+    char                     name[],
+    int                      ncomp,
+    size_t                   row0,
+    int                      nrows,
+    int                      ld,
+    double*                  dest)
+{
+    size_t                        row_bytes, chunk_rows, first, last;
+    size_t                        raw_size, packed_size;
+    char*                         raw;
+    char*                         packed;
+    double*                       out;
+    const struct CheckpointEntry* e;
+    struct IoCleanup              raw_cleanup;
+    struct IoCleanup              packed_cleanup;
+
+    e = checkpoint_find(r, name);
+    if (e == NULL) checkpoint_problem(r->fname, "array not found");
+    if (e->ncomp != ncomp) checkpoint_problem(r->fname, "array of other kind");
+    if (nrows < 0 || row0 > e->nrows || (size_t) nrows > e->nrows - row0)
+    {
+        checkpoint_problem(r->fname, "rows out of range");
+    }
+    if ((size_t) ld < e->ncols) checkpoint_problem(r->fname, "rows too short");
+    if (nrows == 0) return;
+    row_bytes = e->ncols * ncomp * sizeof(double);
+    raw = NULL;
+    packed = NULL;
+    raw_size = 0;
+    packed_size = 0;
+    io_cleanup_push(&raw_cleanup, release_buffer, &raw);
+    io_cleanup_push(&packed_cleanup, release_buffer, &packed);
+    for (size_t k = row0 / e->rows_per_chunk;
+         k <= (row0 + nrows - 1) / e->rows_per_chunk;
+         k++)
+    {
+        chunk_rows = e->nrows - k * e->rows_per_chunk;
+        if (chunk_rows > e->rows_per_chunk) chunk_rows = e->rows_per_chunk;
+        first = k * e->rows_per_chunk;
+        last = first + chunk_rows;
+        if (first < row0) first = row0;
+        if (last > row0 + nrows) last = row0 + nrows;
+        out = dest + (first - row0) * ld * ncomp;
+        if (e->stored[k] == chunk_rows * row_bytes && (size_t) ld == e->ncols)
+        {
+            pread_exactly(
+                r->fd,
+                r->fname,
+                out,
+                (last - first) * row_bytes,
+                e->offsets[k] + (first - k * e->rows_per_chunk) * row_bytes);
+            continue;
+        }
+        if (e->stored[k] == chunk_rows * row_bytes)
+        {
+            for (size_t i = first; i < last; i++)
+            {
+                pread_exactly(
+                    r->fd,
+                    r->fname,
+                    out + (i - first) * ld * ncomp,
+                    row_bytes,
+                    e->offsets[k] + (i - k * e->rows_per_chunk) * row_bytes);
+            }
+            continue;
+        }
+        reserve(&packed, &packed_size, e->stored[k], r->fname);
+        reserve(&raw, &raw_size, chunk_rows * row_bytes, r->fname);
+        pread_exactly(r->fd, r->fname, packed, e->stored[k], e->offsets[k]);
+        unpack_chunk(
+            r, e, packed, e->stored[k], raw, chunk_rows * row_bytes);
+        for (size_t i = first; i < last; i++)
+        {
+            memcpy(
+                out + (i - first) * ld * ncomp,
+                raw + (i - k * e->rows_per_chunk) * row_bytes,
+                row_bytes);
+        }
+    }
+    io_cleanup_pop(&packed_cleanup, 1);
+    io_cleanup_pop(&raw_cleanup, 1);
+    if (host_is_big_endian())
+    {
+        for (int i = 0; i < nrows; i++)
+        {
+            swap_doubles(dest + (size_t) i * ld * ncomp, e->ncols * ncomp);
+        }
+    }
+}
+
+void
+checkpoint_crows_read(
+    struct CheckpointReader* r,
+    char                     name[],
+    size_t                   row0,
+    int                      nrows,
+    int                      ld,
+    double complex*          dest)
+{
+    read_rows(r, name, 2, row0, nrows, ld, (double*) dest);
+}
+
+void
+checkpoint_rrows_read(
+    struct CheckpointReader* r,
+    char                     name[],
+    size_t                   row0,
+    int                      nrows,
+    int                      ld,
+    double*                  dest)
+{
+    read_rows(r, name, 1, row0, nrows, ld, dest);
+}
+
+static double*
+load_array(
+    struct CheckpointReader* r, char name[], int ncomp, int* nrows, int* ncols)
+{
+    double*                       values;
+    const struct CheckpointEntry* e;
+    struct IoCleanup              cleanup;
+
+    e = checkpoint_find(r, name);
+    if (e == NULL) checkpoint_problem(r->fname, "array not found");
+    *nrows = e->nrows;
+    *ncols = e->ncols;
+    values = (double*) malloc(e->nrows * e->ncols * ncomp * sizeof(double) + 1);
+    if (values == NULL) checkpoint_problem(r->fname, "no memory to load array");
+    io_cleanup_push(&cleanup, free, values);
+    read_rows(r, name, ncomp, 0, e->nrows, e->ncols, values);
+    io_cleanup_pop(&cleanup, 0);
+    return values;
+}
+
+double complex*
+checkpoint_cmat_load(
+    struct CheckpointReader* r, char name[], int* nrows, int* ncols)
+{
+    return (double complex*) load_array(r, name, 2, nrows, ncols);
+}
+
+double*
+checkpoint_rmat_load(
+    struct CheckpointReader* r, char name[], int* nrows, int* ncols)
+{
+    return load_array(r, name, 1, nrows, ncols);
+}
+
+void
+checkpoint_read_close(struct CheckpointReader* r)
+{
+    close(r->fd);
+    free_entries(r->entries, r->nentries);
+    free(r->fname);
+    r->fd = -1;
+    r->fname = NULL;
+    r->entries = NULL;
+    r->nentries = 0;
+}
@@ -0,0 +1,394 @@
+#define _GNU_SOURCE
+#include "compressed_stream.h"
+#include "io_context.h"
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#ifdef DATAIO_WITH_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef DATAIO_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+/** Size of internal buffers of compressed streams */
+#define COMPRESSED_BUFF_SIZE (1 << 17)
+
+int compression_level = DEFAULT_COMPRESSION_LEVEL;
+
+static int
+has_suffix(char fname[], char suffix[])
+{
+    size_t name_len, suffix_len;
+
+    name_len = strlen(fname);
+    suffix_len = strlen(suffix);
+    if (name_len < suffix_len) return 0;
+    return strcmp(fname + name_len - suffix_len, suffix) == 0;
+}
+
+enum Compression
+compression_from_name(char fname[])
+{
+    if (has_suffix(fname, ".gz")) return GZIP_COMPRESSION;
+    if (has_suffix(fname, ".zst")) return ZSTD_COMPRESSION;
+    return NO_COMPRESSION;
+}
+
+enum Compression
+compression_from_magic(const unsigned char* magic, size_t n)
+{
+    if (n >= 2 && magic[0] == 0x1F && magic[1] == 0x8B)
+    {
+        return GZIP_COMPRESSION;
+    }
+    if (n >= 4 && magic[0] == 0x28 && magic[1] == 0xB5 && magic[2] == 0x2F
+        && magic[3] == 0xFD)
+    {
+        return ZSTD_COMPRESSION;
+    }
+    return NO_COMPRESSION;
+}
+
+enum Compression
+compression_of_file(char fname[])
+{
+    size_t        n;
+    unsigned char magic[4];
+    FILE*         f;
+    struct stat   st;
+
+    // opening pipes and devices here would consume data of the reader
+    if (stat(fname, &st) != 0 || !S_ISREG(st.st_mode)) return NO_COMPRESSION;
+    f = fopen(fname, "rb");
+    if (f == NULL) return NO_COMPRESSION;
+    n = fread(magic, 1, sizeof(magic), f);
+    fclose(f);
+    return compression_from_magic(magic, n);
+}
+
+#if defined(DATAIO_WITH_ZLIB) || defined(DATAIO_WITH_ZSTD)
+
+/** Skip `nbytes` of decompressed stream using its own read function */
+static int
+skip_forward(void* cookie, cookie_read_function_t* reader, uint64_t nbytes)
+{
+    ssize_t n;
+    char    scratch[4096];
+
+    while (nbytes > 0)
+    {
+        n = reader(
+            cookie,
+            scratch,
+            nbytes < sizeof(scratch) ? nbytes : sizeof(scratch));
+        if (n <= 0) return -1;
+        nbytes -= n;
+    }
+    return 0;
+}
+
+/** Set target position of a seek request only moving forward */
+static int
+forward_target(uint64_t pos, off64_t* offset, int whence, uint64_t* target)
+{
+    if (whence == SEEK_CUR) *offset += pos;
+    if ((whence != SEEK_SET && whence != SEEK_CUR) || *offset < (off64_t) pos)
+    {
+        errno = ESPIPE;
+        return -1;
+    }
+    *target = *offset;
+    return 0;
+}
+
+#endif
+
+#ifdef DATAIO_WITH_ZLIB
+
+struct GzipCookie
+{
+    gzFile   gz;
+    int      writing;
+    uint64_t pos;
+};
+
+static ssize_t
+gzip_read(void* cookie, char* buf, size_t size)
+{
+    int                n;
+    struct GzipCookie* gc;
+
+    gc = (struct GzipCookie*) cookie;
+    if (size > INT32_MAX) size = INT32_MAX;
+    n = gzread(gc->gz, buf, size);
+    if (n < 0) return -1;
+    gc->pos += n;
+    return n;
+}
+
+static ssize_t
+gzip_write(void* cookie, const char* buf, size_t size)
+{
+    int                n;
+    struct GzipCookie* gc;
+
+    gc = (struct GzipCookie*) cookie;
+    if (size > INT32_MAX) size = INT32_MAX;
+    n = gzwrite(gc->gz, buf, size);
+    gc->pos += n;
+    return n;
+}
+
+static int
+gzip_seek(void* cookie, off64_t* offset, int whence)
+{
+    uint64_t           target;
+    struct GzipCookie* gc;
+
+    gc = (struct GzipCookie*) cookie;
+    if (forward_target(gc->pos, offset, whence, &target) != 0) return -1;
+    if (target == gc->pos) return 0;
+    if (gc->writing) return -1;
+    return skip_forward(cookie, gzip_read, target - gc->pos);
+}
+
+static int
+gzip_close(void* cookie)
+{
+    int                status;
+    struct GzipCookie* gc;
+
+    gc = (struct GzipCookie*) cookie;
+    status = gzclose(gc->gz);
+    free(gc);
+    return status == Z_OK ? 0 : EOF;
+}
+
+static FILE*
+open_gzip(char fname[], char mode[])
+{
+    int                   level;
+    char                  gz_mode[8];
+    FILE*                 f;
+    struct GzipCookie*    gc;
+    cookie_io_functions_t io = {gzip_read, gzip_write, gzip_seek, gzip_close};
+
+    level = active_compression_level();
+    if (mode[0] == 'r' || level < 0)
+    {
+        snprintf(gz_mode, sizeof(gz_mode), "%cb", mode[0]);
+    } else
+    {
+        snprintf(
+            gz_mode,
+            sizeof(gz_mode),
+            "%cb%d",
+            mode[0],
+            level > 9 ? 9 : level);
+    }
+    gc = (struct GzipCookie*) malloc(sizeof(struct GzipCookie));
+    if (gc == NULL) return NULL;
+    gc->gz = gzopen(fname, gz_mode);
+    if (gc->gz == NULL)
+    {
+        free(gc);
+        return NULL;
+    }
+    gzbuffer(gc->gz, COMPRESSED_BUFF_SIZE);
+    gc->writing = mode[0] != 'r';
+    gc->pos = 0;
+    f = fopencookie(gc, gc->writing ? "w" : "r", io);
+    if (f == NULL) gzip_close(gc);
+    return f;
+}
+
+#endif
+
+#ifdef DATAIO_WITH_ZSTD
+
+struct ZstdCookie
+{
+    FILE*         raw;
+    int           writing;
+    uint64_t      pos;
+    ZSTD_DCtx*    dctx;
+    ZSTD_CCtx*    cctx;
+    ZSTD_inBuffer in;
+    char*         buf;
+    size_t        buf_size;
+};
+
+static ssize_t
+zstd_read(void* cookie, char* buf, size_t size)
+{
+    size_t             status;
+    ZSTD_outBuffer     out;
+    struct ZstdCookie* zc;
+
+    zc = (struct ZstdCookie*) cookie;
+    out.dst = buf;
+    out.size = size;
+    out.pos = 0;
+    while (out.pos == 0)
+    {
+        if (zc->in.pos == zc->in.size)
+        {
+            zc->in.size = fread(zc->buf, 1, zc->buf_size, zc->raw);
+            zc->in.pos = 0;
+            if (zc->in.size == 0) break;
+        }
+        status = ZSTD_decompressStream(zc->dctx, &out, &zc->in);
+        if (ZSTD_isError(status)) return -1;
+    }
+    zc->pos += out.pos;
+    return out.pos;
+}
+
+/** Compress input pushing all output produced to the raw file */
+static int
+zstd_push(struct ZstdCookie* zc, ZSTD_inBuffer* in, ZSTD_EndDirective mode)
+{
+    size_t         remaining;
+    ZSTD_outBuffer out;
+
+    do
+    {
+        out.dst = zc->buf;
+        out.size = zc->buf_size;
+        out.pos = 0;
+        remaining = ZSTD_compressStream2(zc->cctx, &out, in, mode);
+        if (ZSTD_isError(remaining)) return -1;
+        if (fwrite(zc->buf, 1, out.pos, zc->raw) != out.pos) return -1;
+    } while (mode == ZSTD_e_end ? remaining > 0 : in->pos < in->size);
+    return 0;
+}
+
+static ssize_t
+zstd_write(void* cookie, const char* buf, size_t size)
+{
+    ZSTD_inBuffer      in;
+    struct ZstdCookie* zc;
+
+    zc = (struct ZstdCookie*) cookie;
+    in.src = buf;
+    in.size = size;
+    in.pos = 0;
+    if (zstd_push(zc, &in, ZSTD_e_continue) != 0) return 0;
+    zc->pos += size;
+    return size;
+}
+
+static int
+zstd_seek(void* cookie, off64_t* offset, int whence)
+{
+    uint64_t           target;
+    struct ZstdCookie* zc;
+
+    zc = (struct ZstdCookie*) cookie;
+    if (forward_target(zc->pos, offset, whence, &target) != 0) return -1;
+    if (target == zc->pos) return 0;
+    if (zc->writing) return -1;
+    return skip_forward(cookie, zstd_read, target - zc->pos);
+}
+
+static int
+zstd_close(void* cookie)
+{
+    int                status;
+    ZSTD_inBuffer      in;
+    struct ZstdCookie* zc;
+
+    zc = (struct ZstdCookie*) cookie;
+    status = 0;
+    if (zc->writing)
+    {
+        in.src = NULL;
+        in.size = 0;
+        in.pos = 0;
+        status = zstd_push(zc, &in, ZSTD_e_end);
+    }
+    if (fclose(zc->raw) != 0) status = -1;
+    ZSTD_freeDCtx(zc->dctx);
+    ZSTD_freeCCtx(zc->cctx);
+    free(zc->buf);
+    free(zc);
+    return status == 0 ? 0 : EOF;
+}
+
+static FILE*
+open_zstd(char fname[], char mode[])
+{
+    int                   level;
+    char                  raw_mode[4];
+    FILE*                 f;
+    struct ZstdCookie*    zc;
+    cookie_io_functions_t io = {zstd_read, zstd_write, zstd_seek, zstd_close};
+
+    snprintf(raw_mode, sizeof(raw_mode), "%cb", mode[0]);
+    zc = (struct ZstdCookie*) calloc(1, sizeof(struct ZstdCookie));
+    if (zc == NULL) return NULL;
+    zc->raw = fopen(fname, raw_mode);
+    if (zc->raw == NULL)
+    {
+        free(zc);
+        return NULL;
+    }
+    zc->writing = mode[0] != 'r';
+    if (zc->writing)
+    {
+        zc->buf_size = ZSTD_CStreamOutSize();
+        zc->cctx = ZSTD_createCCtx();
+        level = active_compression_level();
+        if (zc->cctx != NULL && level >= 0)
+        {
+            ZSTD_CCtx_setParameter(zc->cctx, ZSTD_c_compressionLevel, level);
+        }
+    } else
+    {
+        zc->buf_size = ZSTD_DStreamInSize();
+        zc->dctx = ZSTD_createDCtx();
+    }
+    zc->buf = (char*) malloc(zc->buf_size);
+    if (zc->buf == NULL || (zc->cctx == NULL && zc->dctx == NULL))
+    {
+        zstd_close(zc);
+        return NULL;
+    }
+    f = fopencookie(zc, zc->writing ? "w" : "r", io);
+    if (f == NULL) zstd_close(zc);
+    return f;
+}
+
+#endif
+
+FILE*
+open_compressed(char fname[], char mode[], enum Compression how)
+{
+    if (strchr(mode, '+') != NULL || strchr("rwa", mode[0]) == NULL)
+    {
+        io_error("mode %s not supported for compressed file %s", mode, fname);
+    }
+    switch (how)
+    {
+        case GZIP_COMPRESSION:
+#ifdef DATAIO_WITH_ZLIB
+            return open_gzip(fname, mode);
+#else
+            io_error("built without gzip support for %s", fname);
+#endif
+        case ZSTD_COMPRESSION:
+#ifdef DATAIO_WITH_ZSTD
+            return open_zstd(fname, mode);
+#else
+            io_error("built without zstd support for %s", fname);
+#endif
+        default:
+            return fopen(fname, mode);
+    }
+}
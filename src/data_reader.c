@@ -1,103 +1,371 @@
 #include "file_handle.h"
 #include "data_reader.h"
+#include "format_plan.h"
+#include "line_index.h"
+#include "text_scanner.h"
+#include "io_context.h"
+#include <pthread.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 
 static const unsigned int BUFF_SIZE = 256;
 
+/** Minimum number of bytes worth of a chunk in parallel reading */
+static const size_t MIN_CHUNK_BYTES = 1 << 16;
+
+/** Number of chunks per thread to balance the parsing load */
+static const int CHUNKS_PER_THREAD = 4;
+
+/** Part of file delimited at linebreaks to be parsed by a single thread */
+struct ReadChunk
+{
+    const char* beg;
+    const char* end;
+    int         first_row;
+    int         nlines;
+    int         nvalues;
+    int         bad_row;
+    int         bad_col;
+};
+
+/** Shared state of the threads reading a matrix in parallel */
+struct ParallelRead
+{
+    struct TextScanner sc;
+    int                ncomp;
+    int                nrows;
+    int                ncols;
+    void**             rows;
+    double*            data;
+    int                ld;
+    int                nchunks;
+    struct ReadChunk*  chunks;
+    int                next_count;
+    int                next_parse;
+    pthread_mutex_t    start;
+    pthread_barrier_t  barrier;
+    struct IoContext   settings;
+    int                failed;
+    char               error[IO_ERROR_SIZE];
+    struct MappedFile  mf;
+    pthread_t*         threads;
+    struct IoCleanup   cleanup;
+};
+
+/** File read through a memory map whenever possible */
+struct TextSource
+{
+    struct MappedFile  mf;
+    struct TextScanner sc;
+    struct IoCleanup   cleanup;
+};
+
+/** File visited line by line, through a memory map whenever possible */
+struct LineSource
+{
+    struct MappedFile mf;
+    FILE*             f;
+    char*             line;
+    struct IoCleanup  cleanup;
+};
+
+/** Row-major buffer growing line by line while discovering matrix shape */
+struct MatrixLoad
+{
+    char*              fname;
+    struct TextScanner sc;
+    int                ncomp;
+    int                nrows;
+    int                ncols;
+    size_t             size;
+    size_t             capacity;
+    double*            data;
+};
+
+/** State of reading only some columns of a matrix, one row per line */
+struct ColumnsRead
+{
+    char*              fname;
+    struct TextScanner sc;
+    int                ncomp;
+    int                nrows;
+    int                row;
+    int                nusecols;
+    int*               usecols;
+    int                last_col;
+    char*              wanted;
+    double*            picked;
+    void**             rows;
+    double*            data;
+    int                ld;
+};
+
+static void
+report_array_read_problem(int index, int arr_size, char info[])
+{
+    io_error("Problem reading element %d of %d: %s", index, arr_size, info);
+}
+
+/** Position of `init_line` in mapped file, using line index if available */
+static const char*
+mapped_init_line(char fname[], struct MappedFile* mf, int init_line)
+{
+    int         i, remaining;
+    uint64_t    offset;
+    const char* pos;
+    const char* end;
+
+    end = mf->data + mf->size;
+    if (line_index_seek(fname, init_line, &offset, &remaining)
+        && offset <= mf->size)
+    {
+        pos = mf->data + offset;
+    } else
+    {
+        pos = skip_comment_lines(mf->data, end, CURSOR_POSITION);
+        remaining = init_line - 1;
+    }
+    for (i = 0; i < remaining; i++) pos = skip_next_line(pos, end);
+    return pos;
+}
+
+/** Move file cursor to `init_line`, using line index if available */
+static void
+stream_init_line(char fname[], FILE* f, int init_line)
+{
+    int      i, remaining;
+    uint64_t offset;
+
+    if (!line_index_seek(fname, init_line, &offset, &remaining)
+        || fseek(f, offset, SEEK_SET) != 0)
+    {
+        jump_comment_lines(f, CURSOR_POSITION);
+        remaining = init_line - 1;
+    }
+    for (i = 0; i < remaining; i++) jump_next_line(f);
+}
+
+static void
+release_text_source(void* arg)
+{
+    FILE*              f;
+    struct TextSource* src;
+
+    src = (struct TextSource*) arg;
+    f = src->sc.f;
+    // the file is closed right away, thus unread characters need not be
+    // given back, what in compressed streams would require a backward seek
+    src->sc.pos = src->sc.end;
+    scanner_close(&src->sc);
+    if (f != NULL)
+    {
+        fclose(f);
+    } else
+    {
+        unmap_file(&src->mf);
+    }
+}
+
+/** Set scanner in `init_line` of file, using memory map whenever possible
+ *
+ * The source is released by `close_txt_scanner` or if an error is raised
+ */
+static void
+open_txt_scanner(
+    char               fname[],
+    char               fmt[],
+    int                init_line,
+    struct TextSource* src)
+{
+    const char* pos;
+
+    src->sc.f = NULL;
+    src->sc.fast = 0;
+    if (map_file(fname, &src->mf))
+    {
+        pos = mapped_init_line(fname, &src->mf, init_line);
+        if (scanner_open_memory(
+                &src->sc, pos, src->mf.data + src->mf.size, fmt))
+        {
+            io_cleanup_push(&src->cleanup, release_text_source, src);
+            return;
+        }
+        unmap_file(&src->mf);
+    }
+    src->sc.f = open_file(fname, "r");
+    io_cleanup_push(&src->cleanup, release_text_source, src);
+    stream_init_line(fname, src->sc.f, init_line);
+    scanner_open_owned(&src->sc, src->sc.f, fmt);
+}
+
+static void
+close_txt_scanner(struct TextSource* src)
+{
+    io_cleanup_pop(&src->cleanup, 1);
+}
+
 static void
-report_array_read_problem(FILE* f, int index, int arr_size, char info[])
+release_scanner(void* arg)
 {
-    fclose(f);
-    printf(
-        "\n\nERROR: Problem reading element %d of %d: %s\n\n",
-        index,
-        arr_size,
-        info);
-    exit(EXIT_FAILURE);
+    scanner_close((struct TextScanner*) arg);
 }
 
 void
 carr_txt_read(
     char fname[], char fmt[], int init_line, int arr_size, double complex* arr)
 {
-    int    i, n;
-    double real, imag;
-    FILE*  f;
+    int               i, n;
+    double            values[2];
+    struct TextSource src;
 
-    f = open_file(fname, "r");
-    jump_comment_lines(f, CURSOR_POSITION);
-    while (--init_line > 0) jump_next_line(f);
+    open_txt_scanner(fname, fmt, init_line, &src);
     for (i = 0; i < arr_size; i++)
     {
-        n = fscanf(f, fmt, &real, &imag);
+        n = scanner_read(&src.sc, values);
         if (n != 2)
         {
             char err_info[BUFF_SIZE];
             sprintf(err_info, "Reading complex numbers from %s", fname);
-            report_array_read_problem(f, i, arr_size, err_info);
+            report_array_read_problem(i, arr_size, err_info);
         }
-        arr[i] = real + I * imag;
+        arr[i] = CMPLX(values[0], values[1]);
     }
-    fclose(f);
+    close_txt_scanner(&src);
 }
 
 void
 rarr_txt_read(
     char fname[], char fmt[], int init_line, int arr_size, double* arr)
 {
-    int   i, n;
-    FILE* f;
+    int               i, n;
+    double            values[2];
+    struct TextSource src;
 
-    f = open_file(fname, "r");
-    jump_comment_lines(f, CURSOR_POSITION);
-    while (--init_line > 0) jump_next_line(f);
+    open_txt_scanner(fname, fmt, init_line, &src);
     for (i = 0; i < arr_size; i++)
     {
-        n = fscanf(f, fmt, &arr[i]);
+        n = scanner_read(&src.sc, values);
         if (n != 1)
         {
             char err_info[BUFF_SIZE];
             sprintf(err_info, "Reading float numbers from %s", fname);
-            report_array_read_problem(f, i, arr_size, err_info);
+            report_array_read_problem(i, arr_size, err_info);
         }
+        arr[i] = values[0];
     }
-    fclose(f);
+    close_txt_scanner(&src);
 }
 
 void
 carr_stream_read(FILE* f, char fmt[], int arr_size, double complex* arr)
 {
-    int    i, n;
-    double real, imag;
+    int                i, n;
+    double             values[2];
+    struct TextScanner sc;
+    struct IoCleanup   cleanup;
 
     assert_file_pointer(f, "In function carr_stream_read");
+    scanner_open(&sc, f, fmt);
+    io_cleanup_push(&cleanup, release_scanner, &sc);
     for (i = 0; i < arr_size; i++)
     {
-        n = fscanf(f, fmt, &real, &imag);
+        n = scanner_read(&sc, values);
         if (n != 2)
         {
             char err_info[] = "Reading from file pointer in carr_stream_read";
-            report_array_read_problem(f, i, arr_size, err_info);
+            report_array_read_problem(i, arr_size, err_info);
         }
-        arr[i] = real + I * imag;
+        arr[i] = CMPLX(values[0], values[1]);
     }
+    io_cleanup_pop(&cleanup, 1);
 }
 
 void
 rarr_stream_read(FILE* f, char fmt[], int arr_size, double* arr)
 {
-    int i, n;
+    int                i, n;
+    double             values[2];
+    struct TextScanner sc;
+    struct IoCleanup   cleanup;
 
     assert_file_pointer(f, "In function rarr_stream_read");
+    scanner_open(&sc, f, fmt);
+    io_cleanup_push(&cleanup, release_scanner, &sc);
     for (i = 0; i < arr_size; i++)
     {
-        n = fscanf(f, fmt, &arr[i]);
+        n = scanner_read(&sc, values);
         if (n != 1)
         {
             char err_info[] = "Reading from file pointer in rarr_stream_read";
-            report_array_read_problem(f, i, arr_size, err_info);
+            report_array_read_problem(i, arr_size, err_info);
+        }
+        arr[i] = values[0];
+    }
+    io_cleanup_pop(&cleanup, 1);
+}
+
+/** Row `i` of matrix by row pointers or contiguous storage of `ld` columns
+ *
+ * Elements are made of `ncomp` doubles, 1 for real and 2 for complex
+ */
+static double*
+mat_row(void** rows, double* data, int ld, int ncomp, int i)
+{
+    if (rows != NULL) return (double*) rows[i];
+    return data + (size_t) i * ld * ncomp;
+}
+
+/** Read matrix with `ncomp` doubles per element */
+static void
+mat_txt_read(
+    char    fname[],
+    char    fmt[],
+    int     init_line,
+    int     nrows,
+    int     ncols,
+    int     ncomp,
+    void**  rows,
+    double* data,
+    int     ld)
+{
+    int               i, j, c, n;
+    double            values[2];
+    double*           dest;
+    struct TextSource src;
+
+    open_txt_scanner(fname, fmt, init_line, &src);
+    for (i = 0; i < nrows; i++)
+    {
+        dest = mat_row(rows, data, ld, ncomp, i);
+        for (j = 0; j < ncols; j++)
+        {
+            n = scanner_read(&src.sc, values);
+            if (n != ncomp)
+            {
+                char err_info[BUFF_SIZE];
+                if (ncomp == 2)
+                {
+                    sprintf(
+                        err_info,
+                        "Reading row %d and col %d of complex matrix",
+                        i + 1,
+                        j + 1);
+                } else
+                {
+                    sprintf(
+                        err_info,
+                        "Reading row %d col %d of real matrix",
+                        i + 1,
+                        j + 1);
+                }
+                report_array_read_problem(
+                    i * ncols + j, nrows * ncols, err_info);
+            }
+            for (c = 0; c < ncomp; c++) dest[j * ncomp + c] = values[c];
         }
     }
+    close_txt_scanner(&src);
 }
 
 void
@@ -109,62 +377,907 @@ cmat_txt_read(
     int    ncols,
     double complex** mat)
 {
-    int    i, j, n;
-    double real, imag;
-    FILE*  f;
+    mat_txt_read(
+        fname, fmt, init_line, nrows, ncols, 2, (void**) mat, NULL, 0);
+}
 
-    f = open_file(fname, "r");
-    jump_comment_lines(f, CURSOR_POSITION);
-    while (--init_line > 0) jump_next_line(f);
-    for (i = 0; i < nrows; i++)
+void
+rmat_txt_read(
+    char fname[], char fmt[], int init_line, int nrows, int ncols, double** mat)
+{
+    mat_txt_read(
+        fname, fmt, init_line, nrows, ncols, 1, (void**) mat, NULL, 0);
+}
+
+void
+crowmajor_txt_read(
+    char            fname[],
+    char            fmt[],
+    int             init_line,
+    int             nrows,
+    int             ncols,
+    int             ld,
+    double complex* mat)
+{
+    mat_txt_read(
+        fname, fmt, init_line, nrows, ncols, 2, NULL, (double*) mat, ld);
+}
+
+void
+rrowmajor_txt_read(
+    char    fname[],
+    char    fmt[],
+    int     init_line,
+    int     nrows,
+    int     ncols,
+    int     ld,
+    double* mat)
+{
+    mat_txt_read(fname, fmt, init_line, nrows, ncols, 1, NULL, mat, ld);
+}
+
+static int
+is_blank(const char* beg, const char* end)
+{
+    for (; beg < end; beg++)
     {
-        for (j = 0; j < ncols; j++)
+        if (*beg != ' ' && (*beg < '\t' || *beg > '\r')) return 0;
+    }
+    return 1;
+}
+
+static int
+count_data_lines(const char* pos, const char* end)
+{
+    int         nlines;
+    const char* line_end;
+
+    nlines = 0;
+    while (pos < end)
+    {
+        line_end = memchr(pos, '\n', end - pos);
+        if (line_end == NULL) line_end = end;
+        if (!is_blank(pos, line_end)) nlines++;
+        pos = line_end + 1;
+    }
+    return nlines;
+}
+
+static void
+parse_chunk(struct ParallelRead* job, struct ReadChunk* chunk)
+{
+    int                j, c, row;
+    double             values[2];
+    double*            dest;
+    const char*        pos;
+    const char*        line_end;
+    struct TextScanner sc;
+
+    row = chunk->first_row;
+    pos = chunk->beg;
+    while (pos < chunk->end && row < job->nrows)
+    {
+        line_end = memchr(pos, '\n', chunk->end - pos);
+        if (line_end == NULL) line_end = chunk->end;
+        if (!is_blank(pos, line_end))
         {
-            n = fscanf(f, fmt, &real, &imag);
-            if (n != 2)
+            sc = job->sc;
+            sc.pos = (char*) pos;
+            sc.end = (char*) line_end;
+            dest = mat_row(job->rows, job->data, job->ld, job->ncomp, row);
+            for (j = 0; j < job->ncols; j++)
             {
-                char err_info[BUFF_SIZE];
-                sprintf(
-                    err_info,
-                    "Reading row %d and col %d of complex matrix",
-                    i + 1,
-                    j + 1);
-                report_array_read_problem(
-                    f, i * ncols + j, nrows * ncols, err_info);
+                if (scanner_read(&sc, values) != job->ncomp)
+                {
+                    chunk->bad_row = row;
+                    chunk->bad_col = j;
+                    return;
+                }
+                for (c = 0; c < job->ncomp; c++)
+                {
+                    dest[j * job->ncomp + c] = values[c];
+                }
+                chunk->nvalues++;
+            }
+            if (!is_blank(sc.pos, line_end))
+            {
+                chunk->bad_row = row;
+                chunk->bad_col = job->ncols;
+                return;
             }
-            mat[i][j] = real + I * imag;
+            row++;
         }
+        pos = line_end + 1;
     }
-    fclose(f);
+}
+
+/** Parse chunks until none is left, raising errors with `io_error` */
+static void
+parse_chunks(void* arg)
+{
+    int                  k;
+    struct ParallelRead* job;
+
+    job = (struct ParallelRead*) arg;
+    while ((k = __atomic_fetch_add(&job->next_parse, 1, __ATOMIC_RELAXED))
+           < job->nchunks)
+    {
+        parse_chunk(job, &job->chunks[k]);
+    }
+}
+
+static void*
+parallel_read_worker(void* arg)
+{
+    int                  k, first_row;
+    struct IoContext     ctx;
+    struct ParallelRead* job;
+
+    job = (struct ParallelRead*) arg;
+    // the barrier is only sized once all threads that could start did
+    pthread_mutex_lock(&job->start);
+    pthread_mutex_unlock(&job->start);
+    while ((k = __atomic_fetch_add(&job->next_count, 1, __ATOMIC_RELAXED))
+           < job->nchunks)
+    {
+        job->chunks[k].nlines =
+            count_data_lines(job->chunks[k].beg, job->chunks[k].end);
+    }
+    if (pthread_barrier_wait(&job->barrier) == PTHREAD_BARRIER_SERIAL_THREAD)
+    {
+        first_row = 0;
+        for (k = 0; k < job->nchunks; k++)
+        {
+            job->chunks[k].first_row = first_row;
+            first_row += job->chunks[k].nlines;
+        }
+    }
+    pthread_barrier_wait(&job->barrier);
+    // errors are raised again by the calling thread after all are done
+    ctx = job->settings;
+    if (io_context_run(&ctx, parse_chunks, job) != 0)
+    {
+        __atomic_store_n(&job->next_parse, job->nchunks, __ATOMIC_RELAXED);
+        if (__atomic_exchange_n(&job->failed, 1, __ATOMIC_ACQ_REL) == 0)
+        {
+            memcpy(job->error, ctx.error, IO_ERROR_SIZE);
+        }
+    }
+    return NULL;
+}
+
+/** Check all chunks produced the expected number of values */
+static void
+check_parallel_read(struct ParallelRead* job, char fname[])
+{
+    int               k, nexpected, nlines;
+    char              err_info[BUFF_SIZE];
+    struct ReadChunk* chunk;
+
+    nlines = 0;
+    for (k = 0; k < job->nchunks; k++)
+    {
+        chunk = &job->chunks[k];
+        nlines += chunk->nlines;
+        nexpected = job->nrows - chunk->first_row;
+        if (nexpected > chunk->nlines) nexpected = chunk->nlines;
+        if (nexpected < 0) nexpected = 0;
+        nexpected *= job->ncols;
+        if (chunk->nvalues == nexpected) continue;
+        if (chunk->bad_col < job->ncols)
+        {
+            sprintf(
+                err_info,
+                "Reading row %d col %d of matrix in parallel from %s",
+                chunk->bad_row + 1,
+                chunk->bad_col + 1,
+                fname);
+        } else
+        {
+            sprintf(
+                err_info,
+                "More than %d values in row %d of %s",
+                job->ncols,
+                chunk->bad_row + 1,
+                fname);
+        }
+        report_array_read_problem(
+            chunk->first_row * job->ncols + chunk->nvalues,
+            job->nrows * job->ncols,
+            err_info);
+    }
+    if (nlines < job->nrows)
+    {
+        sprintf(err_info, "Only %d rows found in %s", nlines, fname);
+        report_array_read_problem(
+            nlines * job->ncols, job->nrows * job->ncols, err_info);
+    }
+}
+
+static void
+release_parallel_read(void* arg)
+{
+    struct ParallelRead* job;
+
+    job = (struct ParallelRead*) arg;
+    free(job->threads);
+    free(job->chunks);
+    unmap_file(&job->mf);
+}
+
+/** Read matrix in parallel returning 0 if the serial reading must be used */
+static int
+mat_txt_read_parallel(
+    char    fname[],
+    char    fmt[],
+    int     init_line,
+    int     nrows,
+    int     ncols,
+    int     ncomp,
+    void**  rows,
+    double* data,
+    int     ld,
+    int     nthreads)
+{
+    int                 i, k;
+    size_t              len;
+    const char*         pos;
+    const char*         end;
+    struct ParallelRead job;
+
+    if (!map_file(fname, &job.mf)) return 0;
+    end = job.mf.data + job.mf.size;
+    pos = mapped_init_line(fname, &job.mf, init_line);
+    if (!scanner_open_memory(&job.sc, pos, end, fmt))
+    {
+        unmap_file(&job.mf);
+        return 0;
+    }
+
+    if (nthreads <= 0) nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (nthreads <= 0) nthreads = 1;
+    len = end - pos;
+    job.nchunks = nthreads * CHUNKS_PER_THREAD;
+    if ((size_t) job.nchunks > len / MIN_CHUNK_BYTES + 1)
+    {
+        job.nchunks = len / MIN_CHUNK_BYTES + 1;
+    }
+    if (nthreads > job.nchunks) nthreads = job.nchunks;
+    job.ncomp = ncomp;
+    job.nrows = nrows;
+    job.ncols = ncols;
+    job.rows = rows;
+    job.data = data;
+    job.ld = ld;
+    job.next_count = 0;
+    job.next_parse = 0;
+    job.failed = 0;
+    io_context_inherit(&job.settings);
+    job.chunks = (struct ReadChunk*) malloc(job.nchunks * sizeof(*job.chunks));
+    job.threads = (pthread_t*) malloc(nthreads * sizeof(pthread_t));
+    io_cleanup_push(&job.cleanup, release_parallel_read, &job);
+    if (job.chunks == NULL || job.threads == NULL)
+    {
+        io_error("no memory to read %s in parallel", fname);
+    }
+    for (k = 0; k < job.nchunks; k++)
+    {
+        job.chunks[k].beg = pos;
+        if (k > 0)
+        {
+            job.chunks[k].beg =
+                skip_next_line(pos + k * (len / job.nchunks) - 1, end);
+            if (job.chunks[k].beg < job.chunks[k - 1].beg)
+            {
+                job.chunks[k].beg = job.chunks[k - 1].beg;
+            }
+            job.chunks[k - 1].end = job.chunks[k].beg;
+        }
+        job.chunks[k].nvalues = 0;
+        job.chunks[k].bad_row = -1;
+        job.chunks[k].bad_col = -1;
+    }
+    job.chunks[job.nchunks - 1].end = end;
+
+    pthread_mutex_init(&job.start, NULL);
+    pthread_mutex_lock(&job.start);
+    for (i = 1; i < nthreads; i++)
+    {
+        // with fewer threads the chunks are just parsed by the others
+        if (pthread_create(
+                &job.threads[i], NULL, parallel_read_worker, &job)
+            != 0)
+        {
+            break;
+        }
+    }
+    nthreads = i;
+    pthread_barrier_init(&job.barrier, NULL, nthreads);
+    pthread_mutex_unlock(&job.start);
+    parallel_read_worker(&job);
+    for (i = 1; i < nthreads; i++) pthread_join(job.threads[i], NULL);
+    pthread_barrier_destroy(&job.barrier);
+    pthread_mutex_destroy(&job.start);
+
+    if (job.failed) io_error("%s", job.error);
+    check_parallel_read(&job, fname);
+    io_cleanup_pop(&job.cleanup, 1);
+    return 1;
 }
 
 void
-rmat_txt_read(
-    char fname[], char fmt[], int init_line, int nrows, int ncols, double** mat)
+cmat_txt_read_parallel(
+    char             fname[],
+    char             fmt[],
+    int              init_line,
+    int              nrows,
+    int              ncols,
+    double complex** mat,
+    int              nthreads)
 {
-    int   i, j, n;
-    FILE* f;
+    if (mat_txt_read_parallel(
+            fname,
+            fmt,
+            init_line,
+            nrows,
+            ncols,
+            2,
+            (void**) mat,
+            NULL,
+            0,
+            nthreads))
+    {
+        return;
+    }
+    cmat_txt_read(fname, fmt, init_line, nrows, ncols, mat);
+}
 
-    f = open_file(fname, "r");
-    jump_comment_lines(f, CURSOR_POSITION);
-    while (--init_line > 0) jump_next_line(f);
-    for (i = 0; i < nrows; i++)
+void
+rmat_txt_read_parallel(
+    char     fname[],
+    char     fmt[],
+    int      init_line,
+    int      nrows,
+    int      ncols,
+    double** mat,
+    int      nthreads)
+{
+    if (mat_txt_read_parallel(
+            fname,
+            fmt,
+            init_line,
+            nrows,
+            ncols,
+            1,
+            (void**) mat,
+            NULL,
+            0,
+            nthreads))
     {
-        for (j = 0; j < ncols; j++)
+        return;
+    }
+    rmat_txt_read(fname, fmt, init_line, nrows, ncols, mat);
+}
+
+void
+crowmajor_txt_read_parallel(
+    char            fname[],
+    char            fmt[],
+    int             init_line,
+    int             nrows,
+    int             ncols,
+    int             ld,
+    double complex* mat,
+    int             nthreads)
+{
+    if (mat_txt_read_parallel(
+            fname,
+            fmt,
+            init_line,
+            nrows,
+            ncols,
+            2,
+            NULL,
+            (double*) mat,
+            ld,
+            nthreads))
+    {
+        return;
+    }
+    crowmajor_txt_read(fname, fmt, init_line, nrows, ncols, ld, mat);
+}
+
+void
+rrowmajor_txt_read_parallel(
+    char    fname[],
+    char    fmt[],
+    int     init_line,
+    int     nrows,
+    int     ncols,
+    int     ld,
+    double* mat,
+    int     nthreads)
+{
+    if (mat_txt_read_parallel(
+            fname, fmt, init_line, nrows, ncols, 1, NULL, mat, ld, nthreads))
+    {
+        return;
+    }
+    rrowmajor_txt_read(fname, fmt, init_line, nrows, ncols, ld, mat);
+}
+
+static void
+release_line_source(void* arg)
+{
+    struct LineSource* src;
+
+    src = (struct LineSource*) arg;
+    free(src->line);
+    if (src->f != NULL) fclose(src->f);
+    unmap_file(&src->mf);
+}
+
+/** Call `process` for every line from `init_line` until it returns 0
+ *
+ * The file is released even if `process` raises an error
+ */
+static void
+for_each_line(
+    char fname[],
+    int  init_line,
+    int (*process)(void*, const char*, const char*),
+    void* state)
+{
+    ssize_t           len;
+    size_t            line_capacity;
+    const char*       pos;
+    const char*       end;
+    const char*       line_end;
+    struct LineSource src;
+
+    src.f = NULL;
+    src.line = NULL;
+    if (map_file(fname, &src.mf))
+    {
+        io_cleanup_push(&src.cleanup, release_line_source, &src);
+        end = src.mf.data + src.mf.size;
+        pos = mapped_init_line(fname, &src.mf, init_line);
+        while (pos < end)
+        {
+            line_end = memchr(pos, '\n', end - pos);
+            if (line_end == NULL) line_end = end;
+            if (!process(state, pos, line_end)) break;
+            pos = line_end + 1;
+        }
+        io_cleanup_pop(&src.cleanup, 1);
+        return;
+    }
+    src.f = open_file(fname, "r");
+    io_cleanup_push(&src.cleanup, release_line_source, &src);
+    stream_init_line(fname, src.f, init_line);
+    line_capacity = 0;
+    while ((len = getline(&src.line, &line_capacity, src.f)) > 0)
+    {
+        if (!process(state, src.line, src.line + len)) break;
+    }
+    io_cleanup_pop(&src.cleanup, 1);
+}
+
+static void
+report_load_problem(struct MatrixLoad* load, char info[])
+{
+    io_error("Problem loading %s: %s", load->fname, info);
+}
+
+static void
+release_matrix_load(void* arg)
+{
+    free(((struct MatrixLoad*) arg)->data);
+}
+
+static int
+load_line(void* state, const char* beg, const char* end)
+{
+    struct MatrixLoad* load;
+    int                c, ncols;
+    double             values[2];
+    double*            grown;
+    char               err_info[BUFF_SIZE];
+    struct TextScanner sc;
+
+    load = (struct MatrixLoad*) state;
+    if (is_blank(beg, end)) return 1;
+    sc = load->sc;
+    sc.pos = (char*) beg;
+    sc.end = (char*) end;
+    ncols = 0;
+    while (!is_blank(sc.pos, end))
+    {
+        if (scanner_read(&sc, values) != load->ncomp)
+        {
+            sprintf(
+                err_info, "Reading row %d col %d", load->nrows + 1, ncols + 1);
+            report_load_problem(load, err_info);
+        }
+        if (load->size + load->ncomp > load->capacity)
+        {
+            load->capacity = 2 * load->capacity + 1024;
+            grown = (double*) realloc(
+                load->data, load->capacity * sizeof(double));
+            if (grown == NULL)
+            {
+                io_error("no memory to load %s", load->fname);
+            }
+            load->data = grown;
+        }
+        for (c = 0; c < load->ncomp; c++) load->data[load->size++] = values[c];
+        ncols++;
+    }
+    if (load->nrows > 0 && ncols != load->ncols)
+    {
+        sprintf(
+            err_info,
+            "Row %d has %d columns but previous rows have %d",
+            load->nrows + 1,
+            ncols,
+            load->ncols);
+        report_load_problem(load, err_info);
+    }
+    load->ncols = ncols;
+    load->nrows++;
+    return 1;
+}
+
+/** Load matrix of unknown shape in a row-major array of doubles */
+static double*
+mat_load(
+    char fname[], char fmt[], int init_line, int ncomp, int* nrows, int* ncols)
+{
+    struct MatrixLoad load;
+    struct IoCleanup  cleanup;
+    double*           shrunk;
+
+    load.fname = fname;
+    load.ncomp = ncomp;
+    load.nrows = 0;
+    load.ncols = 0;
+    load.size = 0;
+    load.capacity = 0;
+    load.data = NULL;
+    io_cleanup_push(&cleanup, release_matrix_load, &load);
+    if (!scanner_open_memory(&load.sc, NULL, NULL, fmt))
+    {
+        char err_info[BUFF_SIZE];
+        sprintf(
+            err_info, "Unsupported formatter \"%.64s\"", format_source(fmt));
+        report_load_problem(&load, err_info);
+    }
+
+    for_each_line(fname, init_line, load_line, &load);
+    io_cleanup_pop(&cleanup, 0);
+
+    *nrows = load.nrows;
+    *ncols = load.ncols;
+    if (load.size == 0) return NULL;
+    // trimming spare capacity is optional, keep the data if it fails
+    shrunk = (double*) realloc(load.data, load.size * sizeof(double));
+    return shrunk != NULL ? shrunk : load.data;
+}
+
+double complex*
+cmat_load(char fname[], char fmt[], int init_line, int* nrows, int* ncols)
+{
+    return (double complex*) mat_load(fname, fmt, init_line, 2, nrows, ncols);
+}
+
+double*
+rmat_load(char fname[], char fmt[], int init_line, int* nrows, int* ncols)
+{
+    return mat_load(fname, fmt, init_line, 1, nrows, ncols);
+}
+
+static void
+report_columns_problem(struct ColumnsRead* cols, int col, char info[])
+{
+    char err_info[BUFF_SIZE];
+
+    snprintf(
+        err_info,
+        BUFF_SIZE,
+        "%s row %d col %d from %s",
+        info,
+        cols->row + 1,
+        col + 1,
+        cols->fname);
+    report_array_read_problem(
+        cols->row * cols->nusecols,
+        cols->nrows * cols->nusecols,
+        err_info);
+}
+
+static void
+release_columns_read(void* arg)
+{
+    struct ColumnsRead* cols;
+
+    cols = (struct ColumnsRead*) arg;
+    free(cols->wanted);
+    free(cols->picked);
+}
+
+static int
+columns_line(void* state, const char* beg, const char* end)
+{
+    int                 j, k, c;
+    double*             dest;
+    struct ColumnsRead* cols;
+    struct TextScanner  sc;
+
+    cols = (struct ColumnsRead*) state;
+    if (cols->row == cols->nrows) return 0;
+    if (is_blank(beg, end)) return 1;
+    sc = cols->sc;
+    sc.pos = (char*) beg;
+    sc.end = (char*) end;
+    // columns after the last one requested are not even tokenized
+    for (j = 0; j <= cols->last_col; j++)
+    {
+        if (!cols->wanted[j])
         {
-            n = fscanf(f, fmt, &mat[i][j]);
-            if (n != 1)
+            if (scanner_skip(&sc) != cols->ncomp)
+            {
+                report_columns_problem(cols, j, "Skipping");
+            }
+            continue;
+        }
+        if (scanner_read(&sc, &cols->picked[j * cols->ncomp]) != cols->ncomp)
+        {
+            report_columns_problem(cols, j, "Reading");
+        }
+    }
+    dest = mat_row(cols->rows, cols->data, cols->ld, cols->ncomp, cols->row);
+    for (k = 0; k < cols->nusecols; k++)
+    {
+        for (c = 0; c < cols->ncomp; c++)
+        {
+            dest[k * cols->ncomp + c] =
+                cols->picked[cols->usecols[k] * cols->ncomp + c];
+        }
+    }
+    cols->row++;
+    return 1;
+}
+
+/** Read selected columns of matrix with `ncomp` doubles per element */
+static void
+mat_txt_read_cols(
+    char    fname[],
+    char    fmt[],
+    int     init_line,
+    int     nrows,
+    int     nusecols,
+    int     usecols[],
+    int     ncomp,
+    void**  rows,
+    double* data,
+    int     ld)
+{
+    int                k;
+    char               err_info[BUFF_SIZE];
+    struct ColumnsRead cols;
+    struct IoCleanup   cleanup;
+
+    cols.fname = fname;
+    cols.ncomp = ncomp;
+    cols.nrows = nrows;
+    cols.row = 0;
+    cols.nusecols = nusecols;
+    cols.usecols = usecols;
+    cols.rows = rows;
+    cols.data = data;
+    cols.ld = ld;
+    cols.last_col = -1;
+    for (k = 0; k < nusecols; k++)
+    {
+        if (usecols[k] < 0)
+        {
+            sprintf(err_info, "Invalid column %d requested", usecols[k]);
+            report_array_read_problem(k, nusecols, err_info);
+        }
+        if (usecols[k] > cols.last_col) cols.last_col = usecols[k];
+    }
+    if (!scanner_open_memory(&cols.sc, NULL, NULL, fmt))
+    {
+        sprintf(
+            err_info, "Unsupported formatter \"%.64s\"", format_source(fmt));
+        report_array_read_problem(0, nrows * nusecols, err_info);
+    }
+    cols.wanted = (char*) calloc(cols.last_col + 1, sizeof(char));
+    cols.picked =
+        (double*) malloc((cols.last_col + 1) * ncomp * sizeof(double));
+    io_cleanup_push(&cleanup, release_columns_read, &cols);
+    if (cols.wanted == NULL || cols.picked == NULL)
+    {
+        io_error("no memory to read columns of %s", fname);
+    }
+    for (k = 0; k < nusecols; k++) cols.wanted[usecols[k]] = 1;
+
+    for_each_line(fname, init_line, columns_line, &cols);
+    io_cleanup_pop(&cleanup, 1);
+
+    if (cols.row < nrows)
+    {
+        sprintf(err_info, "Only %d rows found in %s", cols.row, fname);
+        report_array_read_problem(
+            cols.row * nusecols, nrows * nusecols, err_info);
+    }
+}
+
+void
+cmat_txt_read_cols(
+    char   fname[],
+    char   fmt[],
+    int    init_line,
+    int    nrows,
+    int    nusecols,
+    int    usecols[],
+    double complex** mat)
+{
+    mat_txt_read_cols(
+        fname,
+        fmt,
+        init_line,
+        nrows,
+        nusecols,
+        usecols,
+        2,
+        (void**) mat,
+        NULL,
+        0);
+}
+
+void
+rmat_txt_read_cols(
+    char     fname[],
+    char     fmt[],
+    int      init_line,
+    int      nrows,
+    int      nusecols,
+    int      usecols[],
+    double** mat)
+{
+    mat_txt_read_cols(
+        fname,
+        fmt,
+        init_line,
+        nrows,
+        nusecols,
+        usecols,
+        1,
+        (void**) mat,
+        NULL,
+        0);
+}
+
+void
+crowmajor_txt_read_cols(
+    char            fname[],
+    char            fmt[],
+    int             init_line,
+    int             nrows,
+    int             nusecols,
+    int             usecols[],
+    int             ld,
+    double complex* mat)
+{
+    mat_txt_read_cols(
+        fname,
+        fmt,
+        init_line,
+        nrows,
+        nusecols,
+        usecols,
+        2,
+        NULL,
+        (double*) mat,
+        ld);
+}
+
+void
+rrowmajor_txt_read_cols(
+    char    fname[],
+    char    fmt[],
+    int     init_line,
+    int     nrows,
+    int     nusecols,
+    int     usecols[],
+    int     ld,
+    double* mat)
+{
+    mat_txt_read_cols(
+        fname, fmt, init_line, nrows, nusecols, usecols, 1, NULL, mat, ld);
+}
+
+static void
+release_block_reader(void* arg)
+{
+    block_reader_close((struct BlockReader*) arg);
+}
+
+void
+block_reader_open(
+    struct BlockReader* r, char fname[], char fmt[], int init_line, int ncols)
+{
+    struct IoCleanup cleanup;
+
+    r->fname = fname;
+    r->ncols = ncols;
+    r->rows_read = 0;
+    r->sc.fast = 0;
+    r->f = open_file(fname, "r");
+    io_cleanup_push(&cleanup, release_block_reader, r);
+    stream_init_line(fname, r->f, init_line);
+    scanner_open_owned(&r->sc, r->f, fmt);
+    io_cleanup_pop(&cleanup, 0);
+}
+
+/** Read block of rows with `ncomp` doubles per element */
+static int
+mat_next_block(struct BlockReader* r, int max_rows, int ncomp, double* block)
+{
+    int              i, j, c;
+    double           values[2];
+    struct IoCleanup cleanup;
+
+    io_cleanup_push(&cleanup, release_block_reader, r);
+    for (i = 0; i < max_rows; i++)
+    {
+        if (scanner_at_end(&r->sc)) break;
+        for (j = 0; j < r->ncols; j++)
+        {
+            if (scanner_read(&r->sc, values) != ncomp)
             {
                 char err_info[BUFF_SIZE];
                 sprintf(
                     err_info,
-                    "Reading row %d col %d of real matrix",
-                    i + 1,
-                    j + 1);
+                    "Reading row %d col %d in block from %s",
+                    r->rows_read + 1,
+                    j + 1,
+                    r->fname);
                 report_array_read_problem(
-                    f, i * ncols + j, nrows * ncols, err_info);
+                    r->rows_read * r->ncols + j,
+                    (r->rows_read + 1) * r->ncols,
+                    err_info);
+            }
+            for (c = 0; c < ncomp; c++)
+            {
+                block[(i * r->ncols + j) * ncomp + c] = values[c];
             }
         }
+        r->rows_read++;
     }
-    fclose(f);
+    io_cleanup_pop(&cleanup, 0);
+    return i;
+}
+
+int
+cmat_next_block(struct BlockReader* r, int max_rows, double complex* block)
+{
+    return mat_next_block(r, max_rows, 2, (double*) block);
+}
+
+int
+rmat_next_block(struct BlockReader* r, int max_rows, double* block)
+{
+    return mat_next_block(r, max_rows, 1, block);
+}
+
+void
+block_reader_close(struct BlockReader* r)
+{
+    if (r->f == NULL) return;
+    r->sc.pos = r->sc.end;
+    scanner_close(&r->sc);
+    fclose(r->f);
+    r->f = NULL;
 }
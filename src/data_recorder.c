@@ -1,6 +1,148 @@
 #include "data_recorder.h"
 #include "file_handle.h"
+#include "text_printer.h"
+#include "io_context.h"
+#include <pthread.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/** Number of rows and columns of tiles copied to transposed staging */
+static const int TRANSPOSE_TILE = 8;
+
+/** Size in bytes of the staging buffer of transposed rows if possible */
+static const size_t TRANSPOSE_STAGE_BYTES = 1 << 22;
+
+/** Number of values formatted by a thread in each chunk of rows */
+static const int PARALLEL_CHUNK_VALUES = 1 << 15;
+
+/** Maximum number of formatted chunks per thread waiting to be written */
+static const int CHUNKS_PER_THREAD = 2;
+
+/** Rows formatted by a single thread in a memory printer */
+struct WriteChunk
+{
+    struct TextPrinter pr;
+    int                ready;
+};
+
+/** Shared state of the threads formatting a matrix in parallel
+ *
+ * Chunks are claimed in order, and a chunk is only claimed if less than
+ * `window` chunks are formatted and not yet written, bounding memory
+ */
+struct ParallelWrite
+{
+    char*              fmt;
+    int                ncomp;
+    int                nrows;
+    int                ncols;
+    void**             rows;
+    double*            data;
+    ptrdiff_t          row_stride;
+    ptrdiff_t          col_stride;
+    int                rows_per_chunk;
+    int                nchunks;
+    int                window;
+    int                next_chunk;
+    int                nwritten;
+    int                aborted;
+    char               error[IO_ERROR_SIZE];
+    struct IoContext   settings;
+    FILE*              f;
+    pthread_t*         threads;
+    int                nthreads;
+    struct WriteChunk* chunks;
+    pthread_mutex_t    lock;
+    pthread_cond_t     changed;
+    struct IoCleanup   cleanup;
+};
+
+static void
+crecord_values(struct TextPrinter* pr, int arr_size, double complex* arr)
+{
+    double values[2];
+    for (int j = 0; j < arr_size; j++)
+    {
+        values[0] = creal(arr[j]);
+        values[1] = cimag(arr[j]);
+        printer_write(pr, values);
+    }
+}
+
+static void
+rrecord_values(struct TextPrinter* pr, int arr_size, double* arr)
+{
+    double values[2];
+    values[1] = 0;
+    for (int j = 0; j < arr_size; j++)
+    {
+        values[0] = arr[j];
+        printer_write(pr, values);
+    }
+}
+
+static void
+release_printer(void* arg)
+{
+    printer_discard((struct TextPrinter*) arg);
+}
+
+static void
+release_record(void* arg)
+{
+    release_printer(arg);
+    fclose(((struct TextPrinter*) arg)->f);
+}
+
+static void
+close_file(void* arg)
+{
+    fclose((FILE*) arg);
+}
+
+/** Open printer on stream of the caller, released if an error is raised */
+static void
+stream_open(struct TextPrinter* pr, FILE* f, char fmt[])
+{
+    pr->buf = NULL;
+    io_cleanup_push(&pr->cleanup, release_printer, pr);
+    printer_open(pr, f, fmt);
+}
+
+/** Flush and release printer opened by `stream_open` */
+static void
+stream_close(struct TextPrinter* pr)
+{
+    printer_close(pr);
+    io_cleanup_pop(&pr->cleanup, 1);
+}
+
+/** Open file and printer to record with formatter `fmt`
+ *
+ * Both are released by `record_close` or if an error is raised
+ */
+static void
+record_open(struct TextPrinter* pr, char fname[], char mode[], char fmt[])
+{
+    pr->f = open_file(fname, mode);
+    pr->buf = NULL;
+    io_cleanup_push(&pr->cleanup, release_record, pr);
+    printer_open_owned(pr, pr->f, fmt);
+}
+
+/** Flush printer and close the file opened by `record_open` */
+static void
+record_close(struct TextPrinter* pr)
+{
+    printer_close(pr);
+    io_cleanup_pop(&pr->cleanup, 1);
+}
 
 void
 carr_stream_record(
@@ -11,13 +153,13 @@ carr_stream_record(
     int               arr_size,
     double complex*   arr)
 {
+    struct TextPrinter pr;
     assert_file_pointer(f, "carr_inline routine");
-    if (in_newline) fprintf(f, "\n");
-    for (int j = 0; j < arr_size; j++)
-    {
-        fprintf(f, fmt, creal(arr[j]), cimag(arr[j]));
-    }
-    if (add_linebreak) fprintf(f, "\n");
+    stream_open(&pr, f, fmt);
+    if (in_newline) printer_text(&pr, "\n");
+    crecord_values(&pr, arr_size, arr);
+    if (add_linebreak) printer_text(&pr, "\n");
+    stream_close(&pr);
 }
 
 void
@@ -29,314 +171,1638 @@ rarr_stream_record(
     int               arr_size,
     double*           arr)
 {
+    struct TextPrinter pr;
     assert_file_pointer(f, "rarr_inline routine");
-    if (in_newline) fprintf(f, "\n");
-    for (int j = 0; j < arr_size; j++) fprintf(f, fmt, arr[j]);
-    if (add_linebreak) fprintf(f, "\n");
+    stream_open(&pr, f, fmt);
+    if (in_newline) printer_text(&pr, "\n");
+    rrecord_values(&pr, arr_size, arr);
+    if (add_linebreak) printer_text(&pr, "\n");
+    stream_close(&pr);
 }
 
 void
 carr_column_txt(char fname[], char fmt[], int arr_size, double complex* arr)
 {
-    FILE*  f;
-    double real, imag;
-    f = open_file(fname, "w");
+    struct TextPrinter pr;
+    record_open(&pr, fname, "w", fmt);
     for (int j = 0; j < arr_size; j++)
     {
-        real = creal(arr[j]);
-        imag = cimag(arr[j]);
-        fprintf(f, fmt, real, imag);
-        fprintf(f, "\n");
+        crecord_values(&pr, 1, &arr[j]);
+        printer_text(&pr, "\n");
     }
-    fclose(f);
+    record_close(&pr);
 }
 
 void
 rarr_column_txt(char fname[], char fmt[], int arr_size, double* arr)
 {
-    FILE* f;
-    f = open_file(fname, "w");
+    struct TextPrinter pr;
+    record_open(&pr, fname, "w", fmt);
     for (int j = 0; j < arr_size; j++)
     {
-        fprintf(f, fmt, arr[j]);
-        fprintf(f, "\n");
+        rrecord_values(&pr, 1, &arr[j]);
+        printer_text(&pr, "\n");
     }
-    fclose(f);
+    record_close(&pr);
 }
 
-void
-cmat_txt(char fname[], char fmt[], int nrows, int ncols, double complex** mat)
+/** Record values of complex array `stride` positions apart */
+static void
+crecord_strided(
+    struct TextPrinter* pr, int arr_size, ptrdiff_t stride, double complex* arr)
+{
+    double values[2];
+    if (stride == 1)
+    {
+        crecord_values(pr, arr_size, arr);
+        return;
+    }
+    for (int j = 0; j < arr_size; j++)
+    {
+        values[0] = creal(arr[j * stride]);
+        values[1] = cimag(arr[j * stride]);
+        printer_write(pr, values);
+    }
+}
+
+/** Record values of real array `stride` positions apart */
+static void
+rrecord_strided(
+    struct TextPrinter* pr, int arr_size, ptrdiff_t stride, double* arr)
+{
+    double values[2];
+    if (stride == 1)
+    {
+        rrecord_values(pr, arr_size, arr);
+        return;
+    }
+    values[1] = 0;
+    for (int j = 0; j < arr_size; j++)
+    {
+        values[0] = arr[j * stride];
+        printer_write(pr, values);
+    }
+}
+
+/** Row `i` of complex matrix given by row pointers or contiguous storage */
+static double complex*
+crow(double complex** mat, double complex* data, int ld, int i)
+{
+    if (mat != NULL) return mat[i];
+    return data + (size_t) i * ld;
+}
+
+/** Row `i` of real matrix given by row pointers or contiguous storage */
+static double*
+rrow(double** mat, double* data, int ld, int i)
+{
+    if (mat != NULL) return mat[i];
+    return data + (size_t) i * ld;
+}
+
+static void
+cmat_record_rows(
+    struct TextPrinter* pr,
+    int                 nrows,
+    int                 ncols,
+    double complex**    mat,
+    double complex*     data,
+    int                 ld)
 {
-    FILE* f;
-    f = open_file(fname, "w");
     for (int i = 0; i < nrows; i++)
     {
-        carr_stream_record(f, fmt, CURSOR_POSITION, LINEBREAK, ncols, mat[i]);
+        crecord_values(pr, ncols, crow(mat, data, ld, i));
+        printer_text(pr, "\n");
     }
-    fclose(f);
 }
 
-void
-cmat_append(
-    char             fname[],
-    char             fmt[],
-    enum StartStream in_newline,
-    int              nrows,
-    int              ncols,
-    double complex** mat)
+static void
+rmat_record_rows(
+    struct TextPrinter* pr,
+    int                 nrows,
+    int                 ncols,
+    double**            mat,
+    double*             data,
+    int                 ld)
 {
-    FILE* f;
-    f = open_file(fname, "a");
-    if (in_newline) fprintf(f, "\n");
     for (int i = 0; i < nrows; i++)
     {
-        carr_stream_record(f, fmt, CURSOR_POSITION, LINEBREAK, ncols, mat[i]);
+        rrecord_values(pr, ncols, rrow(mat, data, ld, i));
+        printer_text(pr, "\n");
     }
-    fclose(f);
 }
 
-void
-cmat_txt_transpose(
-    char fname[], char fmt[], int nrows, int ncols, double complex** mat)
+/** Number of matrix columns transposed at once into the staging buffer
+ *
+ * At least a tile, thus every cache line of the rows is fully used
+ */
+static int
+transpose_stage_cols(int nrows, int ncols, size_t elem_size)
 {
-    FILE* f;
-    f = open_file(fname, "w");
-    for (int j = 0; j < ncols; j++)
+    size_t stage_cols;
+
+    stage_cols = TRANSPOSE_STAGE_BYTES / (elem_size * (nrows > 0 ? nrows : 1));
+    if (stage_cols < (size_t) TRANSPOSE_TILE) stage_cols = TRANSPOSE_TILE;
+    if (stage_cols > (size_t) ncols) stage_cols = ncols > 0 ? ncols : 1;
+    return stage_cols;
+}
+
+static void*
+alloc_stage(int nrows, int stage_cols, size_t elem_size)
+{
+    void* stage;
+
+    stage = malloc((size_t) nrows * stage_cols * elem_size + 1);
+    if (stage == NULL)
     {
-        for (int i = 0; i < nrows; i++)
-        {
-            fprintf(f, fmt, creal(mat[i][j]), cimag(mat[i][j]));
-        }
-        fprintf(f, "\n");
+        io_error("no memory to stage transposed matrix");
     }
-    fclose(f);
+    return stage;
 }
 
-void
-cmat_append_transpose(
-    char             fname[],
-    char             fmt[],
-    enum StartStream in_newline,
+/** Copy columns `j0` to `j1` of complex matrix to consecutive rows of
+ * `stage`, each of size `nrows`, going through square tiles
+ */
+static void
+cstage_transpose(
+    double complex** mat,
+    double complex*  data,
+    int              ld,
     int              nrows,
-    int              ncols,
-    double complex** mat)
+    int              j0,
+    int              j1,
+    double complex*  stage)
 {
-    FILE* f;
-    f = open_file(fname, "a");
-    if (in_newline) fprintf(f, "\n");
-    for (int j = 0; j < ncols; j++)
+    int             i, j, i_end, j_end;
+    double complex* row;
+
+    for (int it = 0; it < nrows; it += TRANSPOSE_TILE)
     {
-        for (int i = 0; i < nrows; i++)
+        i_end = it + TRANSPOSE_TILE < nrows ? it + TRANSPOSE_TILE : nrows;
+        for (int jt = j0; jt < j1; jt += TRANSPOSE_TILE)
         {
-            fprintf(f, fmt, creal(mat[i][j]), cimag(mat[i][j]));
+            j_end = jt + TRANSPOSE_TILE < j1 ? jt + TRANSPOSE_TILE : j1;
+            for (i = it; i < i_end; i++)
+            {
+                row = crow(mat, data, ld, i);
+                for (j = jt; j < j_end; j++)
+                {
+                    stage[(size_t) (j - j0) * nrows + i] = row[j];
+                }
+            }
         }
-        fprintf(f, "\n");
     }
-    fclose(f);
 }
 
-void
-rmat_txt(char fname[], char fmt[], int nrows, int ncols, double** mat)
+/** Transpose tile of rows `i0` to `i1` and columns `j0` to `j1`, with
+ * column `j0` going to the first row of `stage` of size `nrows`
+ */
+static void
+rtranspose_tile(
+    double** mat,
+    double*  data,
+    int      ld,
+    int      nrows,
+    int      i0,
+    int      i1,
+    int      j0,
+    int      j1,
+    double*  stage)
 {
-    FILE* f;
-    f = open_file(fname, "w");
-    for (int i = 0; i < nrows; i++)
+    int     i, j;
+    double* row;
+
+    i = i0;
+#ifdef __SSE2__
+    // 2x2 blocks are transposed in registers with unpack instructions
+    for (; i + 1 < i1; i += 2)
     {
-        rarr_stream_record(f, fmt, CURSOR_POSITION, LINEBREAK, ncols, mat[i]);
+        double* row_a = rrow(mat, data, ld, i);
+        double* row_b = rrow(mat, data, ld, i + 1);
+        double* out = stage + i;
+        for (j = j0; j + 1 < j1; j += 2, out += 2 * (size_t) nrows)
+        {
+            __m128d a = _mm_loadu_pd(row_a + j);
+            __m128d b = _mm_loadu_pd(row_b + j);
+            _mm_storeu_pd(out, _mm_unpacklo_pd(a, b));
+            _mm_storeu_pd(out + nrows, _mm_unpackhi_pd(a, b));
+        }
+        if (j < j1)
+        {
+            out[0] = row_a[j];
+            out[1] = row_b[j];
+        }
+    }
+#endif
+    for (; i < i1; i++)
+    {
+        row = rrow(mat, data, ld, i);
+        for (j = j0; j < j1; j++)
+        {
+            stage[(size_t) (j - j0) * nrows + i] = row[j];
+        }
     }
-    fclose(f);
 }
 
-void
-rmat_append(
-    char             fname[],
-    char             fmt[],
-    enum StartStream in_newline,
-    int              nrows,
-    int              ncols,
-    double**         mat)
+/** Copy columns `j0` to `j1` of real matrix to consecutive rows of
+ * `stage`, each of size `nrows`, going through square tiles
+ */
+static void
+rstage_transpose(
+    double** mat,
+    double*  data,
+    int      ld,
+    int      nrows,
+    int      j0,
+    int      j1,
+    double*  stage)
 {
-    FILE* f;
-    f = open_file(fname, "a");
-    if (in_newline) fprintf(f, "\n");
-    for (int i = 0; i < nrows; i++)
+    int i_end, j_end;
+
+    for (int it = 0; it < nrows; it += TRANSPOSE_TILE)
     {
-        rarr_stream_record(f, fmt, CURSOR_POSITION, LINEBREAK, ncols, mat[i]);
+        i_end = it + TRANSPOSE_TILE < nrows ? it + TRANSPOSE_TILE : nrows;
+        for (int jt = j0; jt < j1; jt += TRANSPOSE_TILE)
+        {
+            j_end = jt + TRANSPOSE_TILE < j1 ? jt + TRANSPOSE_TILE : j1;
+            rtranspose_tile(
+                mat,
+                data,
+                ld,
+                nrows,
+                it,
+                i_end,
+                jt,
+                j_end,
+                stage + (size_t) (jt - j0) * nrows);
+        }
     }
-    fclose(f);
 }
 
-void
-rmat_txt_transpose(char fname[], char fmt[], int nrows, int ncols, double** mat)
+static void
+cmat_record_transpose(
+    struct TextPrinter* pr,
+    int                 nrows,
+    int                 ncols,
+    double complex**    mat,
+    double complex*     data,
+    int                 ld)
 {
-    FILE* f;
-    f = open_file(fname, "w");
-    for (int j = 0; j < ncols; j++)
+    int              stage_cols, j1;
+    double complex*  stage;
+    struct IoCleanup cleanup;
+
+    stage_cols = transpose_stage_cols(nrows, ncols, sizeof(double complex));
+    stage = (double complex*) alloc_stage(
+        nrows, stage_cols, sizeof(double complex));
+    io_cleanup_push(&cleanup, free, stage);
+    for (int j0 = 0; j0 < ncols; j0 += stage_cols)
     {
-        for (int i = 0; i < nrows; i++)
+        j1 = j0 + stage_cols < ncols ? j0 + stage_cols : ncols;
+        cstage_transpose(mat, data, ld, nrows, j0, j1, stage);
+        for (int j = j0; j < j1; j++)
         {
-            fprintf(f, fmt, mat[i][j]);
+            crecord_values(pr, nrows, stage + (size_t) (j - j0) * nrows);
+            printer_text(pr, "\n");
         }
-        fprintf(f, "\n");
     }
-    fclose(f);
+    io_cleanup_pop(&cleanup, 1);
 }
 
-void
-rmat_append_transpose(
-    char             fname[],
-    char             fmt[],
-    enum StartStream in_newline,
-    int              nrows,
-    int              ncols,
-    double**         mat)
+static void
+rmat_record_transpose(
+    struct TextPrinter* pr,
+    int                 nrows,
+    int                 ncols,
+    double**            mat,
+    double*             data,
+    int                 ld)
 {
-    FILE* f;
-    f = open_file(fname, "a");
-    if (in_newline) fprintf(f, "\n");
-    for (int j = 0; j < ncols; j++)
+    int              stage_cols, j1;
+    double*          stage;
+    struct IoCleanup cleanup;
+
+    stage_cols = transpose_stage_cols(nrows, ncols, sizeof(double));
+    stage = (double*) alloc_stage(nrows, stage_cols, sizeof(double));
+    io_cleanup_push(&cleanup, free, stage);
+    for (int j0 = 0; j0 < ncols; j0 += stage_cols)
     {
-        for (int i = 0; i < nrows; i++)
+        j1 = j0 + stage_cols < ncols ? j0 + stage_cols : ncols;
+        rstage_transpose(mat, data, ld, nrows, j0, j1, stage);
+        for (int j = j0; j < j1; j++)
         {
-            fprintf(f, fmt, mat[i][j]);
+            rrecord_values(pr, nrows, stage + (size_t) (j - j0) * nrows);
+            printer_text(pr, "\n");
         }
-        fprintf(f, "\n");
     }
-    fclose(f);
+    io_cleanup_pop(&cleanup, 1);
 }
 
-void
-cmat_rowmajor_stream(
-    FILE*             f,
-    char              fmt[],
-    enum StartStream  in_newline,
-    enum FinishStream add_linebreak,
-    int               nrows,
-    int               ncols,
-    double complex**  mat)
+static void
+cmat_record_stream(
+    struct TextPrinter* pr,
+    enum StartStream    in_newline,
+    enum FinishStream   add_linebreak,
+    int                 nrows,
+    int                 ncols,
+    double complex**    mat,
+    double complex*     data,
+    int                 ld)
 {
-    assert_file_pointer(f, "cmat_rowmajor_stream routine");
-    if (in_newline) fprintf(f, "\n");
+    if (in_newline) printer_text(pr, "\n");
     for (int i = 0; i < nrows; i++)
     {
-        carr_stream_record(
-            f, fmt, CURSOR_POSITION, NO_LINEBREAK, ncols, mat[i]);
+        crecord_values(pr, ncols, crow(mat, data, ld, i));
     }
-    if (add_linebreak) fprintf(f, "\n");
+    if (add_linebreak) printer_text(pr, "\n");
 }
 
-void
-rmat_rowmajor_stream(
-    FILE*             f,
-    char              fmt[],
-    enum StartStream  in_newline,
-    enum FinishStream add_linebreak,
-    int               nrows,
-    int               ncols,
-    double**          mat)
+static void
+rmat_record_stream(
+    struct TextPrinter* pr,
+    enum StartStream    in_newline,
+    enum FinishStream   add_linebreak,
+    int                 nrows,
+    int                 ncols,
+    double**            mat,
+    double*             data,
+    int                 ld)
 {
-    assert_file_pointer(f, "rmat_rowmajor_stream routine");
-    if (in_newline) fprintf(f, "\n");
+    if (in_newline) printer_text(pr, "\n");
     for (int i = 0; i < nrows; i++)
     {
-        rarr_stream_record(
-            f, fmt, CURSOR_POSITION, NO_LINEBREAK, ncols, mat[i]);
+        rrecord_values(pr, ncols, rrow(mat, data, ld, i));
     }
-    if (add_linebreak) fprintf(f, "\n");
+    if (add_linebreak) printer_text(pr, "\n");
 }
 
-void
-cmat_rowmajor_column_txt(
-    char fname[], char fmt[], int nrows, int ncols, double complex** mat)
+static void
+cmat_record_column(
+    struct TextPrinter* pr,
+    int                 nrows,
+    int                 ncols,
+    double complex**    mat,
+    double complex*     data,
+    int                 ld)
 {
-    FILE* f;
-    f = open_file(fname, "w");
+    double complex*    row;
     for (int i = 0; i < nrows; i++)
     {
+        row = crow(mat, data, ld, i);
         for (int j = 0; j < ncols; j++)
         {
-            fprintf(f, fmt, creal(mat[i][j]), cimag(mat[i][j]));
-            fprintf(f, "\n");
+            crecord_values(pr, 1, &row[j]);
+            printer_text(pr, "\n");
         }
     }
-    fclose(f);
 }
 
-void
-rmat_rowmajor_column_txt(
-    char fname[], char fmt[], int nrows, int ncols, double** mat)
+static void
+rmat_record_column(
+    struct TextPrinter* pr,
+    int                 nrows,
+    int                 ncols,
+    double**            mat,
+    double*             data,
+    int                 ld)
 {
-    FILE* f;
-    f = open_file(fname, "w");
+    double*            row;
     for (int i = 0; i < nrows; i++)
     {
+        row = rrow(mat, data, ld, i);
         for (int j = 0; j < ncols; j++)
         {
-            fprintf(f, fmt, mat[i][j]);
-            fprintf(f, "\n");
+            rrecord_values(pr, 1, &row[j]);
+            printer_text(pr, "\n");
         }
     }
-    fclose(f);
 }
 
-void
-carr_append_stream(
-    char              fname[],
-    char              fmt[],
-    enum StartStream  in_newline,
-    enum FinishStream add_linebreak,
-    int               arr_size,
-    double complex*   arr)
+/** Position of the first element of slice and distances between its rows
+ * and columns, in number of values
+ */
+static ptrdiff_t
+slice_layout(
+    struct MatrixSlice* s, ptrdiff_t* row_stride, ptrdiff_t* col_stride)
 {
-    FILE* f;
-    f = open_file(fname, "a");
-    carr_stream_record(f, fmt, in_newline, add_linebreak, arr_size, arr);
-    fclose(f);
+    ptrdiff_t row_dist, col_dist;
+
+    row_dist = s->order == COL_MAJOR ? 1 : s->ld;
+    col_dist = s->order == COL_MAJOR ? s->ld : 1;
+    *row_stride = row_dist * s->row_step;
+    *col_stride = col_dist * s->col_step;
+    return s->row0 * row_dist + s->col0 * col_dist;
 }
 
-void
-rarr_append_stream(
-    char              fname[],
-    char              fmt[],
-    enum StartStream  in_newline,
-    enum FinishStream add_linebreak,
-    int               arr_size,
-    double*           arr)
+static void
+cslice_record(
+    struct TextPrinter* pr,
+    struct MatrixSlice* s,
+    double complex*     mat,
+    int                 break_rows)
 {
-    FILE* f;
-    f = open_file(fname, "a");
-    rarr_stream_record(f, fmt, in_newline, add_linebreak, arr_size, arr);
-    fclose(f);
+    ptrdiff_t origin, row_stride, col_stride;
+
+    origin = slice_layout(s, &row_stride, &col_stride);
+    for (int i = 0; i < s->nrows; i++)
+    {
+        crecord_strided(
+            pr, s->ncols, col_stride, mat + origin + i * row_stride);
+        if (break_rows) printer_text(pr, "\n");
+    }
 }
 
-void
-cmat_rowmajor_append_stream(
-    char              fname[],
-    char              fmt[],
-    enum StartStream  in_newline,
-    enum FinishStream add_linebreak,
-    int               nrows,
-    int               ncols,
-    double complex**  mat)
+static void
+rslice_record(
+    struct TextPrinter* pr, struct MatrixSlice* s, double* mat, int break_rows)
 {
-    FILE* f;
-    f = open_file(fname, "a");
-    cmat_rowmajor_stream(f, fmt, in_newline, add_linebreak, nrows, ncols, mat);
-    fclose(f);
+    ptrdiff_t origin, row_stride, col_stride;
+
+    origin = slice_layout(s, &row_stride, &col_stride);
+    for (int i = 0; i < s->nrows; i++)
+    {
+        rrecord_strided(
+            pr, s->ncols, col_stride, mat + origin + i * row_stride);
+        if (break_rows) printer_text(pr, "\n");
+    }
 }
 
-void
-rmat_rowmajor_append_stream(
-    char              fname[],
-    char              fmt[],
-    enum StartStream  in_newline,
-    enum FinishStream add_linebreak,
-    int               nrows,
-    int               ncols,
-    double**          mat)
+/** First value of row `i` of the matrix written in parallel */
+static double*
+job_row(struct ParallelWrite* job, int i)
 {
-    FILE* f;
-    f = open_file(fname, "a");
-    rmat_rowmajor_stream(f, fmt, in_newline, add_linebreak, nrows, ncols, mat);
-    fclose(f);
+    if (job->rows != NULL) return (double*) job->rows[i];
+    return job->data + job->ncomp * (i * job->row_stride);
+}
+
+static void
+format_chunk(struct ParallelWrite* job, int k)
+{
+    int                 i, last_row;
+    struct TextPrinter* pr;
+
+    pr = &job->chunks[k].pr;
+    printer_open_memory(pr, job->fmt);
+    last_row = (k + 1) * job->rows_per_chunk;
+    if (last_row > job->nrows) last_row = job->nrows;
+    for (i = k * job->rows_per_chunk; i < last_row; i++)
+    {
+        if (job->ncomp == 2)
+        {
+            crecord_strided(
+                pr,
+                job->ncols,
+                job->col_stride,
+                (double complex*) job_row(job, i));
+        } else
+        {
+            rrecord_strided(pr, job->ncols, job->col_stride, job_row(job, i));
+        }
+        printer_text(pr, "\n");
+    }
+}
+
+/** Format chunks until none is left, raising errors with `io_error` */
+static void
+format_chunks(void* arg)
+{
+    int                   k;
+    struct ParallelWrite* job;
+
+    job = (struct ParallelWrite*) arg;
+    while (1)
+    {
+        pthread_mutex_lock(&job->lock);
+        while (!job->aborted && job->next_chunk < job->nchunks
+               && job->next_chunk >= job->nwritten + job->window)
+        {
+            pthread_cond_wait(&job->changed, &job->lock);
+        }
+        k = job->aborted ? job->nchunks : job->next_chunk;
+        if (k < job->nchunks) job->next_chunk++;
+        pthread_mutex_unlock(&job->lock);
+        if (k >= job->nchunks) break;
+        format_chunk(job, k);
+        pthread_mutex_lock(&job->lock);
+        job->chunks[k].ready = 1;
+        pthread_cond_broadcast(&job->changed);
+        pthread_mutex_unlock(&job->lock);
+    }
+}
+
+/** Stop all threads, keeping the first error message if `error` is set */
+static void
+abort_parallel_write(struct ParallelWrite* job, char error[])
+{
+    pthread_mutex_lock(&job->lock);
+    if (error != NULL && !job->aborted)
+    {
+        memcpy(job->error, error, IO_ERROR_SIZE);
+    }
+    job->aborted = 1;
+    pthread_cond_broadcast(&job->changed);
+    pthread_mutex_unlock(&job->lock);
+}
+
+static void*
+parallel_write_worker(void* arg)
+{
+    struct IoContext      ctx;
+    struct ParallelWrite* job;
+
+    job = (struct ParallelWrite*) arg;
+    // errors are raised again by the calling thread after all are done
+    ctx = job->settings;
+    if (io_context_run(&ctx, format_chunks, job) != 0)
+    {
+        abort_parallel_write(job, ctx.error);
+    }
+    return NULL;
+}
+
+/** Write chunks to the file in order as soon as they are formatted
+ *
+ * Chunks not claimed by any thread yet are formatted by the caller, thus
+ * the writing also completes if fewer threads could be started
+ */
+static void
+write_chunks_in_order(struct ParallelWrite* job, char fname[])
+{
+    int                claimed;
+    struct WriteChunk* chunk;
+
+    for (int k = 0; k < job->nchunks; k++)
+    {
+        chunk = &job->chunks[k];
+        claimed = 0;
+        pthread_mutex_lock(&job->lock);
+        if (!job->aborted && job->next_chunk == k)
+        {
+            job->next_chunk++;
+            claimed = 1;
+        }
+        while (!claimed && !chunk->ready && !job->aborted)
+        {
+            pthread_cond_wait(&job->changed, &job->lock);
+        }
+        pthread_mutex_unlock(&job->lock);
+        if (claimed) format_chunk(job, k);
+        if (!claimed && !chunk->ready) io_error("%s", job->error);
+        if (fwrite(chunk->pr.buf, 1, chunk->pr.len, job->f) != chunk->pr.len)
+        {
+            io_error("failed writing to file %s", fname);
+        }
+        printer_close(&chunk->pr);
+        pthread_mutex_lock(&job->lock);
+        job->nwritten++;
+        pthread_cond_broadcast(&job->changed);
+        pthread_mutex_unlock(&job->lock);
+    }
+}
+
+/** Stop and join the formatting threads, then release all resources */
+static void
+release_parallel_write(void* arg)
+{
+    struct ParallelWrite* job;
+
+    job = (struct ParallelWrite*) arg;
+    abort_parallel_write(job, NULL);
+    for (int i = 0; i < job->nthreads; i++)
+    {
+        pthread_join(job->threads[i], NULL);
+    }
+    for (int k = 0; k < job->nchunks; k++)
+    {
+        release_printer(&job->chunks[k].pr);
+    }
+    if (job->f != NULL) fclose(job->f);
+    pthread_cond_destroy(&job->changed);
+    pthread_mutex_destroy(&job->lock);
+    free(job->threads);
+    free(job->chunks);
+}
+
+/** Record matrix in parallel returning 0 if the serial path must be used */
+static int
+mat_txt_parallel(
+    char      fname[],
+    char      fmt[],
+    int       nrows,
+    int       ncols,
+    int       ncomp,
+    void**    rows,
+    double*   data,
+    ptrdiff_t row_stride,
+    ptrdiff_t col_stride,
+    int       nthreads)
+{
+    int                  i;
+    struct PrintFormat   plan;
+    struct ParallelWrite job;
+
+    if (!compile_print_format(fmt, &plan) || plan.nvalues > 2) return 0;
+    if (nthreads <= 0) nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (nthreads <= 1 || nrows <= 0 || ncols <= 0) return 0;
+    job.rows_per_chunk = PARALLEL_CHUNK_VALUES / ncols;
+    if (job.rows_per_chunk < 1) job.rows_per_chunk = 1;
+    job.nchunks = (nrows - 1) / job.rows_per_chunk + 1;
+    if (job.nchunks < 2) return 0;
+    if (nthreads > job.nchunks) nthreads = job.nchunks;
+    job.fmt = fmt;
+    job.ncomp = ncomp;
+    job.nrows = nrows;
+    job.ncols = ncols;
+    job.rows = rows;
+    job.data = data;
+    job.row_stride = row_stride;
+    job.col_stride = col_stride;
+    job.window = nthreads * CHUNKS_PER_THREAD;
+    job.next_chunk = 0;
+    job.nwritten = 0;
+    job.aborted = 0;
+    job.nthreads = 0;
+    job.f = NULL;
+    io_context_inherit(&job.settings);
+    pthread_mutex_init(&job.lock, NULL);
+    pthread_cond_init(&job.changed, NULL);
+    job.chunks = (struct WriteChunk*) calloc(job.nchunks, sizeof(*job.chunks));
+    job.threads = (pthread_t*) malloc(nthreads * sizeof(pthread_t));
+    io_cleanup_push(&job.cleanup, release_parallel_write, &job);
+    if (job.chunks == NULL || job.threads == NULL)
+    {
+        io_error("no memory to write %s in parallel", fname);
+    }
+    job.f = open_file(fname, "w");
+    for (i = 0; i < nthreads; i++)
+    {
+        // with fewer threads the caller formats the chunks left unclaimed
+        if (pthread_create(
+                &job.threads[i], NULL, parallel_write_worker, &job)
+            != 0)
+        {
+            break;
+        }
+        job.nthreads++;
+    }
+    write_chunks_in_order(&job, fname);
+    io_cleanup_pop(&job.cleanup, 1);
+    return 1;
+}
+
+void
+cmat_txt(char fname[], char fmt[], int nrows, int ncols, double complex** mat)
+{
+    struct TextPrinter pr;
+    record_open(&pr, fname, "w", fmt);
+    cmat_record_rows(&pr, nrows, ncols, mat, NULL, 0);
+    record_close(&pr);
+}
+
+void
+cmat_append(
+    char             fname[],
+    char             fmt[],
+    enum StartStream in_newline,
+    int              nrows,
+    int              ncols,
+    double complex** mat)
+{
+    struct TextPrinter pr;
+    record_open(&pr, fname, "a", fmt);
+    if (in_newline) printer_text(&pr, "\n");
+    cmat_record_rows(&pr, nrows, ncols, mat, NULL, 0);
+    record_close(&pr);
+}
+
+void
+cmat_txt_transpose(
+    char fname[], char fmt[], int nrows, int ncols, double complex** mat)
+{
+    struct TextPrinter pr;
+    record_open(&pr, fname, "w", fmt);
+    cmat_record_transpose(&pr, nrows, ncols, mat, NULL, 0);
+    record_close(&pr);
+}
+
+void
+cmat_append_transpose(
+    char             fname[],
+    char             fmt[],
+    enum StartStream in_newline,
+    int              nrows,
+    int              ncols,
+    double complex** mat)
+{
+    struct TextPrinter pr;
+    record_open(&pr, fname, "a", fmt);
+    if (in_newline) printer_text(&pr, "\n");
+    cmat_record_transpose(&pr, nrows, ncols, mat, NULL, 0);
+    record_close(&pr);
+}
+
+void
+rmat_txt(char fname[], char fmt[], int nrows, int ncols, double** mat)
+{
+    struct TextPrinter pr;
+    record_open(&pr, fname, "w", fmt);
+    rmat_record_rows(&pr, nrows, ncols, mat, NULL, 0);
+    record_close(&pr);
+}
+
+void
+rmat_append(
+    char             fname[],
+    char             fmt[],
+    enum StartStream in_newline,
+    int              nrows,
+    int              ncols,
+    double**         mat)
+{
+    struct TextPrinter pr;
+    record_open(&pr, fname, "a", fmt);
+    if (in_newline) printer_text(&pr, "\n");
+    rmat_record_rows(&pr, nrows, ncols, mat, NULL, 0);
+    record_close(&pr);
+}
+
+void
+rmat_txt_transpose(char fname[], char fmt[], int nrows, int ncols, double** mat)
+{
+    struct TextPrinter pr;
+    record_open(&pr, fname, "w", fmt);
+    rmat_record_transpose(&pr, nrows, ncols, mat, NULL, 0);
+    record_close(&pr);
+}
+
+void
+rmat_append_transpose(
+    char             fname[],
+    char             fmt[],
+    enum StartStream in_newline,
+    int              nrows,
+    int              ncols,
+    double**         mat)
+{
+    struct TextPrinter pr;
+    record_open(&pr, fname, "a", fmt);
+    if (in_newline) printer_text(&pr, "\n");
+    rmat_record_transpose(&pr, nrows, ncols, mat, NULL, 0);
+    record_close(&pr);
+}
+
+void
+cmat_rowmajor_stream(
+    FILE*             f,
+    char              fmt[],
+    enum StartStream  in_newline,
+    enum FinishStream add_linebreak,
+    int               nrows,
+    int               ncols,
+    double complex**  mat)
+{
+    struct TextPrinter pr;
+    assert_file_pointer(f, "cmat_rowmajor_stream routine");
+    stream_open(&pr, f, fmt);
+    cmat_record_stream(
+        &pr, in_newline, add_linebreak, nrows, ncols, mat, NULL, 0);
+    stream_close(&pr);
+}
+
+void
+rmat_rowmajor_stream(
+    FILE*             f,
+    char              fmt[],
+    enum StartStream  in_newline,
+    enum FinishStream add_linebreak,
+    int               nrows,
+    int               ncols,
+    double**          mat)
+{
+    struct TextPrinter pr;
+    assert_file_pointer(f, "rmat_rowmajor_stream routine");
+    stream_open(&pr, f, fmt);
+    rmat_record_stream(
+        &pr, in_newline, add_linebreak, nrows, ncols, mat, NULL, 0);
+    stream_close(&pr);
+}
+
+void
+cmat_rowmajor_column_txt(
+    char fname[], char fmt[], int nrows, int ncols, double complex** mat)
+{
+    struct TextPrinter pr;
+    record_open(&pr, fname, "w", fmt);
+    cmat_record_column(&pr, nrows, ncols, mat, NULL, 0);
+    record_close(&pr);
+}
+
+void
+rmat_rowmajor_column_txt(
+    char fname[], char fmt[], int nrows, int ncols, double** mat)
+{
+    struct TextPrinter pr;
+    record_open(&pr, fname, "w", fmt);
+    rmat_record_column(&pr, nrows, ncols, mat, NULL, 0);
+    record_close(&pr);
+}
+
+void
+carr_append_stream(
+    char              fname[],
+    char              fmt[],
+    enum StartStream  in_newline,
+    enum FinishStream add_linebreak,
+    int               arr_size,
+    double complex*   arr)
+{
+    FILE*            f;
+    struct IoCleanup cleanup;
+    f = open_file(fname, "a");
+    io_cleanup_push(&cleanup, close_file, f);
+    carr_stream_record(f, fmt, in_newline, add_linebreak, arr_size, arr);
+    io_cleanup_pop(&cleanup, 1);
+}
+
+void
+rarr_append_stream(
+    char              fname[],
+    char              fmt[],
+    enum StartStream  in_newline,
+    enum FinishStream add_linebreak,
+    int               arr_size,
+    double*           arr)
+{
+    FILE*            f;
+    struct IoCleanup cleanup;
+    f = open_file(fname, "a");
+    io_cleanup_push(&cleanup, close_file, f);
+    rarr_stream_record(f, fmt, in_newline, add_linebreak, arr_size, arr);
+    io_cleanup_pop(&cleanup, 1);
+}
+
+void
+cmat_rowmajor_append_stream(
+    char              fname[],
+    char              fmt[],
+    enum StartStream  in_newline,
+    enum FinishStream add_linebreak,
+    int               nrows,
+    int               ncols,
+    double complex**  mat)
+{
+    FILE*            f;
+    struct IoCleanup cleanup;
+    f = open_file(fname, "a");
+    io_cleanup_push(&cleanup, close_file, f);
+    cmat_rowmajor_stream(f, fmt, in_newline, add_linebreak, nrows, ncols, mat);
+    io_cleanup_pop(&cleanup, 1);
+}
+
+void
+rmat_rowmajor_append_stream(
+    char              fname[],
+    char              fmt[],
+    enum StartStream  in_newline,
+    enum FinishStream add_linebreak,
+    int               nrows,
+    int               ncols,
+    double**          mat)
+{
+    FILE*            f;
+    struct IoCleanup cleanup;
+    f = open_file(fname, "a");
+    io_cleanup_push(&cleanup, close_file, f);
+    rmat_rowmajor_stream(f, fmt, in_newline, add_linebreak, nrows, ncols, mat);
+    io_cleanup_pop(&cleanup, 1);
+}
+
+void
+crowmajor_txt(
+    char fname[], char fmt[], int nrows, int ncols, int ld, double complex* mat)
+{
+    struct TextPrinter pr;
+    record_open(&pr, fname, "w", fmt);
+    cmat_record_rows(&pr, nrows, ncols, NULL, mat, ld);
+    record_close(&pr);
+}
+
+void
+crowmajor_append(
+    char             fname[],
+    char             fmt[],
+    enum StartStream in_newline,
+    int              nrows,
+    int              ncols,
+    int              ld,
+    double complex*  mat)
+{
+    struct TextPrinter pr;
+    record_open(&pr, fname, "a", fmt);
+    if (in_newline) printer_text(&pr, "\n");
+    cmat_record_rows(&pr, nrows, ncols, NULL, mat, ld);
+    record_close(&pr);
+}
+
+void
+crowmajor_txt_transpose(
+    char fname[], char fmt[], int nrows, int ncols, int ld, double complex* mat)
+{
+    struct TextPrinter pr;
+    record_open(&pr, fname, "w", fmt);
+    cmat_record_transpose(&pr, nrows, ncols, NULL, mat, ld);
+    record_close(&pr);
+}
+
+void
+crowmajor_append_transpose(
+    char             fname[],
+    char             fmt[],
+    enum StartStream in_newline,
+    int              nrows,
+    int              ncols,
+    int              ld,
+    double complex*  mat)
+{
+    struct TextPrinter pr;
+    record_open(&pr, fname, "a", fmt);
+    if (in_newline) printer_text(&pr, "\n");
+    cmat_record_transpose(&pr, nrows, ncols, NULL, mat, ld);
+    record_close(&pr);
+}
+
+void
+crowmajor_stream(
+    FILE*             f,
+    char              fmt[],
+    enum StartStream  in_newline,
+    enum FinishStream add_linebreak,
+    int               nrows,
+    int               ncols,
+    int               ld,
+    double complex*   mat)
+{
+    struct TextPrinter pr;
+    assert_file_pointer(f, "crowmajor_stream routine");
+    stream_open(&pr, f, fmt);
+    cmat_record_stream(
+        &pr, in_newline, add_linebreak, nrows, ncols, NULL, mat, ld);
+    stream_close(&pr);
+}
+
+void
+crowmajor_column_txt(
+    char fname[], char fmt[], int nrows, int ncols, int ld, double complex* mat)
+{
+    struct TextPrinter pr;
+    record_open(&pr, fname, "w", fmt);
+    cmat_record_column(&pr, nrows, ncols, NULL, mat, ld);
+    record_close(&pr);
+}
+
+void
+crowmajor_append_stream(
+    char              fname[],
+    char              fmt[],
+    enum StartStream  in_newline,
+    enum FinishStream add_linebreak,
+    int               nrows,
+    int               ncols,
+    int               ld,
+    double complex*   mat)
+{
+    FILE*            f;
+    struct IoCleanup cleanup;
+    f = open_file(fname, "a");
+    io_cleanup_push(&cleanup, close_file, f);
+    crowmajor_stream(f, fmt, in_newline, add_linebreak, nrows, ncols, ld, mat);
+    io_cleanup_pop(&cleanup, 1);
+}
+
+void
+rrowmajor_txt(
+    char fname[], char fmt[], int nrows, int ncols, int ld, double* mat)
+{
+    struct TextPrinter pr;
+    record_open(&pr, fname, "w", fmt);
+    rmat_record_rows(&pr, nrows, ncols, NULL, mat, ld);
+    record_close(&pr);
+}
+
+void
+rrowmajor_append(
+    char             fname[],
+    char             fmt[],
+    enum StartStream in_newline,
+    int              nrows,
+    int              ncols,
+    int              ld,
+    double*          mat)
+{
+    struct TextPrinter pr;
+    record_open(&pr, fname, "a", fmt);
+    if (in_newline) printer_text(&pr, "\n");
+    rmat_record_rows(&pr, nrows, ncols, NULL, mat, ld);
+    record_close(&pr);
+}
+
+void
+rrowmajor_txt_transpose(
+    char fname[], char fmt[], int nrows, int ncols, int ld, double* mat)
+{
+    struct TextPrinter pr;
+    record_open(&pr, fname, "w", fmt);
+    rmat_record_transpose(&pr, nrows, ncols, NULL, mat, ld);
+    record_close(&pr);
+}
+
+void
+rrowmajor_append_transpose(
+    char             fname[],
+    char             fmt[],
+    enum StartStream in_newline,
+    int              nrows,
+    int              ncols,
+    int              ld,
+    double*          mat)
+{
+    struct TextPrinter pr;
+    record_open(&pr, fname, "a", fmt);
+    if (in_newline) printer_text(&pr, "\n");
+    rmat_record_transpose(&pr, nrows, ncols, NULL, mat, ld);
+    record_close(&pr);
+}
+
+void
+rrowmajor_stream(
+    FILE*             f,
+    char              fmt[],
+    enum StartStream  in_newline,
+    enum FinishStream add_linebreak,
+    int               nrows,
+    int               ncols,
+    int               ld,
+    double*           mat)
+{
+    struct TextPrinter pr;
+    assert_file_pointer(f, "rrowmajor_stream routine");
+    stream_open(&pr, f, fmt);
+    rmat_record_stream(
+        &pr, in_newline, add_linebreak, nrows, ncols, NULL, mat, ld);
+    stream_close(&pr);
+}
+
+void
+rrowmajor_column_txt(
+    char fname[], char fmt[], int nrows, int ncols, int ld, double* mat)
+{
+    struct TextPrinter pr;
+    record_open(&pr, fname, "w", fmt);
+    rmat_record_column(&pr, nrows, ncols, NULL, mat, ld);
+    record_close(&pr);
+}
+
+void
+rrowmajor_append_stream(
+    char              fname[],
+    char              fmt[],
+    enum StartStream  in_newline,
+    enum FinishStream add_linebreak,
+    int               nrows,
+    int               ncols,
+    int               ld,
+    double*           mat)
+{
+    FILE*            f;
+    struct IoCleanup cleanup;
+    f = open_file(fname, "a");
+    io_cleanup_push(&cleanup, close_file, f);
+    rrowmajor_stream(f, fmt, in_newline, add_linebreak, nrows, ncols, ld, mat);
+    io_cleanup_pop(&cleanup, 1);
+}
+
+void
+cmat_txt_parallel(
+    char             fname[],
+    char             fmt[],
+    int              nrows,
+    int              ncols,
+    double complex** mat,
+    int              nthreads)
+{
+    if (mat_txt_parallel(
+            fname, fmt, nrows, ncols, 2, (void**) mat, NULL, 0, 1, nthreads))
+    {
+        return;
+    }
+    cmat_txt(fname, fmt, nrows, ncols, mat);
+}
+
+void
+rmat_txt_parallel(
+    char     fname[],
+    char     fmt[],
+    int      nrows,
+    int      ncols,
+    double** mat,
+    int      nthreads)
+{
+    if (mat_txt_parallel(
+            fname, fmt, nrows, ncols, 1, (void**) mat, NULL, 0, 1, nthreads))
+    {
+        return;
+    }
+    rmat_txt(fname, fmt, nrows, ncols, mat);
+}
+
+void
+crowmajor_txt_parallel(
+    char            fname[],
+    char            fmt[],
+    int             nrows,
+    int             ncols,
+    int             ld,
+    double complex* mat,
+    int             nthreads)
+{
+    if (mat_txt_parallel(
+            fname, fmt, nrows, ncols, 2, NULL, (double*) mat, ld, 1, nthreads))
+    {
+        return;
+    }
+    crowmajor_txt(fname, fmt, nrows, ncols, ld, mat);
+}
+
+void
+rrowmajor_txt_parallel(
+    char    fname[],
+    char    fmt[],
+    int     nrows,
+    int     ncols,
+    int     ld,
+    double* mat,
+    int     nthreads)
+{
+    if (mat_txt_parallel(
+            fname, fmt, nrows, ncols, 1, NULL, mat, ld, 1, nthreads))
+    {
+        return;
+    }
+    rrowmajor_txt(fname, fmt, nrows, ncols, ld, mat);
+}
+
+void
+cslice_txt(char fname[], char fmt[], struct MatrixSlice* s, double complex* mat)
+{
+    struct TextPrinter pr;
+    record_open(&pr, fname, "w", fmt);
+    cslice_record(&pr, s, mat, 1);
+    record_close(&pr);
+}
+
+void
+cslice_append(
+    char                fname[],
+    char                fmt[],
+    enum StartStream    in_newline,
+    struct MatrixSlice* s,
+    double complex*     mat)
+{
+    struct TextPrinter pr;
+    record_open(&pr, fname, "a", fmt);
+    if (in_newline) printer_text(&pr, "\n");
+    cslice_record(&pr, s, mat, 1);
+    record_close(&pr);
+}
+
+void
+cslice_stream(
+    FILE*               f,
+    char                fmt[],
+    enum StartStream    in_newline,
+    enum FinishStream   add_linebreak,
+    struct MatrixSlice* s,
+    double complex*     mat)
+{
+    struct TextPrinter pr;
+    assert_file_pointer(f, "cslice_stream routine");
+    stream_open(&pr, f, fmt);
+    if (in_newline) printer_text(&pr, "\n");
+    cslice_record(&pr, s, mat, 0);
+    if (add_linebreak) printer_text(&pr, "\n");
+    stream_close(&pr);
+}
+
+void
+cslice_txt_parallel(
+    char                fname[],
+    char                fmt[],
+    struct MatrixSlice* s,
+    double complex*     mat,
+    int                 nthreads)
+{
+    ptrdiff_t origin, row_stride, col_stride;
+
+    origin = slice_layout(s, &row_stride, &col_stride);
+    if (mat_txt_parallel(
+            fname,
+            fmt,
+            s->nrows,
+            s->ncols,
+            2,
+            NULL,
+            (double*) (mat + origin),
+            row_stride,
+            col_stride,
+            nthreads))
+    {
+        return;
+    }
+    cslice_txt(fname, fmt, s, mat);
+}
+
+void
+rslice_txt(char fname[], char fmt[], struct MatrixSlice* s, double* mat)
+{
+    struct TextPrinter pr;
+    record_open(&pr, fname, "w", fmt);
+    rslice_record(&pr, s, mat, 1);
+    record_close(&pr);
+}
+
+void
+rslice_append(
+    char                fname[],
+    char                fmt[],
+    enum StartStream    in_newline,
+    struct MatrixSlice* s,
+    double*             mat)
+{
+    struct TextPrinter pr;
+    record_open(&pr, fname, "a", fmt);
+    if (in_newline) printer_text(&pr, "\n");
+    rslice_record(&pr, s, mat, 1);
+    record_close(&pr);
+}
+
+void
+rslice_stream(
+    FILE*               f,
+    char                fmt[],
+    enum StartStream    in_newline,
+    enum FinishStream   add_linebreak,
+    struct MatrixSlice* s,
+    double*             mat)
+{
+    struct TextPrinter pr;
+    assert_file_pointer(f, "rslice_stream routine");
+    stream_open(&pr, f, fmt);
+    if (in_newline) printer_text(&pr, "\n");
+    rslice_record(&pr, s, mat, 0);
+    if (add_linebreak) printer_text(&pr, "\n");
+    stream_close(&pr);
+}
+
+void
+rslice_txt_parallel(
+    char                fname[],
+    char                fmt[],
+    struct MatrixSlice* s,
+    double*             mat,
+    int                 nthreads)
+{
+    ptrdiff_t origin, row_stride, col_stride;
+
+    origin = slice_layout(s, &row_stride, &col_stride);
+    if (mat_txt_parallel(
+            fname,
+            fmt,
+            s->nrows,
+            s->ncols,
+            1,
+            NULL,
+            mat + origin,
+            row_stride,
+            col_stride,
+            nthreads))
+    {
+        return;
+    }
+    rslice_txt(fname, fmt, s, mat);
+}
+
+/** Milliseconds elapsed since time `t` */
+static double
+elapsed_ms(struct timespec* t)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return 1E3 * (now.tv_sec - t->tv_sec) + 1E-6 * (now.tv_nsec - t->tv_nsec);
+}
+
+void
+record_session_open(struct RecordSession* s, char fname[])
+{
+    printer_open_owned(&s->pr, open_file(fname, "a"), "");
+    s->flush_records = 0;
+    s->flush_ms = 0;
+    s->sync = NO_SYNC;
+    s->pending = 0;
+    clock_gettime(CLOCK_MONOTONIC, &s->last_flush);
+}
+
+void
+record_session_policy(
+    struct RecordSession* s,
+    int                   every_records,
+    int                   every_ms,
+    enum SessionSync      sync)
+{
+    s->flush_records = every_records;
+    s->flush_ms = every_ms;
+    s->sync = sync;
+}
+
+void
+record_session_flush(struct RecordSession* s)
+{
+    int fd;
+
+    printer_flush(&s->pr);
+    if (fflush(s->pr.f) != 0)
+    {
+        io_error("failed flushing recorder session");
+    }
+    fd = fileno(s->pr.f);
+    if (s->sync == SYNC && fd >= 0 && fsync(fd) != 0)
+    {
+        io_error("failed syncing recorder session");
+    }
+    s->pending = 0;
+    clock_gettime(CLOCK_MONOTONIC, &s->last_flush);
+}
+
+void
+record_session_close(struct RecordSession* s)
+{
+    FILE* f;
+
+    record_session_flush(s);
+    f = s->pr.f;
+    printer_close(&s->pr);
+    fclose(f);
+}
+
+/** Prepare session printer for a new record with formatter `fmt` */
+static struct TextPrinter*
+session_begin(struct RecordSession* s, char fmt[])
+{
+    printer_set_format(&s->pr, fmt);
+    return &s->pr;
+}
+
+/** Count record just finished and flush according to session policy */
+static void
+session_end(struct RecordSession* s)
+{
+    s->pending++;
+    if ((s->flush_records > 0 && s->pending >= s->flush_records)
+        || (s->flush_ms > 0 && elapsed_ms(&s->last_flush) >= s->flush_ms))
+    {
+        record_session_flush(s);
+    }
+}
+
+void
+session_carr_append_stream(
+    struct RecordSession* s,
+    char                  fmt[],
+    enum StartStream      in_newline,
+    enum FinishStream     add_linebreak,
+    int                   arr_size,
+    double complex*       arr)
+{
+    struct TextPrinter* pr;
+    pr = session_begin(s, fmt);
+    cmat_record_stream(
+        pr, in_newline, add_linebreak, 1, arr_size, NULL, arr, arr_size);
+    session_end(s);
+}
+
+void
+session_rarr_append_stream(
+    struct RecordSession* s,
+    char                  fmt[],
+    enum StartStream      in_newline,
+    enum FinishStream     add_linebreak,
+    int                   arr_size,
+    double*               arr)
+{
+    struct TextPrinter* pr;
+    pr = session_begin(s, fmt);
+    rmat_record_stream(
+        pr, in_newline, add_linebreak, 1, arr_size, NULL, arr, arr_size);
+    session_end(s);
+}
+
+void
+session_cmat_append(
+    struct RecordSession* s,
+    char                  fmt[],
+    enum StartStream      in_newline,
+    int                   nrows,
+    int                   ncols,
+    double complex**      mat)
+{
+    struct TextPrinter* pr;
+    pr = session_begin(s, fmt);
+    if (in_newline) printer_text(pr, "\n");
+    cmat_record_rows(pr, nrows, ncols, mat, NULL, 0);
+    session_end(s);
+}
+
+void
+session_rmat_append(
+    struct RecordSession* s,
+    char                  fmt[],
+    enum StartStream      in_newline,
+    int                   nrows,
+    int                   ncols,
+    double**              mat)
+{
+    struct TextPrinter* pr;
+    pr = session_begin(s, fmt);
+    if (in_newline) printer_text(pr, "\n");
+    rmat_record_rows(pr, nrows, ncols, mat, NULL, 0);
+    session_end(s);
+}
+
+void
+session_cmat_append_transpose(
+    struct RecordSession* s,
+    char                  fmt[],
+    enum StartStream      in_newline,
+    int                   nrows,
+    int                   ncols,
+    double complex**      mat)
+{
+    struct TextPrinter* pr;
+    pr = session_begin(s, fmt);
+    if (in_newline) printer_text(pr, "\n");
+    cmat_record_transpose(pr, nrows, ncols, mat, NULL, 0);
+    session_end(s);
+}
+
+void
+session_rmat_append_transpose(
+    struct RecordSession* s,
+    char                  fmt[],
+    enum StartStream      in_newline,
+    int                   nrows,
+    int                   ncols,
+    double**              mat)
+{
+    struct TextPrinter* pr;
+    pr = session_begin(s, fmt);
+    if (in_newline) printer_text(pr, "\n");
+    rmat_record_transpose(pr, nrows, ncols, mat, NULL, 0);
+    session_end(s);
+}
+
+void
+session_cmat_rowmajor_append_stream(
+    struct RecordSession* s,
+    char                  fmt[],
+    enum StartStream      in_newline,
+    enum FinishStream     add_linebreak,
+    int                   nrows,
+    int                   ncols,
+    double complex**      mat)
+{
+    struct TextPrinter* pr;
+    pr = session_begin(s, fmt);
+    cmat_record_stream(
+        pr, in_newline, add_linebreak, nrows, ncols, mat, NULL, 0);
+    session_end(s);
+}
+
+void
+session_rmat_rowmajor_append_stream(
+    struct RecordSession* s,
+    char                  fmt[],
+    enum StartStream      in_newline,
+    enum FinishStream     add_linebreak,
+    int                   nrows,
+    int                   ncols,
+    double**              mat)
+{
+    struct TextPrinter* pr;
+    pr = session_begin(s, fmt);
+    rmat_record_stream(
+        pr, in_newline, add_linebreak, nrows, ncols, mat, NULL, 0);
+    session_end(s);
+}
+
+void
+session_crowmajor_append(
+    struct RecordSession* s,
+    char                  fmt[],
+    enum StartStream      in_newline,
+    int                   nrows,
+    int                   ncols,
+    int                   ld,
+    double complex*       mat)
+{
+    struct TextPrinter* pr;
+    pr = session_begin(s, fmt);
+    if (in_newline) printer_text(pr, "\n");
+    cmat_record_rows(pr, nrows, ncols, NULL, mat, ld);
+    session_end(s);
+}
+
+void
+session_rrowmajor_append(
+    struct RecordSession* s,
+    char                  fmt[],
+    enum StartStream      in_newline,
+    int                   nrows,
+    int                   ncols,
+    int                   ld,
+    double*               mat)
+{
+    struct TextPrinter* pr;
+    pr = session_begin(s, fmt);
+    if (in_newline) printer_text(pr, "\n");
+    rmat_record_rows(pr, nrows, ncols, NULL, mat, ld);
+    session_end(s);
+}
+
+void
+session_crowmajor_append_transpose(
+    struct RecordSession* s,
+    char                  fmt[],
+    enum StartStream      in_newline,
+    int                   nrows,
+    int                   ncols,
+    int                   ld,
+    double complex*       mat)
+{
+    struct TextPrinter* pr;
+    pr = session_begin(s, fmt);
+    if (in_newline) printer_text(pr, "\n");
+    cmat_record_transpose(pr, nrows, ncols, NULL, mat, ld);
+    session_end(s);
+}
+
+void
+session_rrowmajor_append_transpose(
+    struct RecordSession* s,
+    char                  fmt[],
+    enum StartStream      in_newline,
+    int                   nrows,
+    int                   ncols,
+    int                   ld,
+    double*               mat)
+{
+    struct TextPrinter* pr;
+    pr = session_begin(s, fmt);
+    if (in_newline) printer_text(pr, "\n");
+    rmat_record_transpose(pr, nrows, ncols, NULL, mat, ld);
+    session_end(s);
+}
+
+void
+session_crowmajor_append_stream(
+    struct RecordSession* s,
+    char                  fmt[],
+    enum StartStream      in_newline,
+    enum FinishStream     add_linebreak,
+    int                   nrows,
+    int                   ncols,
+    int                   ld,
+    double complex*       mat)
+{
+    struct TextPrinter* pr;
+    pr = session_begin(s, fmt);
+    cmat_record_stream(
+        pr, in_newline, add_linebreak, nrows, ncols, NULL, mat, ld);
+    session_end(s);
+}
+
+void
+session_rrowmajor_append_stream(
+    struct RecordSession* s,
+    char                  fmt[],
+    enum StartStream      in_newline,
+    enum FinishStream     add_linebreak,
+    int                   nrows,
+    int                   ncols,
+    int                   ld,
+    double*               mat)
+{
+    struct TextPrinter* pr;
+    pr = session_begin(s, fmt);
+    rmat_record_stream(
+        pr, in_newline, add_linebreak, nrows, ncols, NULL, mat, ld);
+    session_end(s);
 }
@@ -1,82 +1,311 @@
 #include "file_handle.h"
+#include "compressed_stream.h"
+#include "io_context.h"
+#include <fcntl.h>
 #include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define HAVE_X86_DISPATCH
+#endif
+
+/** Size of buffer to count lines in files that cannot be memory mapped */
+#define LINE_COUNT_BUFF_SIZE (1 << 20)
+
+/** Size of buffer to jump lines using `fgets` */
+#define LINE_JUMP_BUFF_SIZE 512
 
 char comment_char = DEFAULT_COMMENT_CHAR;
 
+typedef size_t (*ByteCounter)(const char*, const char*, char);
+
+static ByteCounter byte_counter = NULL;
+
+static size_t
+count_byte_memchr(const char* pos, const char* end, char c)
+{
+    size_t n;
+
+    n = 0;
+    while (pos < end && (pos = memchr(pos, c, end - pos)) != NULL)
+    {
+        n++;
+        pos++;
+    }
+    return n;
+}
+
+#ifdef HAVE_X86_DISPATCH
+
+/* Byte counters are accumulated in 8-bit lanes, subtracting the -1 of
+ * the comparison mask, and must be reduced before 256 iterations */
+
+__attribute__((target("sse2"))) static size_t
+count_byte_sse2(const char* pos, const char* end, char c)
+{
+    int      k;
+    uint64_t lanes[2];
+    __m128i  target, zero, counts, sums, block;
+
+    target = _mm_set1_epi8(c);
+    zero = _mm_setzero_si128();
+    sums = zero;
+    while (end - pos >= 16)
+    {
+        counts = zero;
+        for (k = 0; k < 255 && end - pos >= 16; k++, pos += 16)
+        {
+            block = _mm_loadu_si128((const __m128i*) pos);
+            counts = _mm_sub_epi8(counts, _mm_cmpeq_epi8(block, target));
+        }
+        sums = _mm_add_epi64(sums, _mm_sad_epu8(counts, zero));
+    }
+    _mm_storeu_si128((__m128i*) lanes, sums);
+    return lanes[0] + lanes[1] + count_byte_memchr(pos, end, c);
+}
+
+__attribute__((target("avx2"))) static size_t
+count_byte_avx2(const char* pos, const char* end, char c)
+{
+    int      k;
+    uint64_t lanes[4];
+    __m256i  target, zero, counts, sums, block;
+
+    target = _mm256_set1_epi8(c);
+    zero = _mm256_setzero_si256();
+    sums = zero;
+    while (end - pos >= 32)
+    {
+        counts = zero;
+        for (k = 0; k < 255 && end - pos >= 32; k++, pos += 32)
+        {
+            block = _mm256_loadu_si256((const __m256i*) pos);
+            counts = _mm256_sub_epi8(counts, _mm256_cmpeq_epi8(block, target));
+        }
+        sums = _mm256_add_epi64(sums, _mm256_sad_epu8(counts, zero));
+    }
+    _mm256_storeu_si256((__m256i*) lanes, sums);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3]
+           + count_byte_memchr(pos, end, c);
+}
+
+#endif
+
+/** Choose the widest instruction set supported by the running CPU */
+static ByteCounter
+select_byte_counter()
+{
+#ifdef HAVE_X86_DISPATCH
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return count_byte_avx2;
+    if (__builtin_cpu_supports("sse2")) return count_byte_sse2;
+#endif
+    return count_byte_memchr;
+}
+
 void
 assert_file_pointer(FILE* f, char client_msg[])
 {
     if (f == NULL)
     {
-        printf("\n\nERROR: Got a NULL file pointer: %s\n\n", client_msg);
-        exit(EXIT_FAILURE);
+        io_error("Got a NULL file pointer: %s", client_msg);
     }
 }
 
 FILE*
 open_file(char fname[], char mode[])
 {
-    FILE* f;
-    f = fopen(fname, mode);
+    FILE*            f;
+    enum Compression how;
+
+    if (mode[0] == 'r')
+    {
+        how = compression_of_file(fname);
+    } else
+    {
+        how = compression_from_name(fname);
+    }
+    if (how == NO_COMPRESSION)
+    {
+        f = fopen(fname, mode);
+    } else
+    {
+        f = open_compressed(fname, mode, how);
+    }
     if (f == NULL)
     {
-        printf("\n\nERROR: impossible to open file %s for %s\n\n", fname, mode);
-        exit(EXIT_FAILURE);
+        io_error("impossible to open file %s for %s", fname, mode);
     }
     return f;
 }
 
+size_t
+count_linebreaks(const char* pos, const char* end)
+{
+    ByteCounter counter;
+
+    // every thread would select the same function, thus no need of CAS
+    counter = __atomic_load_n(&byte_counter, __ATOMIC_RELAXED);
+    if (counter == NULL)
+    {
+        counter = select_byte_counter();
+        __atomic_store_n(&byte_counter, counter, __ATOMIC_RELAXED);
+    }
+    return counter(pos, end, '\n');
+}
+
 unsigned int
 number_of_lines(char fname[])
 {
-    char         c;
-    FILE*        f;
-    unsigned int linebreaks, has_end_linebreak;
+    char              last;
+    char*             buf;
+    const char*       start;
+    size_t            linebreaks, nread;
+    FILE*             f;
+    struct MappedFile mf;
+    struct IoCleanup  cleanup;
 
+    last = '\0';
     linebreaks = 0;
-    has_end_linebreak = 0;
-    f = open_file(fname, "r");
-    jump_comment_lines(f, CURSOR_POSITION);
-    while ((c = getc(f)) != EOF)
+    if (map_file(fname, &mf))
+    {
+        start = skip_comment_lines(mf.data, mf.data + mf.size, CURSOR_POSITION);
+        linebreaks = count_linebreaks(start, mf.data + mf.size);
+        if (start < mf.data + mf.size) last = mf.data[mf.size - 1];
+        unmap_file(&mf);
+    } else
     {
-        has_end_linebreak = 0;
-        if (c == '\n')
+        buf = (char*) malloc(LINE_COUNT_BUFF_SIZE);
+        if (buf == NULL)
+        {
+            io_error("no memory to count lines of %s", fname);
+        }
+        io_cleanup_push(&cleanup, free, buf);
+        f = open_file(fname, "r");
+        jump_comment_lines(f, CURSOR_POSITION);
+        while ((nread = fread(buf, 1, LINE_COUNT_BUFF_SIZE, f)) > 0)
         {
-            linebreaks++;
-            has_end_linebreak = 1;
+            linebreaks += count_linebreaks(buf, buf + nread);
+            last = buf[nread - 1];
         }
+        fclose(f);
+        io_cleanup_pop(&cleanup, 1);
     }
-    fclose(f);
-    if (has_end_linebreak) return linebreaks;
+    if (last == '\n') return linebreaks;
     return linebreaks + 1;
 }
 
 void
 jump_next_line(FILE* f)
 {
-    char c;
-    while ((c = getc(f)) != EOF)
+    char buf[LINE_JUMP_BUFF_SIZE];
+
+    // fgets only fills the whole buffer if it did not reach a linebreak
+    // before, in which case the linebreak is the last character read
+    do
     {
-        if (c == '\n') return;
-    }
+        buf[LINE_JUMP_BUFF_SIZE - 1] = 1;
+        if (fgets(buf, LINE_JUMP_BUFF_SIZE, f) == NULL) return;
+    } while (buf[LINE_JUMP_BUFF_SIZE - 1] == '\0'
+             && buf[LINE_JUMP_BUFF_SIZE - 2] != '\n');
 }
 
 void
 jump_comment_lines(FILE* f, enum StartStream in_newline)
 {
-    char c;
+    char c, comment;
 
+    comment = active_comment_char();
     if (in_newline) jump_next_line(f);
     while ((c = getc(f)) != EOF)
     {
         if (c == '\n' || c == ' ') continue;
-        if (c == comment_char)
+        if (c == comment)
         {
             jump_next_line(f);
         } else
         {
-            fseek(f, -1, SEEK_CUR);
+            ungetc(c, f);
             return;
         }
     }
 }
+
+int
+map_file(char fname[], struct MappedFile* mf)
+{
+    int         fd;
+    struct stat info;
+
+    mf->data = NULL;
+    mf->size = 0;
+    // opening a named pipe would block or consume the data of a writer
+    if (stat(fname, &info) != 0 || !S_ISREG(info.st_mode)) return 0;
+    fd = open(fname, O_RDONLY);
+    if (fd < 0) return 0;
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || info.st_size == 0)
+    {
+        close(fd);
+        return 0;
+    }
+    mf->data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mf->data == MAP_FAILED)
+    {
+        mf->data = NULL;
+        return 0;
+    }
+    mf->size = info.st_size;
+    if (compression_from_magic((unsigned char*) mf->data, mf->size)
+        != NO_COMPRESSION)
+    {
+        unmap_file(mf);
+        return 0;
+    }
+    madvise(mf->data, mf->size, MADV_SEQUENTIAL);
+    return 1;
+}
+
+void
+unmap_file(struct MappedFile* mf)
+{
+    if (mf->data != NULL) munmap(mf->data, mf->size);
+    mf->data = NULL;
+    mf->size = 0;
+}
+
+const char*
+skip_next_line(const char* pos, const char* end)
+{
+    const char* linebreak;
+
+    linebreak = memchr(pos, '\n', end - pos);
+    if (linebreak == NULL) return end;
+    return linebreak + 1;
+}
+
+const char*
+skip_comment_lines(
+    const char* pos, const char* end, enum StartStream in_newline)
+{
+    char comment;
+
+    comment = active_comment_char();
+    if (in_newline) pos = skip_next_line(pos, end);
+    while (pos < end)
+    {
+        if (*pos == '\n' || *pos == ' ')
+        {
+            pos++;
+            continue;
+        }
+        if (*pos != comment) return pos;
+        pos = skip_next_line(pos, end);
+    }
+    return pos;
+}
@@ -0,0 +1,581 @@
+#include "fixed_width.h"
+#include "file_handle.h"
+#include "text_printer.h"
+#include "text_scanner.h"
+#include "io_context.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/** Approximate number of bytes formatted by each thread per `pwrite` */
+#define FIXED_BLOCK_BYTES (1 << 20)
+
+/** Maximum width of value fields, of complex values at maximum precision */
+#define FIXED_MAX_WIDTH (2 * PRINT_FORMAT_MAX_PRECISION + 20)
+
+/** Rows of one matrix formatted and written by a pool of threads
+ *
+ * `nthreads` counts the calling thread and the threads started so far
+ */
+struct FixedWrite
+{
+    struct FixedWidthText* fw;
+    void**                 rows;
+    double*                data;
+    int                    ld;
+    int                    nthreads;
+    pthread_t*             threads;
+    struct FixedWorker*    workers;
+    struct IoCleanup       cleanup;
+};
+
+/** One thread of the pool and the rows it writes */
+struct FixedWorker
+{
+    struct FixedWrite* job;
+    int                first_row;
+    int                last_row;
+    int                failed;
+};
+
+static void
+fixed_problem(char fname[], char info[])
+{
+    io_error("%s in fixed width file %s", info, fname);
+}
+
+/** Set field width and row stride, exiting if the shape is invalid */
+static void
+set_layout(
+    struct FixedWidthText* fw,
+    int                    ncomp,
+    int                    nrows,
+    int                    ncols,
+    int                    precision)
+{
+    int digits;
+
+    if (nrows < 0 || ncols < 1)
+    {
+        fixed_problem(fw->fname, "invalid matrix shape");
+    }
+    if (precision < SHORTEST_PRECISION
+        || precision > PRINT_FORMAT_MAX_PRECISION)
+    {
+        fixed_problem(fw->fname, "precision out of range");
+    }
+    // shortest round-trip text has at most 17 significant digits
+    digits = precision == SHORTEST_PRECISION ? 16 : precision;
+    fw->ncomp = ncomp;
+    fw->nrows = nrows;
+    fw->ncols = ncols;
+    fw->precision = precision;
+    // leading space, sign, "d." and exponent up to "E-324"
+    fw->width = digits + 9;
+    // parentheses, second sign, "d.", exponent and "j"
+    if (ncomp == 2) fw->width = 2 * digits + 20;
+    fw->stride = (size_t) fw->width * ncols + 1;
+}
+
+/** Write fixed width text of one row in `out` with `stride` bytes */
+static void
+format_row(struct FixedWidthText* fw, const double* row, char* out)
+{
+    int   len, im_len;
+    char  re[FORMAT_DOUBLE_MIN_SPACE];
+    char  im[FORMAT_DOUBLE_MIN_SPACE];
+    char* field;
+
+    memset(out, ' ', fw->stride - 1);
+    out[fw->stride - 1] = '\n';
+    for (int j = 0; j < fw->ncols; j++)
+    {
+        field = out + (size_t) (j + 1) * fw->width;
+        if (fw->ncomp == 1)
+        {
+            len = format_double(row[j], fw->precision, '\0', 'E', re);
+            memcpy(field - len, re, len);
+            continue;
+        }
+        len = format_double(row[2 * j], fw->precision, '\0', 'E', re);
+        im_len = format_double(row[2 * j + 1], fw->precision, '+', 'E', im);
+        field -= len + im_len + 3;
+        field[0] = '(';
+        memcpy(field + 1, re, len);
+        memcpy(field + 1 + len, im, im_len);
+        memcpy(field + 1 + len + im_len, "j)", 2);
+    }
+}
+
+/** Skip spaces and parse one double, returning NULL if not found */
+static const char*
+scan_value(const char* pos, const char* end, double* x)
+{
+    int n;
+
+    while (pos < end && *pos == ' ') pos++;
+    n = parse_double(pos, end, x);
+    return n > 0 ? pos + n : NULL;
+}
+
+/** Parse one field of `width` characters of the fixed width text */
+static void
+parse_field(struct FixedWidthText* fw, const char* field, double* values)
+{
+    const char* pos;
+    const char* end;
+
+    end = field + fw->width;
+    if (fw->ncomp == 1)
+    {
+        if (scan_value(field, end, values) == NULL)
+        {
+            fixed_problem(fw->fname, "invalid real value");
+        }
+        return;
+    }
+    pos = field;
+    while (pos < end && *pos == ' ') pos++;
+    if (pos == end || *pos != '(') fixed_problem(fw->fname, "expected '('");
+    pos = scan_value(pos + 1, end, &values[0]);
+    if (pos != NULL) pos = scan_value(pos, end, &values[1]);
+    if (pos == NULL || end - pos < 2 || memcmp(pos, "j)", 2) != 0)
+    {
+        fixed_problem(fw->fname, "invalid complex value");
+    }
+}
+
+static void
+pread_exactly(struct FixedWidthText* fw, void* dest, size_t n, off_t offset)
+{
+    ssize_t got;
+    char*   p;
+
+    p = (char*) dest;
+    while (n > 0)
+    {
+        got = pread(fw->fd, p, n, offset);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) fixed_problem(fw->fname, "unexpected end of data");
+        p += got;
+        offset += got;
+        n -= got;
+    }
+}
+
+/** Write all bytes at `offset` returning 0 on success and -1 on failure */
+static int
+pwrite_all(int fd, const void* src, size_t n, off_t offset)
+{
+    ssize_t     put;
+    const char* p;
+
+    p = (const char*) src;
+    while (n > 0)
+    {
+        put = pwrite(fd, p, n, offset);
+        if (put < 0 && errno == EINTR) continue;
+        if (put <= 0) return -1;
+        p += put;
+        offset += put;
+        n -= put;
+    }
+    return 0;
+}
+
+static off_t
+row_offset(struct FixedWidthText* fw, int i)
+{
+    if (i < 0 || i >= fw->nrows) fixed_problem(fw->fname, "row out of range");
+    return FIXED_HEADER_SIZE + (off_t) i * fw->stride;
+}
+
+static char*
+alloc_lines(struct FixedWidthText* fw, size_t nlines)
+{
+    char* buf;
+
+    buf = (char*) malloc(nlines * fw->stride);
+    if (buf == NULL) fixed_problem(fw->fname, "no memory for text lines");
+    return buf;
+}
+
+static void*
+fixed_write_worker(void* arg)
+{
+    int                    block_rows, last;
+    char*                  buf;
+    const double*          row;
+    struct FixedWorker*    worker;
+    struct FixedWidthText* fw;
+
+    worker = (struct FixedWorker*) arg;
+    fw = worker->job->fw;
+    block_rows = FIXED_BLOCK_BYTES / fw->stride;
+    if (block_rows < 1) block_rows = 1;
+    buf = (char*) malloc((size_t) block_rows * fw->stride);
+    if (buf == NULL)
+    {
+        worker->failed = 1;
+        return NULL;
+    }
+    for (int i = worker->first_row; i < worker->last_row; i += block_rows)
+    {
+        last = i + block_rows;
+        if (last > worker->last_row) last = worker->last_row;
+        for (int k = i; k < last; k++)
+        {
+            if (worker->job->rows != NULL)
+            {
+                row = (const double*) worker->job->rows[k];
+            } else
+            {
+                row = worker->job->data
+                      + (size_t) k * worker->job->ld * fw->ncomp;
+            }
+            format_row(fw, row, buf + (size_t) (k - i) * fw->stride);
+        }
+        if (pwrite_all(
+                fw->fd,
+                buf,
+                (size_t) (last - i) * fw->stride,
+                FIXED_HEADER_SIZE + (off_t) i * fw->stride)
+            != 0)
+        {
+            worker->failed = 1;
+            break;
+        }
+    }
+    free(buf);
+    return NULL;
+}
+
+/** Write header line padded with spaces to `FIXED_HEADER_SIZE` bytes */
+static void
+write_header(struct FixedWidthText* fw)
+{
+    char header[FIXED_HEADER_SIZE + 1];
+    int  len;
+
+    len = snprintf(
+        header,
+        sizeof(header),
+        "%c fixed-width ncomp=%d nrows=%d ncols=%d precision=%d width=%d "
+        "stride=%zu",
+        active_comment_char(),
+        fw->ncomp,
+        fw->nrows,
+        fw->ncols,
+        fw->precision,
+        fw->width,
+        fw->stride);
+    if (len >= FIXED_HEADER_SIZE) fixed_problem(fw->fname, "header too long");
+    memset(header + len, ' ', FIXED_HEADER_SIZE - len);
+    header[FIXED_HEADER_SIZE - 1] = '\n';
+    if (pwrite_all(fw->fd, header, FIXED_HEADER_SIZE, 0) != 0)
+    {
+        fixed_problem(fw->fname, "failed writing header");
+    }
+}
+
+/** Join threads started, then close the file and free the pool */
+static void
+release_fixed_write(void* arg)
+{
+    struct FixedWrite* job;
+
+    job = (struct FixedWrite*) arg;
+    for (int t = 1; t < job->nthreads; t++)
+    {
+        pthread_join(job->threads[t], NULL);
+    }
+    if (job->fw->fd >= 0) close(job->fw->fd);
+    free(job->threads);
+    free(job->workers);
+}
+
+static void
+write_fixed(
+    char    fname[],
+    int     ncomp,
+    int     precision,
+    int     nrows,
+    int     ncols,
+    void**  rows,
+    double* data,
+    int     ld,
+    int     nthreads)
+{
+    int                   t, failed;
+    struct FixedWrite     job;
+    struct FixedWidthText fw;
+
+    fw.fname = fname;
+    set_layout(&fw, ncomp, nrows, ncols, precision);
+    fw.fd = open(fname, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fw.fd < 0) fixed_problem(fname, "failed to open");
+    job.fw = &fw;
+    job.rows = rows;
+    job.data = data;
+    job.ld = ld;
+    job.nthreads = 1;
+    job.threads = NULL;
+    job.workers = NULL;
+    io_cleanup_push(&job.cleanup, release_fixed_write, &job);
+    write_header(&fw);
+    if (ftruncate(fw.fd, FIXED_HEADER_SIZE + (off_t) nrows * fw.stride) != 0)
+    {
+        fixed_problem(fname, "failed to reserve space");
+    }
+    if (nthreads <= 0) nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (nthreads > nrows) nthreads = nrows;
+    if (nthreads < 1) nthreads = 1;
+    job.threads = (pthread_t*) malloc(nthreads * sizeof(pthread_t));
+    job.workers = (struct FixedWorker*) malloc(nthreads * sizeof(*job.workers));
+    if (job.threads == NULL || job.workers == NULL)
+    {
+        fixed_problem(fname, "no memory for writing threads");
+    }
+    for (t = 0; t < nthreads; t++)
+    {
+        job.workers[t].job = &job;
+        job.workers[t].first_row = (long) nrows * t / nthreads;
+        job.workers[t].last_row = (long) nrows * (t + 1) / nthreads;
+        job.workers[t].failed = 0;
+    }
+    for (t = 1; t < nthreads; t++)
+    {
+        if (pthread_create(
+                &job.threads[t], NULL, fixed_write_worker, &job.workers[t])
+            != 0)
+        {
+            break;
+        }
+        job.nthreads++;
+    }
+    // rows of threads that could not be started are written by the caller
+    fixed_write_worker(&job.workers[0]);
+    for (t = job.nthreads; t < nthreads; t++)
+    {
+        fixed_write_worker(&job.workers[t]);
+    }
+    for (t = 1; t < job.nthreads; t++) pthread_join(job.threads[t], NULL);
+    job.nthreads = 1;
+    failed = close(fw.fd) != 0;
+    fw.fd = -1;
+    for (t = 0; t < nthreads; t++) failed |= job.workers[t].failed;
+    if (failed) fixed_problem(fname, "failed writing rows");
+    io_cleanup_pop(&job.cleanup, 1);
+}
+
+void
+cmat_fixed_txt(
+    char             fname[],
+    int              precision,
+    int              nrows,
+    int              ncols,
+    double complex** mat,
+    int              nthreads)
+{
+    write_fixed(
+        fname, 2, precision, nrows, ncols, (void**) mat, NULL, 0, nthreads);
+}
+
+void
+rmat_fixed_txt(
+    char     fname[],
+    int      precision,
+    int      nrows,
+    int      ncols,
+    double** mat,
+    int      nthreads)
+{
+    write_fixed(
+        fname, 1, precision, nrows, ncols, (void**) mat, NULL, 0, nthreads);
+}
+
+void
+crowmajor_fixed_txt(
+    char            fname[],
+    int             precision,
+    int             nrows,
+    int             ncols,
+    int             ld,
+    double complex* mat,
+    int             nthreads)
+{
+    write_fixed(
+        fname,
+        2,
+        precision,
+        nrows,
+        ncols,
+        NULL,
+        (double*) mat,
+        ld,
+        nthreads);
+}
+
+void
+rrowmajor_fixed_txt(
+    char    fname[],
+    int     precision,
+    int     nrows,
+    int     ncols,
+    int     ld,
+    double* mat,
+    int     nthreads)
+{
+    write_fixed(fname, 1, precision, nrows, ncols, NULL, mat, ld, nthreads);
+}
+
+static void
+release_fixed_text(void* arg)
+{
+    fixed_txt_close((struct FixedWidthText*) arg);
+}
+
+void
+fixed_txt_open(struct FixedWidthText* fw, char fname[], int writable)
+{
+    int              ncomp, nrows, ncols, precision, width;
+    size_t           stride;
+    char             header[FIXED_HEADER_SIZE + 1];
+    struct stat      st;
+    struct IoCleanup cleanup;
+
+    fw->fname = strdup(fname);
+    fw->fd = open(fname, writable ? O_RDWR : O_RDONLY);
+    io_cleanup_push(&cleanup, release_fixed_text, fw);
+    if (fw->fname == NULL || fw->fd < 0 || fstat(fw->fd, &st) != 0)
+    {
+        fixed_problem(fname, "failed to open");
+    }
+    pread_exactly(fw, header, FIXED_HEADER_SIZE, 0);
+    header[FIXED_HEADER_SIZE] = '\0';
+    if (header[FIXED_HEADER_SIZE - 1] != '\n'
+        || sscanf(
+               header + 1,
+               " fixed-width ncomp=%d nrows=%d ncols=%d precision=%d "
+               "width=%d stride=%zu",
+               &ncomp,
+               &nrows,
+               &ncols,
+               &precision,
+               &width,
+               &stride)
+               != 6
+        || (ncomp != 1 && ncomp != 2))
+    {
+        fixed_problem(fname, "invalid header");
+    }
+    set_layout(fw, ncomp, nrows, ncols, precision);
+    if (fw->width != width || fw->stride != stride
+        || st.st_size < FIXED_HEADER_SIZE + (off_t) (nrows * stride))
+    {
+        fixed_problem(fname, "header inconsistent with the file");
+    }
+    io_cleanup_pop(&cleanup, 0);
+}
+
+static void
+read_row(struct FixedWidthText* fw, int ncomp, int i, double* row)
+{
+    char*            line;
+    struct IoCleanup cleanup;
+
+    if (ncomp != fw->ncomp) fixed_problem(fw->fname, "values of other kind");
+    line = alloc_lines(fw, 1);
+    io_cleanup_push(&cleanup, free, line);
+    pread_exactly(fw, line, fw->stride, row_offset(fw, i));
+    for (int j = 0; j < fw->ncols; j++)
+    {
+        parse_field(fw, line + (size_t) j * fw->width, row + j * ncomp);
+    }
+    io_cleanup_pop(&cleanup, 1);
+}
+
+void
+cfixed_row_read(struct FixedWidthText* fw, int i, double complex* row)
+{
+    read_row(fw, 2, i, (double*) row);
+}
+
+void
+rfixed_row_read(struct FixedWidthText* fw, int i, double* row)
+{
+    read_row(fw, 1, i, row);
+}
+
+static void
+read_value(struct FixedWidthText* fw, int ncomp, int i, int j, double* x)
+{
+    char field[FIXED_MAX_WIDTH];
+
+    if (ncomp != fw->ncomp) fixed_problem(fw->fname, "values of other kind");
+    if (j < 0 || j >= fw->ncols)
+    {
+        fixed_problem(fw->fname, "column out of range");
+    }
+    pread_exactly(
+        fw, field, fw->width, row_offset(fw, i) + (off_t) j * fw->width);
+    parse_field(fw, field, x);
+}
+
+double complex
+cfixed_value_read(struct FixedWidthText* fw, int i, int j)
+{
+    double x[2];
+    read_value(fw, 2, i, j, x);
+    return x[0] + I * x[1];
+}
+
+double
+rfixed_value_read(struct FixedWidthText* fw, int i, int j)
+{
+    double x;
+    read_value(fw, 1, i, j, &x);
+    return x;
+}
+
+static void
+write_row(struct FixedWidthText* fw, int ncomp, int i, const double* row)
+{
+    char*            line;
+    struct IoCleanup cleanup;
+
+    if (ncomp != fw->ncomp) fixed_problem(fw->fname, "values of other kind");
+    line = alloc_lines(fw, 1);
+    io_cleanup_push(&cleanup, free, line);
+    format_row(fw, row, line);
+    if (pwrite_all(fw->fd, line, fw->stride, row_offset(fw, i)) != 0)
+    {
+        fixed_problem(fw->fname, "failed rewriting row");
+    }
+    io_cleanup_pop(&cleanup, 1);
+}
+
+void
+cfixed_row_write(struct FixedWidthText* fw, int i, double complex* row)
+{
+    write_row(fw, 2, i, (const double*) row);
+}
+
+void
+rfixed_row_write(struct FixedWidthText* fw, int i, double* row)
+{
+    write_row(fw, 1, i, row);
+}
+
+void
+fixed_txt_close(struct FixedWidthText* fw)
+{
+    close(fw->fd);
+    free(fw->fname);
+    fw->fd = -1;
+    fw->fname = NULL;
+}
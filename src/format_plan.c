@@ -0,0 +1,43 @@
+#include "format_plan.h"
+#include "io_context.h"
+#include <stdlib.h>
+#include <string.h>
+
+void
+format_plan_compile(struct FormatPlan* plan, char fmt[])
+{
+    if (format_is_plan(fmt))
+    {
+        io_error("formatter is already a compiled plan");
+    }
+    memset(plan->magic, 0, sizeof(plan->magic));
+    strcpy(plan->magic, FORMAT_PLAN_MAGIC);
+    plan->source = strdup(fmt);
+    if (plan->source == NULL)
+    {
+        io_error("no memory to compile formatter %s", fmt);
+    }
+    plan->scan_supported = compile_scan_format(fmt, &plan->scan);
+    plan->print_supported = compile_print_format(fmt, &plan->print);
+}
+
+void
+format_plan_free(struct FormatPlan* plan)
+{
+    free(plan->source);
+    plan->source = NULL;
+    plan->magic[0] = '\0';
+}
+
+int
+format_is_plan(const char fmt[])
+{
+    return strncmp(fmt, FORMAT_PLAN_MAGIC, sizeof(FORMAT_PLAN_MAGIC)) == 0;
+}
+
+char*
+format_source(char fmt[])
+{
+    if (format_is_plan(fmt)) return ((struct FormatPlan*) fmt)->source;
+    return fmt;
+}
@@ -0,0 +1,147 @@
+#include "io_context.h"
+#include "compressed_stream.h"
+#include "file_handle.h"
+#include "text_printer.h"
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/** Context bound to each thread and the innermost run to recover, with
+ * the releases pushed by the thread and the first one of the run */
+static _Thread_local struct IoContext* bound_context = NULL;
+static _Thread_local struct IoContext* run_context = NULL;
+static _Thread_local jmp_buf*          recover_point = NULL;
+static _Thread_local struct IoCleanup* cleanup_top = NULL;
+static _Thread_local struct IoCleanup* run_cleanup = NULL;
+
+void
+io_context_init(struct IoContext* ctx)
+{
+    ctx->comment_char = comment_char;
+    ctx->printer_buffer_size = printer_buffer_size;
+    ctx->compression_level = compression_level;
+    ctx->error[0] = '\0';
+}
+
+void
+io_context_inherit(struct IoContext* ctx)
+{
+    if (bound_context != NULL)
+    {
+        *ctx = *bound_context;
+        ctx->error[0] = '\0';
+        return;
+    }
+    io_context_init(ctx);
+}
+
+void
+io_context_bind(struct IoContext* ctx)
+{
+    bound_context = ctx;
+}
+
+struct IoContext*
+io_context_current()
+{
+    return bound_context;
+}
+
+int
+io_context_run(struct IoContext* ctx, void (*task)(void*), void* arg)
+{
+    int                        status;
+    jmp_buf                    here;
+    struct IoContext* volatile previous_context;
+    struct IoContext* volatile previous_run;
+    jmp_buf* volatile          previous_point;
+    struct IoCleanup* volatile previous_cleanup;
+
+    previous_context = bound_context;
+    previous_run = run_context;
+    previous_point = recover_point;
+    previous_cleanup = run_cleanup;
+    bound_context = ctx;
+    run_context = ctx;
+    recover_point = &here;
+    run_cleanup = cleanup_top;
+    ctx->error[0] = '\0';
+    status = 0;
+    if (setjmp(here) == 0)
+    {
+        task(arg);
+    } else
+    {
+        status = -1;
+    }
+    bound_context = previous_context;
+    run_context = previous_run;
+    recover_point = previous_point;
+    run_cleanup = previous_cleanup;
+    return status;
+}
+
+void
+io_cleanup_push(struct IoCleanup* c, void (*release)(void*), void* arg)
+{
+    c->release = release;
+    c->arg = arg;
+    c->prev = cleanup_top;
+    cleanup_top = c;
+}
+
+void
+io_cleanup_pop(struct IoCleanup* c, int execute)
+{
+    cleanup_top = c->prev;
+    if (execute) c->release(c->arg);
+}
+
+char
+active_comment_char()
+{
+    if (bound_context != NULL) return bound_context->comment_char;
+    return comment_char;
+}
+
+size_t
+active_printer_buffer_size()
+{
+    if (bound_context != NULL) return bound_context->printer_buffer_size;
+    return printer_buffer_size;
+}
+
+int
+active_compression_level()
+{
+    if (bound_context != NULL) return bound_context->compression_level;
+    return compression_level;
+}
+
+void
+io_error(const char* fmt, ...)
+{
+    va_list           args;
+    struct IoCleanup* c;
+
+    va_start(args, fmt);
+    if (recover_point != NULL)
+    {
+        // the message may refer to resources about to be released
+        vsnprintf(run_context->error, IO_ERROR_SIZE, fmt, args);
+        va_end(args);
+        while (cleanup_top != run_cleanup)
+        {
+            c = cleanup_top;
+            cleanup_top = c->prev;
+            c->release(c->arg);
+        }
+        longjmp(*recover_point, 1);
+    }
+    printf("\n\nERROR: ");
+    vprintf(fmt, args);
+    printf("\n\n");
+    va_end(args);
+    exit(EXIT_FAILURE);
+}
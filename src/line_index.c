@@ -0,0 +1,286 @@
+#include "line_index.h"
+#include "file_handle.h"
+#include "io_context.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define LINE_INDEX_MAGIC 0x3158444E49494F44ULL /* "DIOINDX1" */
+
+static const unsigned int BUFF_SIZE = 4096;
+
+/** Layout of the index file header, followed by `nentries` offsets */
+struct LineIndexHeader
+{
+    uint64_t magic;
+    uint64_t comment_char;
+    uint64_t file_size;
+    int64_t  mtime_sec;
+    int64_t  mtime_nsec;
+    uint64_t stride;
+    uint64_t nlines;
+    uint64_t nentries;
+};
+
+static void
+index_fname(char fname[], char out[])
+{
+    snprintf(out, BUFF_SIZE, "%s%s", fname, LINE_INDEX_SUFFIX);
+}
+
+/** Read index header returning 1 only if it matches the data file */
+static int
+read_valid_header(char fname[], int fd, struct LineIndexHeader* header)
+{
+    struct stat info;
+
+    if (stat(fname, &info) != 0) return 0;
+    if (pread(fd, header, sizeof(*header), 0) != sizeof(*header)) return 0;
+    return header->magic == LINE_INDEX_MAGIC
+           && header->comment_char == (uint64_t) active_comment_char()
+           && header->file_size == (uint64_t) info.st_size
+           && header->mtime_sec == (int64_t) info.st_mtim.tv_sec
+           && header->mtime_nsec == (int64_t) info.st_mtim.tv_nsec
+           && header->stride > 0 && header->nentries > 0;
+}
+
+static void
+append_offset(struct LineIndex* idx, uint64_t offset, size_t* capacity)
+{
+    uint64_t* grown;
+
+    if (idx->nentries == *capacity)
+    {
+        grown = (uint64_t*) realloc(
+            idx->offsets, (2 * (*capacity) + 1024) * sizeof(uint64_t));
+        if (grown == NULL)
+        {
+            io_error("no memory for line index");
+        }
+        idx->offsets = grown;
+        *capacity = 2 * (*capacity) + 1024;
+    }
+    idx->offsets[idx->nentries++] = offset;
+}
+
+/** Fill index offsets from text in memory starting at `data_start` */
+static void
+index_text(
+    struct LineIndex* idx,
+    const char*       data,
+    const char*       data_start,
+    const char*       end,
+    size_t*           capacity)
+{
+    const char* pos;
+
+    pos = data_start;
+    while (pos < end)
+    {
+        if (idx->nlines % idx->stride == 0)
+        {
+            append_offset(idx, pos - data, capacity);
+        }
+        idx->nlines++;
+        pos = skip_next_line(pos, end);
+    }
+}
+
+static void
+release_offsets(void* arg)
+{
+    free(((struct LineIndex*) arg)->offsets);
+}
+
+static void
+release_mapping(void* arg)
+{
+    unmap_file((struct MappedFile*) arg);
+}
+
+static void
+close_file(void* arg)
+{
+    fclose((FILE*) arg);
+}
+
+void
+line_index_build(char fname[], int stride)
+{
+    int                    c, written;
+    size_t                 capacity;
+    uint64_t               offset;
+    char                   idx_fname[BUFF_SIZE], tmp_fname[BUFF_SIZE];
+    FILE*                  f;
+    struct stat            info;
+    struct MappedFile      mf;
+    struct LineIndex       idx;
+    struct LineIndexHeader header;
+    struct IoCleanup       cleanup;
+    struct IoCleanup       source_cleanup;
+
+    if (stride <= 0) stride = DEFAULT_LINE_INDEX_STRIDE;
+    if (stat(fname, &info) != 0)
+    {
+        io_error("impossible to index file %s", fname);
+    }
+    capacity = 0;
+    idx.stride = stride;
+    idx.nlines = 0;
+    idx.nentries = 0;
+    idx.offsets = NULL;
+    io_cleanup_push(&cleanup, release_offsets, &idx);
+    if (map_file(fname, &mf))
+    {
+        io_cleanup_push(&source_cleanup, release_mapping, &mf);
+        index_text(
+            &idx,
+            mf.data,
+            skip_comment_lines(mf.data, mf.data + mf.size, CURSOR_POSITION),
+            mf.data + mf.size,
+            &capacity);
+        io_cleanup_pop(&source_cleanup, 1);
+    } else
+    {
+        f = open_file(fname, "r");
+        io_cleanup_push(&source_cleanup, close_file, f);
+        jump_comment_lines(f, CURSOR_POSITION);
+        offset = ftell(f);
+        c = getc(f);
+        while (c != EOF)
+        {
+            if (idx.nlines % idx.stride == 0)
+            {
+                append_offset(&idx, offset, &capacity);
+            }
+            idx.nlines++;
+            while (c != EOF && c != '\n')
+            {
+                c = getc(f);
+                offset++;
+            }
+            if (c == '\n') c = getc(f);
+            offset++;
+        }
+        io_cleanup_pop(&source_cleanup, 1);
+    }
+    if (idx.nentries == 0) append_offset(&idx, info.st_size, &capacity);
+
+    header.magic = LINE_INDEX_MAGIC;
+    header.comment_char = active_comment_char();
+    header.file_size = info.st_size;
+    header.mtime_sec = info.st_mtim.tv_sec;
+    header.mtime_nsec = info.st_mtim.tv_nsec;
+    header.stride = idx.stride;
+    header.nlines = idx.nlines;
+    header.nentries = idx.nentries;
+    // write in temporary file first to never leave a partial index behind
+    index_fname(fname, idx_fname);
+    snprintf(tmp_fname, BUFF_SIZE, "%s.tmp", idx_fname);
+    f = open_file(tmp_fname, "wb");
+    written = fwrite(&header, sizeof(header), 1, f) == 1
+              && fwrite(idx.offsets, sizeof(uint64_t), idx.nentries, f)
+                     == idx.nentries;
+    if (fclose(f) != 0 || !written || rename(tmp_fname, idx_fname) != 0)
+    {
+        io_error("impossible to write index %s", idx_fname);
+    }
+    io_cleanup_pop(&cleanup, 1);
+}
+
+int
+line_index_load(char fname[], struct LineIndex* idx)
+{
+    int                    fd;
+    size_t                 nbytes;
+    char                   idx_fname[BUFF_SIZE];
+    struct LineIndexHeader header;
+
+    idx->offsets = NULL;
+    index_fname(fname, idx_fname);
+    fd = open(idx_fname, O_RDONLY);
+    if (fd < 0) return 0;
+    if (!read_valid_header(fname, fd, &header))
+    {
+        close(fd);
+        return 0;
+    }
+    nbytes = header.nentries * sizeof(uint64_t);
+    idx->offsets = (uint64_t*) malloc(nbytes);
+    if (idx->offsets == NULL
+        || pread(fd, idx->offsets, nbytes, sizeof(header)) != (ssize_t) nbytes)
+    {
+        free(idx->offsets);
+        idx->offsets = NULL;
+        close(fd);
+        return 0;
+    }
+    close(fd);
+    idx->file_size = header.file_size;
+    idx->mtime_sec = header.mtime_sec;
+    idx->mtime_nsec = header.mtime_nsec;
+    idx->stride = header.stride;
+    idx->nlines = header.nlines;
+    idx->nentries = header.nentries;
+    return 1;
+}
+
+int
+line_index_check(char fname[])
+{
+    int                    fd, valid;
+    char                   idx_fname[BUFF_SIZE];
+    struct LineIndexHeader header;
+
+    index_fname(fname, idx_fname);
+    fd = open(idx_fname, O_RDONLY);
+    if (fd < 0) return 0;
+    valid = read_valid_header(fname, fd, &header);
+    close(fd);
+    return valid;
+}
+
+void
+line_index_free(struct LineIndex* idx)
+{
+    free(idx->offsets);
+    idx->offsets = NULL;
+    idx->nentries = 0;
+}
+
+int
+line_index_seek(char fname[], int line, uint64_t* offset, int* remaining)
+{
+    int                    fd;
+    uint64_t               entry;
+    char                   idx_fname[BUFF_SIZE];
+    struct LineIndexHeader header;
+
+    index_fname(fname, idx_fname);
+    fd = open(idx_fname, O_RDONLY);
+    if (fd < 0) return 0;
+    if (!read_valid_header(fname, fd, &header))
+    {
+        close(fd);
+        return 0;
+    }
+    if (line < 1) line = 1;
+    entry = (line - 1) / header.stride;
+    if (entry >= header.nentries) entry = header.nentries - 1;
+    if (pread(
+            fd,
+            offset,
+            sizeof(uint64_t),
+            sizeof(header) + entry * sizeof(uint64_t))
+        != sizeof(uint64_t))
+    {
+        close(fd);
+        return 0;
+    }
+    close(fd);
+    *remaining = (line - 1) - entry * header.stride;
+    return 1;
+}
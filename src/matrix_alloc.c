@@ -0,0 +1,56 @@
+#include "matrix_alloc.h"
+#include "io_context.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+/** Single block with row pointers followed by aligned matrix values */
+static void**
+contiguous_alloc(int nrows, int ncols, size_t elem_size)
+{
+    size_t header;
+    char*  data;
+    void** rows;
+
+    header = nrows * sizeof(void*);
+    header = (header + MATRIX_ALIGNMENT - 1) / MATRIX_ALIGNMENT;
+    header *= MATRIX_ALIGNMENT;
+    if (posix_memalign(
+            (void**) &rows,
+            MATRIX_ALIGNMENT,
+            header + (size_t) nrows * ncols * elem_size)
+        != 0)
+    {
+        io_error("no memory for %d x %d matrix", nrows, ncols);
+    }
+    data = (char*) rows + header;
+    for (int i = 0; i < nrows; i++)
+    {
+        rows[i] = data + (size_t) i * ncols * elem_size;
+    }
+    return rows;
+}
+
+double**
+rmat_alloc(int nrows, int ncols)
+{
+    return (double**) contiguous_alloc(nrows, ncols, sizeof(double));
+}
+
+double complex**
+cmat_alloc(int nrows, int ncols)
+{
+    return (double complex**) contiguous_alloc(
+        nrows, ncols, sizeof(double complex));
+}
+
+void
+rmat_free(double** mat)
+{
+    free(mat);
+}
+
+void
+cmat_free(double complex** mat)
+{
+    free(mat);
+}
@@ -0,0 +1,708 @@
+#include "npy_io.h"
+#include "file_handle.h"
+#include "compressed_stream.h"
+#include "io_context.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/** Magic string starting every `.npy` file */
+#define NPY_MAGIC     "\x93NUMPY"
+#define NPY_MAGIC_LEN 6
+
+/** Total size of the header is padded to a multiple of this value */
+#define NPY_HEADER_ALIGN 64
+
+/** Maximum size of headers written, more than enough for 2 dimensions */
+#define NPY_HEADER_MAX 256
+
+/** Size reserved for headers of appendable files, fitting any row count */
+#define NPY_APPEND_HEADER 128
+
+static int
+host_is_big_endian()
+{
+    const uint16_t one = 1;
+    return *((const unsigned char*) &one) == 0;
+}
+
+static void
+swap_doubles(double* values, size_t n)
+{
+    uint64_t bits;
+
+    for (size_t k = 0; k < n; k++)
+    {
+        memcpy(&bits, &values[k], sizeof(bits));
+        bits = __builtin_bswap64(bits);
+        memcpy(&values[k], &bits, sizeof(bits));
+    }
+}
+
+static void
+npy_problem(char fname[], char info[])
+{
+    io_error("%s in npy file %s", info, fname);
+}
+
+static void
+close_file(void* arg)
+{
+    fclose((FILE*) arg);
+}
+
+static void
+read_exactly(FILE* f, char fname[], void* dest, size_t nbytes)
+{
+    if (fread(dest, 1, nbytes, f) != nbytes)
+    {
+        npy_problem(fname, "unexpected end of data");
+    }
+}
+
+static void
+write_exactly(FILE* f, char fname[], const void* src, size_t nbytes)
+{
+    if (fwrite(src, 1, nbytes, f) != nbytes)
+    {
+        npy_problem(fname, "failed writing data");
+    }
+}
+
+/** Value of `key` in the header dictionary, or NULL if not found */
+static const char*
+dict_value(const char* dict, const char* key)
+{
+    const char* pos;
+    size_t      key_len;
+
+    key_len = strlen(key);
+    for (pos = dict; (pos = strstr(pos, key)) != NULL; pos += key_len)
+    {
+        if (pos == dict || (pos[-1] != '\'' && pos[-1] != '"')) continue;
+        if (pos[key_len] != pos[-1]) continue;
+        pos += key_len + 1;
+        while (*pos == ' ') pos++;
+        if (*pos != ':') continue;
+        pos++;
+        while (*pos == ' ') pos++;
+        return pos;
+    }
+    return NULL;
+}
+
+static void
+parse_descr(char fname[], const char* value, struct NpyHeader* h)
+{
+    char order, kind;
+    int  size;
+
+    if (value == NULL || (*value != '\'' && *value != '"'))
+    {
+        npy_problem(fname, "missing descr");
+    }
+    order = value[1];
+    kind = value[2];
+    size = atoi(value + 3);
+    if (strchr("<>=|", order) == NULL)
+    {
+        npy_problem(fname, "unknown byte order");
+    }
+    if (kind == 'f' && size == 8)
+    {
+        h->ncomp = 1;
+    } else if (kind == 'c' && size == 16)
+    {
+        h->ncomp = 2;
+    } else
+    {
+        npy_problem(fname, "unsupported dtype, only f8 and c16 are");
+    }
+    h->swap_bytes = (order == '>' && !host_is_big_endian())
+                    || (order == '<' && host_is_big_endian());
+}
+
+static void
+parse_shape(char fname[], const char* value, struct NpyHeader* h)
+{
+    char* end;
+
+    if (value == NULL || *value != '(') npy_problem(fname, "missing shape");
+    value++;
+    h->ndim = 0;
+    h->nvalues = 1;
+    while (1)
+    {
+        while (*value == ' ' || *value == ',') value++;
+        if (*value == ')') break;
+        if (h->ndim == NPY_MAX_DIMS) npy_problem(fname, "too many dimensions");
+        h->shape[h->ndim] = strtoull(value, &end, 10);
+        if (end == value) npy_problem(fname, "invalid shape");
+        h->nvalues *= h->shape[h->ndim++];
+        value = end;
+    }
+}
+
+/** Read header of file at its beginning, leaving it at the values */
+static void
+read_header(FILE* f, char fname[], struct NpyHeader* h)
+{
+    int           len_bytes;
+    size_t        header_len;
+    unsigned char    prefix[NPY_MAGIC_LEN + 6];
+    char*            dict;
+    const char*      value;
+    struct IoCleanup cleanup;
+
+    read_exactly(f, fname, prefix, NPY_MAGIC_LEN + 4);
+    if (memcmp(prefix, NPY_MAGIC, NPY_MAGIC_LEN) != 0)
+    {
+        npy_problem(fname, "invalid magic string");
+    }
+    len_bytes = prefix[NPY_MAGIC_LEN] == 1 ? 2 : 4;
+    if (prefix[NPY_MAGIC_LEN] < 1 || prefix[NPY_MAGIC_LEN] > 3)
+    {
+        npy_problem(fname, "unsupported version");
+    }
+    if (len_bytes == 4)
+    {
+        read_exactly(f, fname, prefix + NPY_MAGIC_LEN + 4, 2);
+    }
+    header_len = 0;
+    for (int k = len_bytes - 1; k >= 0; k--)
+    {
+        header_len = 256 * header_len + prefix[NPY_MAGIC_LEN + 2 + k];
+    }
+    dict = (char*) malloc(header_len + 1);
+    if (dict == NULL) npy_problem(fname, "no memory for header");
+    io_cleanup_push(&cleanup, free, dict);
+    read_exactly(f, fname, dict, header_len);
+    dict[header_len] = '\0';
+    parse_descr(fname, dict_value(dict, "descr"), h);
+    value = dict_value(dict, "fortran_order");
+    if (value == NULL) npy_problem(fname, "missing fortran_order");
+    h->fortran_order = strncmp(value, "True", 4) == 0;
+    parse_shape(fname, dict_value(dict, "shape"), h);
+    h->data_offset = NPY_MAGIC_LEN + 2 + len_bytes + header_len;
+    io_cleanup_pop(&cleanup, 1);
+}
+
+void
+npy_header(char fname[], struct NpyHeader* h)
+{
+    FILE*            f;
+    struct IoCleanup cleanup;
+
+    f = open_file(fname, "rb");
+    io_cleanup_push(&cleanup, close_file, f);
+    read_header(f, fname, h);
+    io_cleanup_pop(&cleanup, 1);
+}
+
+/** Set version 1.0 header for C ordered array with 1 or 2 dimensions
+ *
+ * Values are always written in little-endian byte order. One-dimensional
+ * arrays have `ncols` values. The header is padded with spaces to at
+ * least `min_total` bytes
+ *
+ * \return total size of the header in bytes
+ */
+static int
+format_header(
+    char*  header,
+    int    ncomp,
+    int    ndim,
+    size_t nrows,
+    int    ncols,
+    int    min_total)
+{
+    int   dict_len, total;
+    char  shape[48];
+    char* dict;
+
+    if (ndim == 2)
+    {
+        snprintf(shape, sizeof(shape), "(%zu, %d)", nrows, ncols);
+    } else
+    {
+        snprintf(shape, sizeof(shape), "(%d,)", ncols);
+    }
+    dict = header + NPY_MAGIC_LEN + 4;
+    dict_len = snprintf(
+        dict,
+        NPY_HEADER_MAX - NPY_MAGIC_LEN - 4,
+        "{'descr': '<%s', 'fortran_order': False, 'shape': %s, }",
+        ncomp == 2 ? "c16" : "f8",
+        shape);
+    total = NPY_MAGIC_LEN + 4 + dict_len + 1;
+    if (total < min_total) total = min_total;
+    total += (NPY_HEADER_ALIGN - total % NPY_HEADER_ALIGN) % NPY_HEADER_ALIGN;
+    memset(dict + dict_len, ' ', total - NPY_MAGIC_LEN - 4 - dict_len);
+    header[total - 1] = '\n';
+    memcpy(header, NPY_MAGIC, NPY_MAGIC_LEN);
+    header[NPY_MAGIC_LEN] = 1;
+    header[NPY_MAGIC_LEN + 1] = 0;
+    header[NPY_MAGIC_LEN + 2] = (total - NPY_MAGIC_LEN - 4) & 0xFF;
+    header[NPY_MAGIC_LEN + 3] = (total - NPY_MAGIC_LEN - 4) >> 8;
+    return total;
+}
+
+/** Write header of array in file at current position */
+static void
+write_header(FILE* f, char fname[], int ncomp, int ndim, int nrows, int ncols)
+{
+    int  total;
+    char header[NPY_HEADER_MAX];
+
+    total = format_header(header, ncomp, ndim, nrows, ncols, 0);
+    write_exactly(f, fname, header, total);
+}
+
+/** Write matrix given by row pointers or contiguous storage
+ *
+ * Contiguous matrices are written in a single block, unless the bytes
+ * must be swapped on big-endian machines
+ */
+static void
+write_npy(
+    char    fname[],
+    int     ncomp,
+    int     ndim,
+    int     nrows,
+    int     ncols,
+    void**  rows,
+    double* data,
+    int     ld)
+{
+    size_t           row_len;
+    double*          row;
+    double*          swapped;
+    FILE*            f;
+    struct IoCleanup file_cleanup;
+    struct IoCleanup swap_cleanup;
+
+    f = open_file(fname, "wb");
+    io_cleanup_push(&file_cleanup, close_file, f);
+    write_header(f, fname, ncomp, ndim, nrows, ncols);
+    row_len = (size_t) ncols * ncomp;
+    swapped = NULL;
+    if (host_is_big_endian())
+    {
+        swapped = (double*) malloc(row_len * sizeof(double) + 1);
+        if (swapped == NULL) npy_problem(fname, "no memory to swap bytes");
+    }
+    io_cleanup_push(&swap_cleanup, free, swapped);
+    if (data != NULL && ld == ncols && swapped == NULL)
+    {
+        write_exactly(f, fname, data, nrows * row_len * sizeof(double));
+        nrows = 0;
+    }
+    for (int i = 0; i < nrows; i++)
+    {
+        if (rows != NULL)
+        {
+            row = (double*) rows[i];
+        } else
+        {
+            row = data + (size_t) i * ld * ncomp;
+        }
+        if (swapped != NULL)
+        {
+            memcpy(swapped, row, row_len * sizeof(double));
+            swap_doubles(swapped, row_len);
+            row = swapped;
+        }
+        write_exactly(f, fname, row, row_len * sizeof(double));
+    }
+    io_cleanup_pop(&swap_cleanup, 1);
+    io_cleanup_pop(&file_cleanup, 1);
+}
+
+void
+carr_npy(char fname[], int arr_size, double complex* arr)
+{
+    write_npy(fname, 2, 1, 1, arr_size, NULL, (double*) arr, arr_size);
+}
+
+void
+rarr_npy(char fname[], int arr_size, double* arr)
+{
+    write_npy(fname, 1, 1, 1, arr_size, NULL, arr, arr_size);
+}
+
+void
+cmat_npy(char fname[], int nrows, int ncols, double complex** mat)
+{
+    write_npy(fname, 2, 2, nrows, ncols, (void**) mat, NULL, 0);
+}
+
+void
+rmat_npy(char fname[], int nrows, int ncols, double** mat)
+{
+    write_npy(fname, 1, 2, nrows, ncols, (void**) mat, NULL, 0);
+}
+
+void
+crowmajor_npy(char fname[], int nrows, int ncols, int ld, double complex* mat)
+{
+    write_npy(fname, 2, 2, nrows, ncols, NULL, (double*) mat, ld);
+}
+
+void
+rrowmajor_npy(char fname[], int nrows, int ncols, int ld, double* mat)
+{
+    write_npy(fname, 1, 2, nrows, ncols, NULL, mat, ld);
+}
+
+/** Rearrange values in Fortran order `src` to C order in `dest` */
+static void
+fortran_to_c(struct NpyHeader* h, const double* src, double* dest)
+{
+    int    d, ncomp;
+    size_t c_index;
+    size_t index[NPY_MAX_DIMS];
+    size_t c_strides[NPY_MAX_DIMS];
+
+    ncomp = h->ncomp;
+    for (d = h->ndim - 1; d >= 0; d--)
+    {
+        index[d] = 0;
+        c_strides[d] = 1;
+        if (d < h->ndim - 1) c_strides[d] = c_strides[d + 1] * h->shape[d + 1];
+    }
+    c_index = 0;
+    for (size_t k = 0; k < h->nvalues; k++)
+    {
+        memcpy(dest + c_index * ncomp, src + k * ncomp, ncomp * sizeof(double));
+        for (d = 0; d < h->ndim; d++)
+        {
+            c_index += c_strides[d];
+            if (++index[d] < h->shape[d]) break;
+            c_index -= index[d] * c_strides[d];
+            index[d] = 0;
+        }
+    }
+}
+
+/** Read all values of file at the data position in C order to `dest` */
+static void
+read_values(FILE* f, char fname[], struct NpyHeader* h, double* dest)
+{
+    size_t           n;
+    double*          src;
+    struct IoCleanup cleanup;
+
+    n = h->nvalues * h->ncomp;
+    src = dest;
+    if (h->fortran_order && h->ndim > 1)
+    {
+        src = (double*) malloc(n * sizeof(double) + 1);
+        if (src == NULL) npy_problem(fname, "no memory to reorder values");
+        io_cleanup_push(&cleanup, free, src);
+    }
+    read_exactly(f, fname, src, n * sizeof(double));
+    if (h->swap_bytes) swap_doubles(src, n);
+    if (src != dest)
+    {
+        fortran_to_c(h, src, dest);
+        io_cleanup_pop(&cleanup, 1);
+    }
+}
+
+static void
+check_kind(char fname[], struct NpyHeader* h, int ncomp)
+{
+    if (h->ncomp != ncomp)
+    {
+        npy_problem(
+            fname,
+            ncomp == 2 ? "expected complex values" : "expected real values");
+    }
+}
+
+/** Read matrix to row pointers or contiguous storage
+ *
+ * One-dimensional arrays are accepted as a single column, and any shape
+ * is accepted if `any_shape` is set, as long as the sizes match
+ */
+static void
+read_npy(
+    char    fname[],
+    int     ncomp,
+    int     any_shape,
+    int     nrows,
+    int     ncols,
+    void**  rows,
+    double* data,
+    int     ld)
+{
+    int              same_shape;
+    size_t           row_len;
+    double*          values;
+    FILE*            f;
+    struct NpyHeader h;
+    struct IoCleanup file_cleanup;
+    struct IoCleanup values_cleanup;
+
+    f = open_file(fname, "rb");
+    io_cleanup_push(&file_cleanup, close_file, f);
+    read_header(f, fname, &h);
+    check_kind(fname, &h, ncomp);
+    same_shape = (h.ndim == 2 && h.shape[0] == (size_t) nrows
+                  && h.shape[1] == (size_t) ncols)
+                 || (h.ndim == 1 && ncols == 1
+                     && h.shape[0] == (size_t) nrows);
+    if (h.nvalues != (size_t) nrows * ncols || (!any_shape && !same_shape))
+    {
+        npy_problem(fname, "shape different from the one requested");
+    }
+    if (rows == NULL && ld == ncols)
+    {
+        read_values(f, fname, &h, data);
+        io_cleanup_pop(&file_cleanup, 1);
+        return;
+    }
+    values = (double*) malloc(h.nvalues * ncomp * sizeof(double) + 1);
+    if (values == NULL) npy_problem(fname, "no memory to read values");
+    io_cleanup_push(&values_cleanup, free, values);
+    read_values(f, fname, &h, values);
+    io_cleanup_pop(&values_cleanup, 0);
+    io_cleanup_pop(&file_cleanup, 1);
+    row_len = (size_t) ncols * ncomp;
+    for (int i = 0; i < nrows; i++)
+    {
+        memcpy(
+            rows != NULL ? (double*) rows[i] : data + (size_t) i * ld * ncomp,
+            values + i * row_len,
+            row_len * sizeof(double));
+    }
+    free(values);
+}
+
+void
+carr_npy_read(char fname[], int arr_size, double complex* arr)
+{
+    read_npy(fname, 2, 1, 1, arr_size, NULL, (double*) arr, arr_size);
+}
+
+void
+rarr_npy_read(char fname[], int arr_size, double* arr)
+{
+    read_npy(fname, 1, 1, 1, arr_size, NULL, arr, arr_size);
+}
+
+void
+cmat_npy_read(char fname[], int nrows, int ncols, double complex** mat)
+{
+    read_npy(fname, 2, 0, nrows, ncols, (void**) mat, NULL, 0);
+}
+
+void
+rmat_npy_read(char fname[], int nrows, int ncols, double** mat)
+{
+    read_npy(fname, 1, 0, nrows, ncols, (void**) mat, NULL, 0);
+}
+
+void
+crowmajor_npy_read(
+    char fname[], int nrows, int ncols, int ld, double complex* mat)
+{
+    read_npy(fname, 2, 0, nrows, ncols, NULL, (double*) mat, ld);
+}
+
+void
+rrowmajor_npy_read(char fname[], int nrows, int ncols, int ld, double* mat)
+{
+    read_npy(fname, 1, 0, nrows, ncols, NULL, mat, ld);
+}
+
+/** Load matrix of any shape with up to two dimensions */
+static double*
+mat_npy_load(char fname[], int ncomp, int* nrows, int* ncols)
+{
+    double*          values;
+    FILE*            f;
+    struct NpyHeader h;
+    struct IoCleanup file_cleanup;
+    struct IoCleanup values_cleanup;
+
+    f = open_file(fname, "rb");
+    io_cleanup_push(&file_cleanup, close_file, f);
+    read_header(f, fname, &h);
+    check_kind(fname, &h, ncomp);
+    if (h.ndim > 2) npy_problem(fname, "more than 2 dimensions");
+    *nrows = h.ndim > 0 ? h.shape[0] : 1;
+    *ncols = h.ndim > 1 ? h.shape[1] : 1;
+    values = (double*) malloc(h.nvalues * ncomp * sizeof(double) + 1);
+    if (values == NULL) npy_problem(fname, "no memory to load values");
+    io_cleanup_push(&values_cleanup, free, values);
+    read_values(f, fname, &h, values);
+    io_cleanup_pop(&values_cleanup, 0);
+    io_cleanup_pop(&file_cleanup, 1);
+    return values;
+}
+
+double complex*
+cmat_npy_load(char fname[], int* nrows, int* ncols)
+{
+    return (double complex*) mat_npy_load(fname, 2, nrows, ncols);
+}
+
+double*
+rmat_npy_load(char fname[], int* nrows, int* ncols)
+{
+    return mat_npy_load(fname, 1, nrows, ncols);
+}
+
+static void
+release_appender(void* arg)
+{
+    struct NpyAppender* a;
+
+    a = (struct NpyAppender*) arg;
+    if (a->f != NULL) fclose(a->f);
+    free(a->fname);
+    free(a->swapped);
+}
+
+/** Open appendable file reserving header space for any number of rows */
+static void
+npy_append_open(struct NpyAppender* a, char fname[], int ncomp, int ncols)
+{
+    char             header[NPY_HEADER_MAX];
+    struct IoCleanup cleanup;
+
+    if (compression_from_name(fname) != NO_COMPRESSION)
+    {
+        npy_problem(fname, "header cannot be rewritten in compressed file");
+    }
+    if (ncols < 1) npy_problem(fname, "rows without values to append");
+    a->fname = strdup(fname);
+    a->f = fopen(fname, "wb");
+    a->swapped = NULL;
+    io_cleanup_push(&cleanup, release_appender, a);
+    if (a->fname == NULL || a->f == NULL)
+    {
+        npy_problem(fname, "failed to open appendable file");
+    }
+    a->ncomp = ncomp;
+    a->ncols = ncols;
+    a->nrows = 0;
+    a->flushed_rows = 0;
+    if (host_is_big_endian())
+    {
+        a->swapped = (double*) malloc(ncols * ncomp * sizeof(double));
+        if (a->swapped == NULL) npy_problem(fname, "no memory to swap bytes");
+    }
+    a->header_len =
+        format_header(header, ncomp, 2, 0, ncols, NPY_APPEND_HEADER);
+    write_exactly(a->f, a->fname, header, a->header_len);
+    io_cleanup_pop(&cleanup, 0);
+}
+
+void
+cnpy_append_open(struct NpyAppender* a, char fname[], int ncols)
+{
+    npy_append_open(a, fname, 2, ncols);
+}
+
+void
+rnpy_append_open(struct NpyAppender* a, char fname[], int ncols)
+{
+    npy_append_open(a, fname, 1, ncols);
+}
+
+/** Append rows in contiguous storage at the end of the data */
+static void
+npy_append_rows(
+    struct NpyAppender* a, int ncomp, int nrows, int ld, double* data)
+{
+    size_t  row_len;
+    double* row;
+
+    if (ncomp != a->ncomp)
+    {
+        npy_problem(a->fname, "values of other kind appended");
+    }
+    row_len = (size_t) a->ncols * ncomp;
+    if (ld == a->ncols && a->swapped == NULL)
+    {
+        write_exactly(
+            a->f, a->fname, data, nrows * row_len * sizeof(double));
+        a->nrows += nrows;
+        return;
+    }
+    for (int i = 0; i < nrows; i++)
+    {
+        row = data + (size_t) i * ld * ncomp;
+        if (a->swapped != NULL)
+        {
+            memcpy(a->swapped, row, row_len * sizeof(double));
+            swap_doubles(a->swapped, row_len);
+            row = a->swapped;
+        }
+        write_exactly(a->f, a->fname, row, row_len * sizeof(double));
+    }
+    a->nrows += nrows;
+}
+
+void
+carr_npy_append(struct NpyAppender* a, double complex* row)
+{
+    npy_append_rows(a, 2, 1, a->ncols, (double*) row);
+}
+
+void
+rarr_npy_append(struct NpyAppender* a, double* row)
+{
+    npy_append_rows(a, 1, 1, a->ncols, row);
+}
+
+void
+crowmajor_npy_append(
+    struct NpyAppender* a, int nrows, int ld, double complex* mat)
+{
+    npy_append_rows(a, 2, nrows, ld, (double*) mat);
+}
+
+void
+rrowmajor_npy_append(struct NpyAppender* a, int nrows, int ld, double* mat)
+{
+    npy_append_rows(a, 1, nrows, ld, mat);
+}
+
+void
+npy_append_flush(struct NpyAppender* a)
+{
+    int  fd, total;
+    char header[NPY_HEADER_MAX];
+
+    if (fflush(a->f) != 0) npy_problem(a->fname, "failed writing data");
+    if (a->nrows == a->flushed_rows) return;
+    fd = fileno(a->f);
+    if (fdatasync(fd) != 0) npy_problem(a->fname, "failed syncing data");
+    total = format_header(
+        header, a->ncomp, 2, a->nrows, a->ncols, NPY_APPEND_HEADER);
+    if (total != a->header_len
+        || pwrite(fd, header, total, 0) != (ssize_t) total)
+    {
+        npy_problem(a->fname, "failed rewriting header");
+    }
+    if (fdatasync(fd) != 0) npy_problem(a->fname, "failed syncing header");
+    a->flushed_rows = a->nrows;
+}
+
+void
+npy_append_close(struct NpyAppender* a)
+{
+    if (a->f == NULL) return;
+    npy_append_flush(a);
+    fclose(a->f);
+    free(a->fname);
+    free(a->swapped);
+    a->f = NULL;
+    a->fname = NULL;
+    a->swapped = NULL;
+}
@@ -1,4 +1,5 @@
 #include "screen_print.h"
+#include "io_context.h"
 #include <stdio.h>
 #include <stdlib.h>
 
@@ -47,9 +48,9 @@ rarr_print(int arr_size, double* arr, int compact_threshold, int tail_size)
     // print first and last `tail_size` elements for long arrays
     if (tail_size > arr_size)
     {
-        printf("\n\nERROR: tail size to print is larger than array size: ");
-        printf("Exiting in function rarr_print\n\n");
-        exit(EXIT_FAILURE);
+        io_error(
+            "tail size to print is larger than array size: "
+            "Exiting in function rarr_print");
     }
     for (i = 0; i < tail_size; i++)
     {
@@ -88,9 +89,9 @@ carr_print(
     // print first and last `tail_size` elements for long arrays
     if (tail_size > arr_size)
     {
-        printf("\n\nERROR: tail size to print is larger than array size: ");
-        printf("Exiting in function carr_print\n\n");
-        exit(EXIT_FAILURE);
+        io_error(
+            "tail size to print is larger than array size: "
+            "Exiting in function carr_print");
     }
     for (i = 0; i < tail_size; i++)
     {
@@ -0,0 +1,782 @@
+#define _GNU_SOURCE
+#include "text_printer.h"
+#include "format_plan.h"
+#include "text_scanner.h"
+#include "io_context.h"
+#include <errno.h>
+#include <locale.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#define POW10_MIN_EXP10     (-350)
+#define POW10_MAX_EXP10     350
+#define POW10_COUNT         (POW10_MAX_EXP10 - POW10_MIN_EXP10 + 1)
+#define BIGNUM_LIMBS        40
+#define BIGNUM_DIV_BITS     1200
+#define MAX_EXACT_PRECISION 17
+#define MAX_SHORT_PRECISION 16
+#define PRINTER_DIRECT_SIZE (1 << 16)
+#define PRINTER_MIN_SPACE \
+    (PRINT_FORMAT_MAX_TEXT + 2 * FORMAT_DOUBLE_MIN_SPACE)
+
+/** Power of ten approximated by 128-bit significand `hi:lo` times 2^exp2
+ *
+ * The significand is truncated, thus never above the exact power
+ */
+struct PowerOfTen
+{
+    uint64_t hi;
+    uint64_t lo;
+    int      exp2;
+};
+
+size_t printer_buffer_size = DEFAULT_PRINTER_BUFFER_SIZE;
+
+static struct PowerOfTen powers_of_ten[POW10_COUNT];
+static locale_t          c_locale = (locale_t) 0;
+static pthread_once_t    printer_tables_once = PTHREAD_ONCE_INIT;
+
+static const double exact_powers_of_ten[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+static const uint64_t exact_integer_powers_of_ten[] = {
+    1ULL,
+    10ULL,
+    100ULL,
+    1000ULL,
+    10000ULL,
+    100000ULL,
+    1000000ULL,
+    10000000ULL,
+    100000000ULL,
+    1000000000ULL,
+    10000000000ULL,
+    100000000000ULL,
+    1000000000000ULL,
+    10000000000000ULL,
+    100000000000000ULL,
+    1000000000000000ULL,
+    10000000000000000ULL,
+    100000000000000000ULL,
+    1000000000000000000ULL};
+
+static int
+bignum_bit_length(const uint32_t* x)
+{
+    for (int i = BIGNUM_LIMBS - 1; i >= 0; i--)
+    {
+        if (x[i] != 0) return 32 * i + 32 - __builtin_clz(x[i]);
+    }
+    return 0;
+}
+
+/** Set significand of power of ten with the 128 leading bits of `x` */
+static void
+bignum_leading_bits(const uint32_t* x, int nbits, struct PowerOfTen* power)
+{
+    int bit;
+
+    power->hi = 0;
+    power->lo = 0;
+    for (int k = 0; k < 128; k++)
+    {
+        bit = nbits - 1 - k;
+        power->hi = power->hi << 1 | power->lo >> 63;
+        power->lo <<= 1;
+        if (bit >= 0) power->lo |= (x[bit / 32] >> (bit % 32)) & 1;
+    }
+}
+
+/** Compute the table of powers of ten with exact big integer arithmetic
+ *
+ * Positive powers are 5^q 2^q and negative ones 2^(-q-M) (2^M / 5^q),
+ * where the big numbers are built multiplying or dividing by 5
+ */
+static void
+init_printer_tables()
+{
+    int                nbits;
+    uint32_t           x[BIGNUM_LIMBS];
+    uint64_t           carry, remainder;
+    struct PowerOfTen* power;
+
+    memset(x, 0, sizeof(x));
+    x[0] = 1;
+    for (int q = 0; q <= POW10_MAX_EXP10; q++)
+    {
+        nbits = bignum_bit_length(x);
+        power = &powers_of_ten[q - POW10_MIN_EXP10];
+        bignum_leading_bits(x, nbits, power);
+        power->exp2 = q + nbits - 128;
+        carry = 0;
+        for (int i = 0; i < BIGNUM_LIMBS; i++)
+        {
+            carry += (uint64_t) x[i] * 5;
+            x[i] = (uint32_t) carry;
+            carry >>= 32;
+        }
+    }
+
+    memset(x, 0, sizeof(x));
+    x[BIGNUM_DIV_BITS / 32] = 1U << (BIGNUM_DIV_BITS % 32);
+    for (int q = 1; q <= -POW10_MIN_EXP10; q++)
+    {
+        remainder = 0;
+        for (int i = BIGNUM_LIMBS - 1; i >= 0; i--)
+        {
+            remainder = remainder << 32 | x[i];
+            x[i] = (uint32_t) (remainder / 5);
+            remainder %= 5;
+        }
+        nbits = bignum_bit_length(x);
+        power = &powers_of_ten[-q - POW10_MIN_EXP10];
+        bignum_leading_bits(x, nbits, power);
+        power->exp2 = -q - BIGNUM_DIV_BITS + nbits - 128;
+    }
+
+    c_locale = newlocale(LC_ALL_MASK, "C", (locale_t) 0);
+    if (c_locale == (locale_t) 0)
+    {
+        io_error("impossible to create C locale for printing");
+    }
+}
+
+/** Round positive finite `x` to `precision + 1` significant digits
+ *
+ * Multiply the significand of `x` by the truncated power of ten that
+ * brings the leading digit to the units place of `precision` and keep
+ * the upper 128 bits of the product, which are below the exact ones by
+ * less than 2. Return 0 without setting `digits` and `exp10` whenever
+ * this error could affect the rounding, including exact ties
+ */
+static int
+round_decimal(double x, int precision, uint64_t* digits, int* exp10)
+{
+    int                      exp2, q, k, shift;
+    uint64_t                 bits, mantissa, n, lower;
+    unsigned __int128        product_lo, product_hi, rest, half;
+    const struct PowerOfTen* power;
+
+    memcpy(&bits, &x, sizeof(double));
+    mantissa = bits & 0x000FFFFFFFFFFFFFULL;
+    exp2 = (bits >> 52) & 0x7FF;
+    if (exp2 == 0)
+    {
+        exp2 = -1074;
+    } else
+    {
+        mantissa |= 1ULL << 52;
+        exp2 -= 1075;
+    }
+    // estimate of the decimal exponent wrong by at most one
+    k = ((exp2 + 63 - __builtin_clzll(mantissa)) * 78913) >> 18;
+    lower = exact_integer_powers_of_ten[precision];
+    for (int attempt = 0; attempt < 3; attempt++)
+    {
+        q = precision - k;
+        if (q < POW10_MIN_EXP10 || q > POW10_MAX_EXP10) return 0;
+        power = &powers_of_ten[q - POW10_MIN_EXP10];
+        product_lo = (unsigned __int128) mantissa * power->lo;
+        product_hi = (unsigned __int128) mantissa * power->hi
+                     + (uint64_t) (product_lo >> 64);
+        shift = -(64 + exp2 + power->exp2);
+        if (shift < 8 || shift > 120) return 0;
+        n = (uint64_t) (product_hi >> shift);
+        if (n < lower)
+        {
+            k--;
+            continue;
+        }
+        if (n >= 10 * lower)
+        {
+            k++;
+            continue;
+        }
+        rest = product_hi & (((unsigned __int128) 1 << shift) - 1);
+        half = (unsigned __int128) 1 << (shift - 1);
+        if (rest > half)
+        {
+            n++;
+        } else if (rest + 2 > half)
+        {
+            return 0;
+        }
+        if (n == 10 * lower)
+        {
+            n = lower;
+            k++;
+        }
+        *digits = n;
+        *exp10 = k;
+        return 1;
+    }
+    return 0;
+}
+
+static const char digit_pairs[] = "00010203040506070809"
+                                  "10111213141516171819"
+                                  "20212223242526272829"
+                                  "30313233343536373839"
+                                  "40414243444546474849"
+                                  "50515253545556575859"
+                                  "60616263646566676869"
+                                  "70717273747576777879"
+                                  "80818283848586878889"
+                                  "90919293949596979899";
+
+/** Write the last `ndigits` decimal digits of `n` just before `end` */
+static void
+write_digits(char* end, uint64_t n, int ndigits)
+{
+    uint32_t part;
+
+    while (ndigits >= 8)
+    {
+        part = n % 100000000;
+        n /= 100000000;
+        for (int i = 0; i < 4; i++)
+        {
+            end -= 2;
+            memcpy(end, &digit_pairs[2 * (part % 100)], 2);
+            part /= 100;
+        }
+        ndigits -= 8;
+    }
+    part = (uint32_t) n;
+    for (; ndigits >= 2; ndigits -= 2)
+    {
+        end -= 2;
+        memcpy(end, &digit_pairs[2 * (part % 100)], 2);
+        part /= 100;
+    }
+    if (ndigits > 0) *--end = '0' + part % 10;
+}
+
+/** Write digits in exponential notation as printf `%E` does */
+static int
+write_exponential(
+    char*    out,
+    int      negative,
+    char     sign,
+    uint64_t digits,
+    int      precision,
+    int      exp10,
+    char     exp_char)
+{
+    char* pos;
+
+    pos = out;
+    if (negative)
+    {
+        *pos++ = '-';
+    } else if (sign != '\0')
+    {
+        *pos++ = sign;
+    }
+    // all digits are written one place ahead and the first moved back
+    write_digits(pos + precision + 2, digits, precision + 1);
+    pos[0] = pos[1];
+    if (precision > 0)
+    {
+        pos[1] = '.';
+        pos += precision + 2;
+    } else
+    {
+        pos++;
+    }
+    *pos++ = exp_char;
+    if (exp10 < 0)
+    {
+        *pos++ = '-';
+        exp10 = -exp10;
+    } else
+    {
+        *pos++ = '+';
+    }
+    if (exp10 >= 100)
+    {
+        *pos++ = '0' + exp10 / 100;
+        exp10 %= 100;
+    }
+    memcpy(pos, &digit_pairs[2 * exp10], 2);
+    return pos + 2 - out;
+}
+
+static int
+format_exponential(
+    double x, int precision, char sign, char exp_char, char* out)
+{
+    int      exp10, len;
+    uint64_t digits;
+    char     spec[8];
+    locale_t previous;
+
+    pthread_once(&printer_tables_once, init_printer_tables);
+    if (isfinite(x) && precision <= MAX_EXACT_PRECISION)
+    {
+        if (x == 0)
+        {
+            return write_exponential(
+                out, signbit(x), sign, 0, precision, 0, exp_char);
+        }
+        if (round_decimal(fabs(x), precision, &digits, &exp10))
+        {
+            return write_exponential(
+                out, signbit(x), sign, digits, precision, exp10, exp_char);
+        }
+    }
+    // infinity, nan, large precision or rounding undecided above
+    len = 0;
+    spec[len++] = '%';
+    if (sign != '\0') spec[len++] = sign;
+    spec[len++] = '.';
+    spec[len++] = '*';
+    spec[len++] = exp_char;
+    spec[len] = '\0';
+    previous = uselocale(c_locale);
+    len = snprintf(out, FORMAT_DOUBLE_MIN_SPACE, spec, precision, x);
+    uselocale(previous);
+    return len;
+}
+
+/** Check if `precision + 1` digits are enough to read back positive `x`
+ *
+ * When the digits and the power of ten are exact doubles, a single
+ * multiplication or division is correctly rounded and no text is needed
+ */
+static int
+round_trips(double x, int precision)
+{
+    int      exp10, len;
+    uint64_t digits;
+    double   y;
+    char     text[FORMAT_DOUBLE_MIN_SPACE];
+
+    if (round_decimal(x, precision, &digits, &exp10)
+        && digits <= (1ULL << 53))
+    {
+        exp10 -= precision;
+        if (exp10 >= 0 && exp10 <= 22)
+        {
+            return (double) digits * exact_powers_of_ten[exp10] == x;
+        }
+        if (exp10 < 0 && exp10 >= -22)
+        {
+            return (double) digits / exact_powers_of_ten[-exp10] == x;
+        }
+    }
+    len = format_exponential(x, precision, '\0', 'E', text);
+    return parse_double(text, text + len, &y) == len && y == x;
+}
+
+/** Exponential notation with least digits, as 17 always round-trip
+ *
+ * Numbers with random digits mostly need 16 or 17 digits, thus a few
+ * precisions are tried downwards before a binary search for short ones
+ */
+static int
+format_shortest(double x, char sign, char exp_char, char* out)
+{
+    int lo, hi, mid;
+
+    if (!isfinite(x) || x == 0)
+    {
+        return format_exponential(x, 0, sign, exp_char, out);
+    }
+    pthread_once(&printer_tables_once, init_printer_tables);
+    lo = MAX_SHORT_PRECISION - 4;
+    hi = MAX_SHORT_PRECISION;
+    while (hi - 1 > lo && round_trips(fabs(x), hi - 1)) hi--;
+    lo = hi - 1 == lo ? -1 : hi - 1;
+    while (hi - lo > 1)
+    {
+        mid = (lo + hi) / 2;
+        if (round_trips(fabs(x), mid))
+        {
+            hi = mid;
+        } else
+        {
+            lo = mid;
+        }
+    }
+    return format_exponential(x, hi, sign, exp_char, out);
+}
+
+int
+format_double(double x, int precision, char sign, char exp_char, char* out)
+{
+    if (precision < 0) return format_shortest(x, sign, exp_char, out);
+    return format_exponential(x, precision, sign, exp_char, out);
+}
+
+int
+compile_print_format(char fmt[], struct PrintFormat* plan)
+{
+    int                n, ntext, precision;
+    char               sign, conversion;
+    struct FormatPlan* compiled;
+
+    if (format_is_plan(fmt))
+    {
+        compiled = (struct FormatPlan*) fmt;
+        *plan = compiled->print;
+        return compiled->print_supported;
+    }
+    plan->npieces = 0;
+    plan->nvalues = 0;
+    ntext = 0;
+    for (int i = 0; fmt[i] != '\0';)
+    {
+        if (fmt[i] != '%' || fmt[i + 1] == '%')
+        {
+            if (ntext == PRINT_FORMAT_MAX_TEXT) return 0;
+            n = plan->npieces - 1;
+            if (n < 0 || plan->kinds[n] != PRINT_LITERAL)
+            {
+                if (plan->npieces == PRINT_FORMAT_MAX_PIECES) return 0;
+                n = plan->npieces++;
+                plan->kinds[n] = PRINT_LITERAL;
+                plan->starts[n] = ntext;
+                plan->lengths[n] = 0;
+            }
+            plan->text[ntext++] = fmt[i];
+            plan->lengths[n]++;
+            i += fmt[i] == '%' ? 2 : 1;
+            continue;
+        }
+        i++;
+        sign = '\0';
+        while (fmt[i] == '+' || fmt[i] == ' ')
+        {
+            if (sign != '+') sign = fmt[i];
+            i++;
+        }
+        precision = 6;
+        if (fmt[i] == '.')
+        {
+            precision = 0;
+            for (i++; fmt[i] >= '0' && fmt[i] <= '9'; i++)
+            {
+                precision = 10 * precision + fmt[i] - '0';
+                if (precision > PRINT_FORMAT_MAX_PRECISION) return 0;
+            }
+        }
+        if (fmt[i] == 'l') i++;
+        conversion = fmt[i++];
+        if (conversion == 'r' || conversion == 'R')
+        {
+            precision = SHORTEST_PRECISION;
+        } else if (conversion != 'e' && conversion != 'E')
+        {
+            return 0;
+        }
+        if (plan->npieces == PRINT_FORMAT_MAX_PIECES) return 0;
+        n = plan->npieces++;
+        plan->kinds[n] = PRINT_DOUBLE;
+        plan->signs[n] = sign;
+        plan->precisions[n] = precision;
+        plan->exp_chars[n] = conversion == 'e' || conversion == 'r' ? 'e' : 'E';
+        plan->nvalues++;
+    }
+    return 1;
+}
+
+/** Check for shortest conversions, which `fprintf` cannot handle */
+static int
+has_shortest_conversion(char fmt[])
+{
+    const char* pos;
+
+    for (pos = strchr(fmt, '%'); pos != NULL; pos = strchr(pos, '%'))
+    {
+        pos += strspn(pos + 1, "+ -#0123456789.l") + 1;
+        if (*pos == 'r' || *pos == 'R') return 1;
+        if (*pos != '\0') pos++;
+    }
+    return 0;
+}
+
+static void
+printer_alloc(struct TextPrinter* pr)
+{
+    pr->size = PRINTER_SMALL_SIZE;
+    pr->buf = pr->small;
+}
+
+/** Set printer fields returning 1 if the buffer was set */
+static int
+printer_init(struct TextPrinter* pr, FILE* f, char fmt[], int owned)
+{
+    pr->f = f;
+    pr->owned = owned;
+    pr->fmt = format_source(fmt);
+    pr->buf = NULL;
+    pr->len = 0;
+    pr->size = 0;
+    pr->fast = compile_print_format(fmt, &pr->plan) && pr->plan.nvalues <= 2;
+    if (!pr->fast) return 0;
+    printer_alloc(pr);
+    return 1;
+}
+
+void
+printer_open(struct TextPrinter* pr, FILE* f, char fmt[])
+{
+    if (!printer_init(pr, f, fmt, 0) && has_shortest_conversion(pr->fmt))
+    {
+        io_error("unsupported print formatter \"%s\"", pr->fmt);
+    }
+}
+
+void
+printer_open_owned(struct TextPrinter* pr, FILE* f, char fmt[])
+{
+    if (!printer_init(pr, f, fmt, 1) && has_shortest_conversion(pr->fmt))
+    {
+        io_error("unsupported print formatter \"%s\"", pr->fmt);
+    }
+}
+
+int
+printer_open_memory(struct TextPrinter* pr, char fmt[])
+{
+    return printer_init(pr, NULL, fmt, 0);
+}
+
+static void
+printer_write_error()
+{
+    io_error("failed writing text to file");
+}
+
+/** Write all `iovcnt` chunks directly to the file descriptor `fd`
+ *
+ * Partial writes are resumed and interrupted writes are retried
+ */
+static int
+write_all(int fd, struct iovec* iov, int iovcnt)
+{
+    ssize_t n;
+
+    while (iovcnt > 0)
+    {
+        n = writev(fd, iov, iovcnt);
+        if (n < 0)
+        {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        while (iovcnt > 0 && (size_t) n >= iov->iov_len)
+        {
+            n -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0)
+        {
+            iov->iov_base = (char*) iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+    return 0;
+}
+
+/** Write buffer content followed by `extra` text of size `extra_len`
+ *
+ * Files with a descriptor are written with a single `writev`, bypassing
+ * the `FILE` buffer and lock, after flushing any text still held there.
+ * Streams without descriptor, as the compressed ones, and small blocks
+ * in streams of the caller use `fwrite`, avoiding one system call for
+ * every short record
+ */
+static void
+printer_flush_with(struct TextPrinter* pr, char* extra, size_t extra_len)
+{
+    int          fd, iovcnt;
+    size_t       total;
+    struct iovec iov[2];
+
+    total = pr->len + extra_len;
+    iovcnt = 0;
+    if (pr->len > 0)
+    {
+        iov[iovcnt].iov_base = pr->buf;
+        iov[iovcnt++].iov_len = pr->len;
+    }
+    if (extra_len > 0)
+    {
+        iov[iovcnt].iov_base = extra;
+        iov[iovcnt++].iov_len = extra_len;
+    }
+    pr->len = 0;
+    if (iovcnt == 0) return;
+    fd = fileno(pr->f);
+    if (fd < 0 || (!pr->owned && total < PRINTER_DIRECT_SIZE))
+    {
+        for (int i = 0; i < iovcnt; i++)
+        {
+            if (fwrite(iov[i].iov_base, 1, iov[i].iov_len, pr->f)
+                != iov[i].iov_len)
+            {
+                printer_write_error();
+            }
+        }
+        return;
+    }
+    if (fflush(pr->f) != 0 || write_all(fd, iov, iovcnt) != 0)
+    {
+        printer_write_error();
+    }
+    // resynchronize the position kept by stdio, failing only for pipes
+    fseek(pr->f, 0, SEEK_CUR);
+}
+
+/** Move buffer to the heap with `new_size` returning 0 if out of memory */
+static int
+printer_grow(struct TextPrinter* pr, size_t new_size)
+{
+    char* new_buf;
+
+    if (pr->buf == pr->small)
+    {
+        new_buf = (char*) malloc(new_size);
+        if (new_buf != NULL) memcpy(new_buf, pr->buf, pr->len);
+    } else
+    {
+        new_buf = (char*) realloc(pr->buf, new_size);
+    }
+    if (new_buf == NULL) return 0;
+    pr->buf = new_buf;
+    pr->size = new_size;
+    return 1;
+}
+
+/** Make room for `space` more characters, growing buffer up to the
+ * `printer_buffer_size` limit before flushing it. Memory printers have
+ * no limit
+ */
+static void
+printer_reserve(struct TextPrinter* pr, size_t space)
+{
+    size_t max_size, new_size;
+
+    if (pr->len + space <= pr->size) return;
+    max_size = pr->f == NULL ? SIZE_MAX : active_printer_buffer_size();
+    if (max_size < PRINTER_MIN_SPACE) max_size = PRINTER_MIN_SPACE;
+    new_size = pr->size;
+    while (new_size < max_size && pr->len + space > new_size)
+    {
+        new_size = new_size < max_size / 2 ? 2 * new_size : max_size;
+    }
+    if (new_size > pr->size && printer_grow(pr, new_size))
+    {
+        if (pr->len + space <= pr->size) return;
+    }
+    if (pr->f == NULL)
+    {
+        io_error("no memory for text printer buffer");
+    }
+    printer_flush_with(pr, NULL, 0);
+}
+
+void
+printer_set_format(struct TextPrinter* pr, char fmt[])
+{
+    if (compile_print_format(fmt, &pr->plan) && pr->plan.nvalues <= 2)
+    {
+        pr->fmt = format_source(fmt);
+        pr->fast = 1;
+        if (pr->buf == NULL) printer_alloc(pr);
+        return;
+    }
+    pr->fmt = format_source(fmt);
+    if (has_shortest_conversion(pr->fmt))
+    {
+        io_error("unsupported print formatter \"%s\"", pr->fmt);
+    }
+    printer_flush(pr);
+    pr->fast = 0;
+}
+
+void
+printer_flush(struct TextPrinter* pr)
+{
+    if (pr->f != NULL) printer_flush_with(pr, NULL, 0);
+}
+
+void
+printer_write(struct TextPrinter* pr, double* values)
+{
+    int                 nvalues;
+    struct PrintFormat* plan;
+
+    if (!pr->fast)
+    {
+        fprintf(pr->f, pr->fmt, values[0], values[1]);
+        return;
+    }
+    plan = &pr->plan;
+    printer_reserve(pr, PRINTER_MIN_SPACE);
+    nvalues = 0;
+    for (int i = 0; i < plan->npieces; i++)
+    {
+        if (plan->kinds[i] == PRINT_LITERAL)
+        {
+            memcpy(
+                pr->buf + pr->len,
+                plan->text + plan->starts[i],
+                plan->lengths[i]);
+            pr->len += plan->lengths[i];
+        } else
+        {
+            pr->len += format_double(
+                values[nvalues++],
+                plan->precisions[i],
+                plan->signs[i],
+                plan->exp_chars[i],
+                pr->buf + pr->len);
+        }
+    }
+}
+
+void
+printer_text(struct TextPrinter* pr, char text[])
+{
+    size_t len;
+
+    if (!pr->fast)
+    {
+        fputs(text, pr->f);
+        return;
+    }
+    len = strlen(text);
+    printer_reserve(pr, len);
+    if (pr->len + len > pr->size)
+    {
+        printer_flush_with(pr, text, len);
+        return;
+    }
+    memcpy(pr->buf + pr->len, text, len);
+    pr->len += len;
+}
+
+void
+printer_close(struct TextPrinter* pr)
+{
+    if (pr->buf == NULL) return;
+    printer_flush(pr);
+    printer_discard(pr);
+}
+
+void
+printer_discard(struct TextPrinter* pr)
+{
+    if (pr->buf != pr->small) free(pr->buf);
+    pr->buf = NULL;
+}
@@ -0,0 +1,659 @@
+#define _GNU_SOURCE
+#include "text_scanner.h"
+#include "format_plan.h"
+#include "io_context.h"
+#include <float.h>
+#include <locale.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_MANTISSA_DIGITS 19
+#define MAX_FAST_MANTISSA   (1ULL << 53)
+#define LEMIRE_MIN_EXP10    (-64)
+#define LEMIRE_MAX_EXP10    64
+#define SCANNER_LOOKAHEAD   512
+#define SCANNER_MIN_CHUNK   4096
+#define SCANNER_MAX_CHUNK   (1 << 20)
+
+static const double exact_powers_of_ten[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+/** 128-bit truncated significands of powers of ten, most significant first */
+static const uint64_t lemire_powers_of_ten[][2] = {
+    {0xA87FEA27A539E9A5ULL, 0x3F2398D747B36224ULL}, /* 1e-64 */
+    {0xD29FE4B18E88640EULL, 0x8EEC7F0D19A03AADULL}, /* 1e-63 */
+    {0x83A3EEEEF9153E89ULL, 0x1953CF68300424ACULL}, /* 1e-62 */
+    {0xA48CEAAAB75A8E2BULL, 0x5FA8C3423C052DD7ULL}, /* 1e-61 */
+    {0xCDB02555653131B6ULL, 0x3792F412CB06794DULL}, /* 1e-60 */
+    {0x808E17555F3EBF11ULL, 0xE2BBD88BBEE40BD0ULL}, /* 1e-59 */
+    {0xA0B19D2AB70E6ED6ULL, 0x5B6ACEAEAE9D0EC4ULL}, /* 1e-58 */
+    {0xC8DE047564D20A8BULL, 0xF245825A5A445275ULL}, /* 1e-57 */
+    {0xFB158592BE068D2EULL, 0xEED6E2F0F0D56712ULL}, /* 1e-56 */
+    {0x9CED737BB6C4183DULL, 0x55464DD69685606BULL}, /* 1e-55 */
+    {0xC428D05AA4751E4CULL, 0xAA97E14C3C26B886ULL}, /* 1e-54 */
+    {0xF53304714D9265DFULL, 0xD53DD99F4B3066A8ULL}, /* 1e-53 */
+    {0x993FE2C6D07B7FABULL, 0xE546A8038EFE4029ULL}, /* 1e-52 */
+    {0xBF8FDB78849A5F96ULL, 0xDE98520472BDD033ULL}, /* 1e-51 */
+    {0xEF73D256A5C0F77CULL, 0x963E66858F6D4440ULL}, /* 1e-50 */
+    {0x95A8637627989AADULL, 0xDDE7001379A44AA8ULL}, /* 1e-49 */
+    {0xBB127C53B17EC159ULL, 0x5560C018580D5D52ULL}, /* 1e-48 */
+    {0xE9D71B689DDE71AFULL, 0xAAB8F01E6E10B4A6ULL}, /* 1e-47 */
+    {0x9226712162AB070DULL, 0xCAB3961304CA70E8ULL}, /* 1e-46 */
+    {0xB6B00D69BB55C8D1ULL, 0x3D607B97C5FD0D22ULL}, /* 1e-45 */
+    {0xE45C10C42A2B3B05ULL, 0x8CB89A7DB77C506AULL}, /* 1e-44 */
+    {0x8EB98A7A9A5B04E3ULL, 0x77F3608E92ADB242ULL}, /* 1e-43 */
+    {0xB267ED1940F1C61CULL, 0x55F038B237591ED3ULL}, /* 1e-42 */
+    {0xDF01E85F912E37A3ULL, 0x6B6C46DEC52F6688ULL}, /* 1e-41 */
+    {0x8B61313BBABCE2C6ULL, 0x2323AC4B3B3DA015ULL}, /* 1e-40 */
+    {0xAE397D8AA96C1B77ULL, 0xABEC975E0A0D081AULL}, /* 1e-39 */
+    {0xD9C7DCED53C72255ULL, 0x96E7BD358C904A21ULL}, /* 1e-38 */
+    {0x881CEA14545C7575ULL, 0x7E50D64177DA2E54ULL}, /* 1e-37 */
+    {0xAA242499697392D2ULL, 0xDDE50BD1D5D0B9E9ULL}, /* 1e-36 */
+    {0xD4AD2DBFC3D07787ULL, 0x955E4EC64B44E864ULL}, /* 1e-35 */
+    {0x84EC3C97DA624AB4ULL, 0xBD5AF13BEF0B113EULL}, /* 1e-34 */
+    {0xA6274BBDD0FADD61ULL, 0xECB1AD8AEACDD58EULL}, /* 1e-33 */
+    {0xCFB11EAD453994BAULL, 0x67DE18EDA5814AF2ULL}, /* 1e-32 */
+    {0x81CEB32C4B43FCF4ULL, 0x80EACF948770CED7ULL}, /* 1e-31 */
+    {0xA2425FF75E14FC31ULL, 0xA1258379A94D028DULL}, /* 1e-30 */
+    {0xCAD2F7F5359A3B3EULL, 0x096EE45813A04330ULL}, /* 1e-29 */
+    {0xFD87B5F28300CA0DULL, 0x8BCA9D6E188853FCULL}, /* 1e-28 */
+    {0x9E74D1B791E07E48ULL, 0x775EA264CF55347DULL}, /* 1e-27 */
+    {0xC612062576589DDAULL, 0x95364AFE032A819DULL}, /* 1e-26 */
+    {0xF79687AED3EEC551ULL, 0x3A83DDBD83F52204ULL}, /* 1e-25 */
+    {0x9ABE14CD44753B52ULL, 0xC4926A9672793542ULL}, /* 1e-24 */
+    {0xC16D9A0095928A27ULL, 0x75B7053C0F178293ULL}, /* 1e-23 */
+    {0xF1C90080BAF72CB1ULL, 0x5324C68B12DD6338ULL}, /* 1e-22 */
+    {0x971DA05074DA7BEEULL, 0xD3F6FC16EBCA5E03ULL}, /* 1e-21 */
+    {0xBCE5086492111AEAULL, 0x88F4BB1CA6BCF584ULL}, /* 1e-20 */
+    {0xEC1E4A7DB69561A5ULL, 0x2B31E9E3D06C32E5ULL}, /* 1e-19 */
+    {0x9392EE8E921D5D07ULL, 0x3AFF322E62439FCFULL}, /* 1e-18 */
+    {0xB877AA3236A4B449ULL, 0x09BEFEB9FAD487C2ULL}, /* 1e-17 */
+    {0xE69594BEC44DE15BULL, 0x4C2EBE687989A9B3ULL}, /* 1e-16 */
+    {0x901D7CF73AB0ACD9ULL, 0x0F9D37014BF60A10ULL}, /* 1e-15 */
+    {0xB424DC35095CD80FULL, 0x538484C19EF38C94ULL}, /* 1e-14 */
+    {0xE12E13424BB40E13ULL, 0x2865A5F206B06FB9ULL}, /* 1e-13 */
+    {0x8CBCCC096F5088CBULL, 0xF93F87B7442E45D3ULL}, /* 1e-12 */
+    {0xAFEBFF0BCB24AAFEULL, 0xF78F69A51539D748ULL}, /* 1e-11 */
+    {0xDBE6FECEBDEDD5BEULL, 0xB573440E5A884D1BULL}, /* 1e-10 */
+    {0x89705F4136B4A597ULL, 0x31680A88F8953030ULL}, /* 1e-9 */
+    {0xABCC77118461CEFCULL, 0xFDC20D2B36BA7C3DULL}, /* 1e-8 */
+    {0xD6BF94D5E57A42BCULL, 0x3D32907604691B4CULL}, /* 1e-7 */
+    {0x8637BD05AF6C69B5ULL, 0xA63F9A49C2C1B10FULL}, /* 1e-6 */
+    {0xA7C5AC471B478423ULL, 0x0FCF80DC33721D53ULL}, /* 1e-5 */
+    {0xD1B71758E219652BULL, 0xD3C36113404EA4A8ULL}, /* 1e-4 */
+    {0x83126E978D4FDF3BULL, 0x645A1CAC083126E9ULL}, /* 1e-3 */
+    {0xA3D70A3D70A3D70AULL, 0x3D70A3D70A3D70A3ULL}, /* 1e-2 */
+    {0xCCCCCCCCCCCCCCCCULL, 0xCCCCCCCCCCCCCCCCULL}, /* 1e-1 */
+    {0x8000000000000000ULL, 0x0000000000000000ULL}, /* 1e0 */
+    {0xA000000000000000ULL, 0x0000000000000000ULL}, /* 1e1 */
+    {0xC800000000000000ULL, 0x0000000000000000ULL}, /* 1e2 */
+    {0xFA00000000000000ULL, 0x0000000000000000ULL}, /* 1e3 */
+    {0x9C40000000000000ULL, 0x0000000000000000ULL}, /* 1e4 */
+    {0xC350000000000000ULL, 0x0000000000000000ULL}, /* 1e5 */
+    {0xF424000000000000ULL, 0x0000000000000000ULL}, /* 1e6 */
+    {0x9896800000000000ULL, 0x0000000000000000ULL}, /* 1e7 */
+    {0xBEBC200000000000ULL, 0x0000000000000000ULL}, /* 1e8 */
+    {0xEE6B280000000000ULL, 0x0000000000000000ULL}, /* 1e9 */
+    {0x9502F90000000000ULL, 0x0000000000000000ULL}, /* 1e10 */
+    {0xBA43B74000000000ULL, 0x0000000000000000ULL}, /* 1e11 */
+    {0xE8D4A51000000000ULL, 0x0000000000000000ULL}, /* 1e12 */
+    {0x9184E72A00000000ULL, 0x0000000000000000ULL}, /* 1e13 */
+    {0xB5E620F480000000ULL, 0x0000000000000000ULL}, /* 1e14 */
+    {0xE35FA931A0000000ULL, 0x0000000000000000ULL}, /* 1e15 */
+    {0x8E1BC9BF04000000ULL, 0x0000000000000000ULL}, /* 1e16 */
+    {0xB1A2BC2EC5000000ULL, 0x0000000000000000ULL}, /* 1e17 */
+    {0xDE0B6B3A76400000ULL, 0x0000000000000000ULL}, /* 1e18 */
+    {0x8AC7230489E80000ULL, 0x0000000000000000ULL}, /* 1e19 */
+    {0xAD78EBC5AC620000ULL, 0x0000000000000000ULL}, /* 1e20 */
+    {0xD8D726B7177A8000ULL, 0x0000000000000000ULL}, /* 1e21 */
+    {0x878678326EAC9000ULL, 0x0000000000000000ULL}, /* 1e22 */
+    {0xA968163F0A57B400ULL, 0x0000000000000000ULL}, /* 1e23 */
+    {0xD3C21BCECCEDA100ULL, 0x0000000000000000ULL}, /* 1e24 */
+    {0x84595161401484A0ULL, 0x0000000000000000ULL}, /* 1e25 */
+    {0xA56FA5B99019A5C8ULL, 0x0000000000000000ULL}, /* 1e26 */
+    {0xCECB8F27F4200F3AULL, 0x0000000000000000ULL}, /* 1e27 */
+    {0x813F3978F8940984ULL, 0x4000000000000000ULL}, /* 1e28 */
+    {0xA18F07D736B90BE5ULL, 0x5000000000000000ULL}, /* 1e29 */
+    {0xC9F2C9CD04674EDEULL, 0xA400000000000000ULL}, /* 1e30 */
+    {0xFC6F7C4045812296ULL, 0x4D00000000000000ULL}, /* 1e31 */
+    {0x9DC5ADA82B70B59DULL, 0xF020000000000000ULL}, /* 1e32 */
+    {0xC5371912364CE305ULL, 0x6C28000000000000ULL}, /* 1e33 */
+    {0xF684DF56C3E01BC6ULL, 0xC732000000000000ULL}, /* 1e34 */
+    {0x9A130B963A6C115CULL, 0x3C7F400000000000ULL}, /* 1e35 */
+    {0xC097CE7BC90715B3ULL, 0x4B9F100000000000ULL}, /* 1e36 */
+    {0xF0BDC21ABB48DB20ULL, 0x1E86D40000000000ULL}, /* 1e37 */
+    {0x96769950B50D88F4ULL, 0x1314448000000000ULL}, /* 1e38 */
+    {0xBC143FA4E250EB31ULL, 0x17D955A000000000ULL}, /* 1e39 */
+    {0xEB194F8E1AE525FDULL, 0x5DCFAB0800000000ULL}, /* 1e40 */
+    {0x92EFD1B8D0CF37BEULL, 0x5AA1CAE500000000ULL}, /* 1e41 */
+    {0xB7ABC627050305ADULL, 0xF14A3D9E40000000ULL}, /* 1e42 */
+    {0xE596B7B0C643C719ULL, 0x6D9CCD05D0000000ULL}, /* 1e43 */
+    {0x8F7E32CE7BEA5C6FULL, 0xE4820023A2000000ULL}, /* 1e44 */
+    {0xB35DBF821AE4F38BULL, 0xDDA2802C8A800000ULL}, /* 1e45 */
+    {0xE0352F62A19E306EULL, 0xD50B2037AD200000ULL}, /* 1e46 */
+    {0x8C213D9DA502DE45ULL, 0x4526F422CC340000ULL}, /* 1e47 */
+    {0xAF298D050E4395D6ULL, 0x9670B12B7F410000ULL}, /* 1e48 */
+    {0xDAF3F04651D47B4CULL, 0x3C0CDD765F114000ULL}, /* 1e49 */
+    {0x88D8762BF324CD0FULL, 0xA5880A69FB6AC800ULL}, /* 1e50 */
+    {0xAB0E93B6EFEE0053ULL, 0x8EEA0D047A457A00ULL}, /* 1e51 */
+    {0xD5D238A4ABE98068ULL, 0x72A4904598D6D880ULL}, /* 1e52 */
+    {0x85A36366EB71F041ULL, 0x47A6DA2B7F864750ULL}, /* 1e53 */
+    {0xA70C3C40A64E6C51ULL, 0x999090B65F67D924ULL}, /* 1e54 */
+    {0xD0CF4B50CFE20765ULL, 0xFFF4B4E3F741CF6DULL}, /* 1e55 */
+    {0x82818F1281ED449FULL, 0xBFF8F10E7A8921A4ULL}, /* 1e56 */
+    {0xA321F2D7226895C7ULL, 0xAFF72D52192B6A0DULL}, /* 1e57 */
+    {0xCBEA6F8CEB02BB39ULL, 0x9BF4F8A69F764490ULL}, /* 1e58 */
+    {0xFEE50B7025C36A08ULL, 0x02F236D04753D5B4ULL}, /* 1e59 */
+    {0x9F4F2726179A2245ULL, 0x01D762422C946590ULL}, /* 1e60 */
+    {0xC722F0EF9D80AAD6ULL, 0x424D3AD2B7B97EF5ULL}, /* 1e61 */
+    {0xF8EBAD2B84E0D58BULL, 0xD2E0898765A7DEB2ULL}, /* 1e62 */
+    {0x9B934C3B330C8577ULL, 0x63CC55F49F88EB2FULL}, /* 1e63 */
+    {0xC2781F49FFCFA6D5ULL, 0x3CBF6B71C76B25FBULL}, /* 1e64 */
+};
+
+static locale_t c_locale = (locale_t) 0;
+
+static int
+is_digit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+static int
+is_space(char c)
+{
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+static locale_t
+get_c_locale()
+{
+    locale_t loc, expected;
+
+    loc = __atomic_load_n(&c_locale, __ATOMIC_ACQUIRE);
+    if (loc != (locale_t) 0) return loc;
+    loc = newlocale(LC_ALL_MASK, "C", (locale_t) 0);
+    if (loc == (locale_t) 0)
+    {
+        io_error("impossible to create C locale for parsing");
+    }
+    expected = (locale_t) 0;
+    if (!__atomic_compare_exchange_n(
+            &c_locale, &expected, loc, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+    {
+        freelocale(loc);
+        loc = expected;
+    }
+    return loc;
+}
+
+/** Eisel-Lemire conversion of mantissa times ten to `exp10`
+ *
+ * Multiply the normalized mantissa by the truncated 128-bit power of ten
+ * and return 0 without setting `x` whenever the truncation could affect
+ * the rounding, then the slower exact conversion must be used instead
+ */
+static int
+eisel_lemire(uint64_t mantissa, int exp10, int negative, double* x)
+{
+    int               clz, msb;
+    uint64_t          x_hi, x_lo, y_hi, merged_hi, merged_lo, bits, exp2;
+    unsigned __int128 product;
+    const uint64_t*   power;
+
+    if (exp10 < LEMIRE_MIN_EXP10 || exp10 > LEMIRE_MAX_EXP10) return 0;
+    power = lemire_powers_of_ten[exp10 - LEMIRE_MIN_EXP10];
+    clz = __builtin_clzll(mantissa);
+    mantissa <<= clz;
+    exp2 = (uint64_t) (((217706 * exp10) >> 16) + 64 + 1023) - clz;
+
+    product = (unsigned __int128) mantissa * power[0];
+    x_hi = product >> 64;
+    x_lo = (uint64_t) product;
+    if ((x_hi & 0x1FF) == 0x1FF && x_lo + mantissa < mantissa)
+    {
+        product = (unsigned __int128) mantissa * power[1];
+        y_hi = product >> 64;
+        merged_hi = x_hi;
+        merged_lo = x_lo + y_hi;
+        if (merged_lo < x_lo) merged_hi++;
+        if ((merged_hi & 0x1FF) == 0x1FF && merged_lo + 1 == 0
+            && (uint64_t) product + mantissa < mantissa)
+        {
+            return 0;
+        }
+        x_hi = merged_hi;
+        x_lo = merged_lo;
+    }
+
+    msb = x_hi >> 63;
+    bits = x_hi >> (msb + 9);
+    exp2 -= 1 ^ msb;
+    // exactly half-way between two doubles cannot be decided here
+    if (x_lo == 0 && (x_hi & 0x1FF) == 0 && (bits & 3) == 1) return 0;
+    bits += bits & 1;
+    bits >>= 1;
+    if (bits >> 53 > 0)
+    {
+        bits >>= 1;
+        exp2++;
+    }
+    // subnormal, infinity or nan
+    if (exp2 - 1 >= 0x7FF - 1) return 0;
+    bits = exp2 << 52 | (bits & 0x000FFFFFFFFFFFFFULL);
+    if (negative) bits |= 0x8000000000000000ULL;
+    memcpy(x, &bits, sizeof(double));
+    return 1;
+}
+
+/** Exact conversion of `len` characters with `strtod` in C locale */
+static int
+parse_double_fallback(const char* str, size_t len, double* x)
+{
+    char  local_buf[128];
+    char *buf, *endptr;
+    int   consumed;
+
+    buf = local_buf;
+    if (len >= sizeof(local_buf)) buf = (char*) malloc(len + 1);
+    if (buf == NULL)
+    {
+        io_error("no memory to parse number of %zu chars", len);
+    }
+    memcpy(buf, str, len);
+    buf[len] = '\0';
+    *x = strtod_l(buf, &endptr, get_c_locale());
+    consumed = endptr - buf;
+    if (buf != local_buf) free(buf);
+    return consumed;
+}
+
+int
+parse_double(const char* str, const char* end, double* x)
+{
+    const char* s;
+    const char* e;
+    uint64_t    mantissa;
+    int         negative, ndigits, any_digit, truncated, exp10, exp_value;
+    double      value;
+
+    s = str;
+    negative = 0;
+    if (s < end && (*s == '+' || *s == '-'))
+    {
+        negative = *s == '-';
+        s++;
+    }
+    if (s == end) return 0;
+    if (!is_digit(*s) && *s != '.')
+    {
+        // infinity and nan are rare enough to be left to strtod
+        if ((end - s) < 3) return 0;
+        return parse_double_fallback(str, (end - str) < 64 ? end - str : 64, x);
+    }
+    if (*s == '0' && (end - s) > 1 && (s[1] == 'x' || s[1] == 'X'))
+    {
+        return parse_double_fallback(str, (end - str) < 64 ? end - str : 64, x);
+    }
+
+    mantissa = 0;
+    ndigits = 0;
+    any_digit = 0;
+    truncated = 0;
+    exp10 = 0;
+    while (s < end && *s == '0')
+    {
+        any_digit = 1;
+        s++;
+    }
+    for (; s < end && is_digit(*s); s++)
+    {
+        any_digit = 1;
+        if (ndigits < MAX_MANTISSA_DIGITS)
+        {
+            mantissa = 10 * mantissa + (*s - '0');
+            ndigits++;
+        } else
+        {
+            exp10++;
+            truncated |= *s != '0';
+        }
+    }
+    if (s < end && *s == '.')
+    {
+        s++;
+        if (ndigits == 0)
+        {
+            for (; s < end && *s == '0'; s++)
+            {
+                any_digit = 1;
+                exp10--;
+            }
+        }
+        for (; s < end && is_digit(*s); s++)
+        {
+            any_digit = 1;
+            if (ndigits < MAX_MANTISSA_DIGITS)
+            {
+                mantissa = 10 * mantissa + (*s - '0');
+                ndigits++;
+                exp10--;
+            } else
+            {
+                truncated |= *s != '0';
+            }
+        }
+    }
+    if (!any_digit) return 0;
+    if (s < end && (*s == 'e' || *s == 'E'))
+    {
+        e = s + 1;
+        if (e < end && (*e == '+' || *e == '-')) e++;
+        if (e < end && is_digit(*e))
+        {
+            exp_value = 0;
+            for (; e < end && is_digit(*e); e++)
+            {
+                if (exp_value < 100000) exp_value = 10 * exp_value + (*e - '0');
+            }
+            exp10 += s[1] == '-' ? -exp_value : exp_value;
+            s = e;
+        }
+    }
+
+    if (mantissa == 0)
+    {
+        *x = negative ? -0.0 : 0.0;
+        return s - str;
+    }
+    // Clinger fast path: both mantissa and power of ten are exact doubles
+    // thus a single correctly rounded operation gives the exact result
+#if FLT_EVAL_METHOD == 0
+    if (!truncated && mantissa <= MAX_FAST_MANTISSA)
+    {
+        while (exp10 > 22 && mantissa <= MAX_FAST_MANTISSA / 10)
+        {
+            mantissa *= 10;
+            exp10--;
+        }
+        if (exp10 >= 0 && exp10 <= 22)
+        {
+            value = (double) mantissa * exact_powers_of_ten[exp10];
+            *x = negative ? -value : value;
+            return s - str;
+        }
+        if (exp10 < 0 && exp10 >= -22)
+        {
+            value = (double) mantissa / exact_powers_of_ten[-exp10];
+            *x = negative ? -value : value;
+            return s - str;
+        }
+    }
+#endif
+    if (!truncated && eisel_lemire(mantissa, exp10, negative, x))
+    {
+        return s - str;
+    }
+    return parse_double_fallback(str, s - str, x);
+}
+
+int
+compile_scan_format(char fmt[], struct ScanFormat* plan)
+{
+    int                n;
+    char               c;
+    struct FormatPlan* compiled;
+
+    if (format_is_plan(fmt))
+    {
+        compiled = (struct FormatPlan*) fmt;
+        *plan = compiled->scan;
+        return compiled->scan_supported;
+    }
+    plan->npieces = 0;
+    plan->nvalues = 0;
+    for (int i = 0; fmt[i] != '\0'; i++)
+    {
+        n = plan->npieces;
+        if (n == SCAN_FORMAT_MAX_PIECES) return 0;
+        c = fmt[i];
+        if (is_space(c))
+        {
+            if (n > 0 && plan->kinds[n - 1] == SCAN_SPACE) continue;
+            plan->kinds[n] = SCAN_SPACE;
+        } else if (c == '%')
+        {
+            if (fmt[i + 1] != 'l') return 0;
+            c = fmt[i + 2];
+            if (c != 'f' && c != 'e' && c != 'g' && c != 'E' && c != 'G')
+            {
+                return 0;
+            }
+            plan->kinds[n] = SCAN_DOUBLE;
+            plan->nvalues++;
+            i += 2;
+        } else
+        {
+            plan->kinds[n] = SCAN_LITERAL;
+            plan->literals[n] = c;
+        }
+        plan->npieces++;
+    }
+    return 1;
+}
+
+/** Make at least `SCANNER_LOOKAHEAD` characters available if possible */
+static size_t
+scanner_fill(struct TextScanner* sc)
+{
+    size_t left, nread;
+    char*  grown;
+
+    left = sc->end - sc->pos;
+    if (left >= SCANNER_LOOKAHEAD || sc->eof) return left;
+    memmove(sc->buf, sc->pos, left);
+    sc->pos = sc->buf;
+    sc->end = sc->buf + left;
+    if (sc->chunk < SCANNER_MAX_CHUNK)
+    {
+        grown = (char*) realloc(sc->buf, 2 * sc->chunk + SCANNER_LOOKAHEAD);
+        if (grown == NULL)
+        {
+            io_error("no memory for text scanner buffer");
+        }
+        sc->buf = grown;
+        sc->chunk *= 2;
+    }
+    nread = fread(sc->buf + left, 1, sc->chunk, sc->f);
+    if (nread < sc->chunk) sc->eof = 1;
+    sc->pos = sc->buf;
+    sc->end = sc->buf + left + nread;
+    return left + nread;
+}
+
+static void
+scanner_skip_spaces(struct TextScanner* sc)
+{
+    while (1)
+    {
+        while (sc->pos < sc->end && is_space(*sc->pos)) sc->pos++;
+        if (sc->pos < sc->end || scanner_fill(sc) == 0) return;
+    }
+}
+
+/** Set scanner on open file, using the fast path only if `read_ahead` */
+static void
+scanner_init(struct TextScanner* sc, FILE* f, char fmt[], int read_ahead)
+{
+    sc->f = f;
+    sc->fmt = format_source(fmt);
+    sc->buf = NULL;
+    sc->pos = NULL;
+    sc->end = NULL;
+    sc->eof = 0;
+    sc->chunk = SCANNER_MIN_CHUNK;
+    sc->fast = compile_scan_format(fmt, &sc->plan) && sc->plan.nvalues <= 2
+               && read_ahead;
+    if (!sc->fast) return;
+    sc->buf = (char*) malloc(sc->chunk + SCANNER_LOOKAHEAD);
+    if (sc->buf == NULL)
+    {
+        io_error("no memory for text scanner buffer");
+    }
+    sc->pos = sc->buf;
+    sc->end = sc->buf;
+}
+
+void
+scanner_open(struct TextScanner* sc, FILE* f, char fmt[])
+{
+    // unread characters are given back seeking backward, which pipes and
+    // compressed streams (no file descriptor) cannot do, even if `ftell`
+    // works on them
+    scanner_init(sc, f, fmt, fileno(f) >= 0 && ftell(f) >= 0);
+}
+
+void
+scanner_open_owned(struct TextScanner* sc, FILE* f, char fmt[])
+{
+    scanner_init(sc, f, fmt, 1);
+}
+
+int
+scanner_open_memory(
+    struct TextScanner* sc, const char* beg, const char* end, char fmt[])
+{
+    sc->f = NULL;
+    sc->fmt = format_source(fmt);
+    sc->buf = NULL;
+    sc->chunk = 0;
+    sc->pos = (char*) beg;
+    sc->end = (char*) end;
+    sc->eof = 1;
+    sc->fast = compile_scan_format(fmt, &sc->plan) && sc->plan.nvalues <= 2;
+    return sc->fast;
+}
+
+/** Length of number in text, converting it only for unusual syntax */
+static int
+lex_double(const char* str, const char* end)
+{
+    int         any_digit;
+    double      x;
+    const char* s;
+    const char* e;
+
+    s = str;
+    if (s < end && (*s == '+' || *s == '-')) s++;
+    if (s == end) return 0;
+    if ((!is_digit(*s) && *s != '.')
+        || (*s == '0' && (end - s) > 1 && (s[1] == 'x' || s[1] == 'X')))
+    {
+        return parse_double(str, end, &x);
+    }
+    any_digit = 0;
+    for (; s < end && is_digit(*s); s++) any_digit = 1;
+    if (s < end && *s == '.')
+    {
+        for (s++; s < end && is_digit(*s); s++) any_digit = 1;
+    }
+    if (!any_digit) return 0;
+    if (s < end && (*s == 'e' || *s == 'E'))
+    {
+        e = s + 1;
+        if (e < end && (*e == '+' || *e == '-')) e++;
+        if (e < end && is_digit(*e))
+        {
+            for (; e < end && is_digit(*e); e++)
+                ;
+            s = e;
+        }
+    }
+    return s - str;
+}
+
+/** Apply compiled formatter converting numbers only if `values` is set */
+static int
+scanner_apply(struct TextScanner* sc, double* values)
+{
+    int n, nread;
+
+    nread = 0;
+    for (int i = 0; i < sc->plan.npieces; i++)
+    {
+        switch (sc->plan.kinds[i])
+        {
+            case SCAN_SPACE:
+                scanner_skip_spaces(sc);
+                break;
+            case SCAN_LITERAL:
+                if (sc->pos == sc->end && scanner_fill(sc) == 0) return nread;
+                if (*sc->pos != sc->plan.literals[i]) return nread;
+                sc->pos++;
+                break;
+            case SCAN_DOUBLE:
+                scanner_skip_spaces(sc);
+                scanner_fill(sc);
+                if (values != NULL)
+                {
+                    n = parse_double(sc->pos, sc->end, &values[nread]);
+                } else
+                {
+                    n = lex_double(sc->pos, sc->end);
+                }
+                if (n == 0) return nread;
+                sc->pos += n;
+                nread++;
+                break;
+        }
+    }
+    return nread;
+}
+
+int
+scanner_read(struct TextScanner* sc, double* values)
+{
+    if (!sc->fast) return fscanf(sc->f, sc->fmt, &values[0], &values[1]);
+    return scanner_apply(sc, values);
+}
+
+int
+scanner_skip(struct TextScanner* sc)
+{
+    double values[2];
+
+    if (!sc->fast) return fscanf(sc->f, sc->fmt, &values[0], &values[1]);
+    return scanner_apply(sc, NULL);
+}
+
+int
+scanner_at_end(struct TextScanner* sc)
+{
+    int c;
+
+    if (sc->fast)
+    {
+        scanner_skip_spaces(sc);
+        return sc->pos == sc->end;
+    }
+    while ((c = getc(sc->f)) != EOF)
+    {
+        if (!is_space(c))
+        {
+            ungetc(c, sc->f);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+void
+scanner_close(struct TextScanner* sc)
+{
+    if (!sc->fast || sc->f == NULL) return;
+    if (sc->end > sc->pos) fseek(sc->f, -(long) (sc->end - sc->pos), SEEK_CUR);
+    free(sc->buf);
+    sc->buf = NULL;
+}